@@ -0,0 +1,177 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BATCH_PROOF_VERIFIER_H
+#define BATCH_PROOF_VERIFIER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "merkle-tree-proof.h"
+
+/// \file
+/// \brief Batch Merkle tree proof verifier.
+
+namespace cartesi {
+
+/// \brief Verifies many Merkle tree proofs at once
+/// \tparam HASH_TYPE the type that holds a hash
+/// \tparam ADDRESS_TYPE the type that holds an address
+/// \details \{
+/// Proofs are bubbled up level by level, all together. At each level, the pairs of hashes the
+/// proofs need concatenated are collected first, and only pairs not seen before in the batch are
+/// hashed. Proofs for nearby targets in the same tree share every node above the level where their
+/// paths meet, so those nodes are hashed once for the whole batch instead of once per proof.
+/// \}
+template <typename HASH_TYPE, typename ADDRESS_TYPE = uint64_t>
+class batch_proof_verifier final {
+public:
+    using proof_type = merkle_tree_proof<HASH_TYPE, ADDRESS_TYPE>;
+
+    using hash_type = HASH_TYPE;
+
+    using address_type = ADDRESS_TYPE;
+
+    /// \brief Adds a proof to the batch
+    /// \param proof Proof to verify. Must remain alive until verify returns.
+    void add(const proof_type &proof) {
+        m_proofs.push_back(&proof);
+    }
+
+    /// \brief Returns number of proofs in batch
+    size_t size(void) const {
+        return m_proofs.size();
+    }
+
+    /// \brief Removes all proofs from batch
+    void clear(void) {
+        m_proofs.clear();
+    }
+
+    /// \brief Returns number of hashes computed by last call to verify
+    uint64_t get_hash_count(void) const {
+        return m_hash_count;
+    }
+
+    /// \brief Returns number of hashes that last call to verify shared between proofs instead of computing
+    uint64_t get_shared_hash_count(void) const {
+        return m_shared_hash_count;
+    }
+
+    /// \brief Verifies all proofs in batch
+    /// \tparam HASHER_TYPE Hasher class to use
+    /// \param h Hasher object to use
+    /// \param first_invalid If not nullptr, receives index of first invalid proof, if any
+    /// \return True if all proofs are valid, false otherwise
+    template <typename HASHER_TYPE>
+    bool verify(HASHER_TYPE &&h, size_t *first_invalid = nullptr) {
+        static_assert(is_an_i_hasher<HASHER_TYPE>::value, "not an i_hasher");
+        static_assert(std::is_same<typename remove_cvref<HASHER_TYPE>::type::hash_type, hash_type>::value,
+            "incompatible hash types");
+        m_hash_count = 0;
+        m_shared_hash_count = 0;
+        // Each lane holds the hash of the node a proof has bubbled up to so far
+        std::vector<hash_type> lanes(m_proofs.size());
+        std::vector<const hash_type *> results(m_proofs.size());
+        int min_log2_size = std::numeric_limits<int>::max();
+        int max_log2_size = 0;
+        for (size_t i = 0; i < m_proofs.size(); ++i) {
+            lanes[i] = m_proofs[i]->get_target_hash();
+            min_log2_size = std::min(min_log2_size, m_proofs[i]->get_log2_target_size());
+            max_log2_size = std::max(max_log2_size, m_proofs[i]->get_log2_root_size());
+        }
+        concat_hashes_type concat_hashes;
+        std::vector<typename concat_hashes_type::value_type *> pending;
+        for (int log2_size = min_log2_size; log2_size < max_log2_size; ++log2_size) {
+            // Collect pairs needed at this level, reusing those already hashed for other proofs
+            pending.clear();
+            for (size_t i = 0; i < m_proofs.size(); ++i) {
+                const auto &p = *m_proofs[i];
+                if (log2_size < p.get_log2_target_size() || log2_size >= p.get_log2_root_size()) {
+                    results[i] = nullptr;
+                    continue;
+                }
+                const bool bit = (p.get_target_address() & (static_cast<address_type>(1) << log2_size)) != 0;
+                auto pair = bit ? pair_type{p.get_sibling_hash(log2_size), lanes[i]} :
+                                  pair_type{lanes[i], p.get_sibling_hash(log2_size)};
+                auto [it, inserted] = concat_hashes.try_emplace(std::move(pair));
+                if (inserted) {
+                    pending.push_back(&*it);
+                } else {
+                    ++m_shared_hash_count;
+                }
+                results[i] = &it->second;
+            }
+            hash_pending(h, pending);
+            for (size_t i = 0; i < m_proofs.size(); ++i) {
+                if (results[i] != nullptr) {
+                    lanes[i] = *results[i];
+                }
+            }
+        }
+        for (size_t i = 0; i < m_proofs.size(); ++i) {
+            if (lanes[i] != m_proofs[i]->get_root_hash()) {
+                if (first_invalid != nullptr) {
+                    *first_invalid = i;
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    /// \brief Pair of hashes to concatenate
+    using pair_type = std::pair<hash_type, hash_type>;
+
+    /// \brief Hashes a pair of hashes for lookup. Hashes are uniformly distributed, so a few bytes suffice.
+    struct pair_hash {
+        size_t operator()(const pair_type &pair) const {
+            static_assert(sizeof(hash_type) >= sizeof(uint64_t), "hash is too small");
+            uint64_t left = 0;
+            uint64_t right = 0;
+            memcpy(&left, pair.first.data(), sizeof(left));
+            memcpy(&right, pair.second.data(), sizeof(right));
+            return static_cast<size_t>(left ^ (right * UINT64_C(0x9e3779b97f4a7c15)));
+        }
+    };
+
+    /// \brief Hash of each distinct concatenation in the batch
+    using concat_hashes_type = std::unordered_map<pair_type, hash_type, pair_hash>;
+
+    /// \brief Computes the hashes of all concatenations collected for a level
+    /// \details The pairs are independent, so this is where a multi-lane hasher would process them side by side
+    template <typename HASHER_TYPE>
+    void hash_pending(HASHER_TYPE &h, const std::vector<typename concat_hashes_type::value_type *> &pending) {
+        for (auto *entry : pending) {
+            get_concat_hash(h, entry->first.first, entry->first.second, entry->second);
+        }
+        m_hash_count += pending.size();
+    }
+
+    std::vector<const proof_type *> m_proofs; ///< Proofs in batch
+    uint64_t m_hash_count{};                  ///< Hashes computed by last verify
+    uint64_t m_shared_hash_count{};           ///< Hashes shared by last verify
+};
+
+} // namespace cartesi
+
+#endif
@@ -0,0 +1,143 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+/// \file
+/// \brief Benchmarks for bulk construction of complete Merkle trees.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "complete-merkle-tree.h"
+#include "fixed-complete-merkle-tree.h"
+
+using namespace cartesi;
+
+constexpr const int LOG2_ROOT_SIZE = 37;
+constexpr const int LOG2_KECCAK_SIZE = 5;
+constexpr const uint64_t DEFAULT_LEAF_COUNT = 1000000;
+
+/// \brief Fixed tree used for the epoch trees in server-manager
+using epoch_tree_type = fixed_complete_merkle_tree<LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE>;
+
+/// \brief Creates distinct leaf hashes
+static complete_merkle_tree::level_type make_leaves(uint64_t count) {
+    complete_merkle_tree::level_type leaves(count);
+    complete_merkle_tree::hasher_type h;
+    for (uint64_t i = 0; i < count; ++i) {
+        h.begin();
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        h.add_data(reinterpret_cast<const unsigned char *>(&i), sizeof(i));
+        h.end(leaves[i]);
+    }
+    return leaves;
+}
+
+/// \brief Runs a benchmark and prints its duration
+/// \param name Benchmark name
+/// \param f Function that builds a tree
+/// \return Built tree
+template <typename F>
+static auto run_benchmark(const std::string &name, F f) {
+    auto start = std::chrono::steady_clock::now();
+    auto tree = f();
+    auto end = std::chrono::steady_clock::now();
+    std::cout << name << ": " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    return tree;
+}
+
+/// \brief Prints help
+/// \param name Program name from argv[0]
+static void help(const char *name) {
+    (void) fprintf(stderr,
+        R"(Usage:
+
+    %s [--help] [--leaf-count=<n>]
+
+where
+
+    --leaf-count=<n>
+      number of leaves in each tree (default: %llu)
+
+    --help
+      prints this message and exits
+
+
+)",
+        name, static_cast<unsigned long long>(DEFAULT_LEAF_COUNT));
+}
+
+int main(int argc, char *argv[]) try {
+    uint64_t leaf_count = DEFAULT_LEAF_COUNT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0) {
+            help(argv[0]);
+            exit(0);
+        } else if (strncmp(argv[i], "--leaf-count=", strlen("--leaf-count=")) == 0) {
+            leaf_count = std::stoull(argv[i] + strlen("--leaf-count="));
+        } else {
+            help(argv[0]);
+            exit(1);
+        }
+    }
+    std::cout << "building trees with " << leaf_count << " leaves" << std::endl;
+    const auto leaves = make_leaves(leaf_count);
+    auto push_back_tree = run_benchmark("push_back", [&leaves]() {
+        complete_merkle_tree tree{LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE};
+        for (const auto &leaf : leaves) {
+            tree.push_back(leaf);
+        }
+        return tree;
+    });
+    auto push_back_range_tree = run_benchmark("push_back_range", [&leaves]() {
+        complete_merkle_tree tree{LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE};
+        tree.push_back_range(leaves.begin(), leaves.end());
+        return tree;
+    });
+    // Copy the leaves before starting the clock, since the constructor takes ownership of them
+    auto leaves_tree = run_benchmark("leaves constructor", [leaves_copy = leaves]() mutable {
+        return complete_merkle_tree{LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE, std::move(leaves_copy)};
+    });
+    auto fixed_push_back_range_tree = run_benchmark("fixed push_back_range", [&leaves]() {
+        epoch_tree_type tree;
+        tree.push_back_range(leaves.begin(), leaves.end());
+        return tree;
+    });
+    // This is how epochs complete their trees on FinishEpoch
+    auto fixed_leaves_tree = run_benchmark("fixed leaves constructor", [leaves_copy = leaves]() mutable {
+        return epoch_tree_type{std::move(leaves_copy)};
+    });
+    if (push_back_range_tree.get_root_hash() != push_back_tree.get_root_hash() ||
+        leaves_tree.get_root_hash() != push_back_tree.get_root_hash() ||
+        fixed_push_back_range_tree.get_root_hash() != push_back_tree.get_root_hash() ||
+        fixed_leaves_tree.get_root_hash() != push_back_tree.get_root_hash()) {
+        std::cerr << "root hashes disagree" << std::endl;
+        exit(1);
+    }
+    return 0;
+} catch (std::exception &e) {
+    std::cerr << "Caught exception: " << e.what() << '\n';
+    return 1;
+} catch (...) {
+    std::cerr << "Caught unknown exception\n";
+    return 1;
+}
@@ -16,7 +16,14 @@
 
 #include "complete-merkle-tree.h"
 
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "thread-pool.h"
 
 /// \file
 /// \brief Complete Merkle tree implementation.
@@ -116,9 +123,7 @@ void complete_merkle_tree::bubble_up(void) {
         // Last safe entry has two non-pristine leafs
         auto last_safe_entry = prev.size() / 2;
         // Do all entries for which we have two non-pristine children
-        for (; first_entry < last_safe_entry; ++first_entry) {
-            get_concat_hash(h, prev[2 * first_entry], prev[2 * first_entry + 1], next[first_entry]);
-        }
+        concat_hash_level(prev, next, first_entry, last_safe_entry);
         // Maybe do last odd entry
         if (prev.size() > 2 * last_safe_entry) {
             get_concat_hash(h, prev.back(), m_pristine.get_hash(log2_prev_size), next[last_safe_entry]);
@@ -138,4 +143,66 @@ complete_merkle_tree::level_type &complete_merkle_tree::get_level(int log2_size)
     return const_cast<level_type &>(std::as_const(*this).get_level(log2_size));
 }
 
+/// \brief Minimum number of entries each thread computes in concat_hash_level
+constexpr uint64_t CONCAT_HASH_LEVEL_CHUNK = UINT64_C(1) << 14;
+
+/// \brief Computes a range of entries in a tree level in the calling thread
+static void concat_hash_level_serial(const complete_merkle_tree::level_type &prev,
+    complete_merkle_tree::level_type &next, uint64_t first, uint64_t last) {
+    complete_merkle_tree::hasher_type h;
+    for (; first < last; ++first) {
+        get_concat_hash(h, prev[2 * first], prev[2 * first + 1], next[first]);
+    }
+}
+
+/// \brief Returns the number of hardware threads, read once
+static uint64_t get_hardware_thread_count(void) {
+    static const uint64_t count = std::max(1U, std::thread::hardware_concurrency());
+    return count;
+}
+
+/// \brief Returns the pool running the chunks of concat_hash_level that the calling thread does not take
+/// \details The pool is created on first use and lives until the process exits, so levels do not pay for starting
+/// threads.
+static thread_pool &get_concat_hash_level_pool(void) {
+    static thread_pool pool{get_hardware_thread_count() - 1};
+    return pool;
+}
+
+void concat_hash_level(const complete_merkle_tree::level_type &prev, complete_merkle_tree::level_type &next,
+    uint64_t first, uint64_t last) {
+    assert(first <= last && last <= next.size() && 2 * last <= prev.size());
+    const uint64_t count = last - first;
+    if (count < 2 * CONCAT_HASH_LEVEL_CHUNK) {
+        concat_hash_level_serial(prev, next, first, last);
+        return;
+    }
+    const uint64_t thread_count = std::min(get_hardware_thread_count(), count / CONCAT_HASH_LEVEL_CHUNK);
+    if (thread_count <= 1) {
+        concat_hash_level_serial(prev, next, first, last);
+        return;
+    }
+    // Entries are independent from one another, so each thread takes a contiguous chunk.
+    // The calling thread takes the last one, then waits for the pool to finish the others.
+    const uint64_t chunk = (count + thread_count - 1) / thread_count;
+    std::mutex mutex;
+    std::condition_variable done;
+    uint64_t pending = thread_count - 1;
+    auto &pool = get_concat_hash_level_pool();
+    for (uint64_t i = 0; i + 1 < thread_count; ++i) {
+        const uint64_t chunk_first = first + i * chunk;
+        pool.submit([&prev, &next, &mutex, &done, &pending, chunk_first, chunk]() {
+            concat_hash_level_serial(prev, next, chunk_first, chunk_first + chunk);
+            // Notify while holding the lock, since the waiting thread destroys the condition variable once woken
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        });
+    }
+    concat_hash_level_serial(prev, next, first + (thread_count - 1) * chunk, last);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&pending]() { return pending == 0; });
+}
+
 } // namespace cartesi
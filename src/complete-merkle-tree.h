@@ -17,6 +17,10 @@
 #ifndef COMPLETE_MERKLE_TREE_H
 #define COMPLETE_MERKLE_TREE_H
 
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
 #include "keccak-256-hasher.h"
 #include "merkle-tree-proof.h"
 #include "meta.h"
@@ -88,6 +92,22 @@ public:
     /// \param hash Hash to append
     void push_back(const hash_type &hash);
 
+    /// \brief Appends a range of leaf hashes to the tree
+    /// \param first Iterator to first hash to append
+    /// \param last Iterator to one past last hash to append
+    /// \details The tree is updated once for the whole range, instead of
+    /// once per leaf as with repeated calls to push_back.
+    template <typename IT>
+    void push_back_range(IT first, IT last) {
+        auto &leaves = get_level(get_log2_leaf_size());
+        const auto count = static_cast<address_type>(std::distance(first, last));
+        if (count > (address_type{1} << (get_log2_root_size() - get_log2_leaf_size())) - leaves.size()) {
+            throw std::out_of_range{"tree is full"};
+        }
+        leaves.insert(leaves.end(), first, last);
+        bubble_up();
+    }
+
     /// \brief Returns number of leaves in tree
     address_type size(void) const {
         return get_level(get_log2_leaf_size()).size();
@@ -131,6 +151,15 @@ private:
     std::vector<level_type> m_tree;  ///< Merkle tree
 };
 
+/// \brief Computes a range of entries in a tree level from the pairs of entries below them
+/// \param prev Level below, with twice as many entries as needed
+/// \param next Level receiving the entries
+/// \param first Index of first entry in next to compute
+/// \param last Index of one past last entry in next to compute
+/// \details Large ranges are split between the calling thread and a pool of threads kept for the whole process.
+void concat_hash_level(const complete_merkle_tree::level_type &prev, complete_merkle_tree::level_type &next,
+    uint64_t first, uint64_t last);
+
 } // namespace cartesi
 
 #endif
@@ -0,0 +1,160 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONSTEXPR_KECCAK_256_H
+#define CONSTEXPR_KECCAK_256_H
+
+/// \file
+/// \brief Keccak-256 hash function usable in constant expressions.
+/// \details This implementation is meant for compile-time tables only.
+/// At runtime, use keccak_256_hasher instead.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace cartesi {
+
+namespace detail {
+
+/// \brief Keccak state, as 25 lanes of 64 bits
+using keccak_state_type = std::array<uint64_t, 25>;
+
+/// \brief Keccak-256 rate, in bytes
+constexpr size_t KECCAK_256_RATE = 136;
+
+/// \brief Keccak-256 digest size, in bytes
+constexpr size_t KECCAK_256_DIGEST_SIZE = 32;
+
+constexpr uint64_t keccak_rotl(uint64_t x, int n) {
+    return n == 0 ? x : (x << n) | (x >> (64 - n));
+}
+
+/// \brief Applies the Keccak-f[1600] permutation to the state
+/// \details Written with raw arrays and precomputed lane indices, because
+/// compilers evaluate constant expressions far slower than they run code.
+constexpr void keccak_f1600(keccak_state_type &state) {
+    constexpr uint64_t round_constants[24] = {UINT64_C(0x0000000000000001), UINT64_C(0x0000000000008082),
+        UINT64_C(0x800000000000808a), UINT64_C(0x8000000080008000), UINT64_C(0x000000000000808b),
+        UINT64_C(0x0000000080000001), UINT64_C(0x8000000080008081), UINT64_C(0x8000000000008009),
+        UINT64_C(0x000000000000008a), UINT64_C(0x0000000000000088), UINT64_C(0x0000000080008009),
+        UINT64_C(0x000000008000000a), UINT64_C(0x000000008000808b), UINT64_C(0x800000000000008b),
+        UINT64_C(0x8000000000008089), UINT64_C(0x8000000000008003), UINT64_C(0x8000000000008002),
+        UINT64_C(0x8000000000000080), UINT64_C(0x000000000000800a), UINT64_C(0x800000008000000a),
+        UINT64_C(0x8000000080008081), UINT64_C(0x8000000000008080), UINT64_C(0x0000000080000001),
+        UINT64_C(0x8000000080008008)};
+    // Rho rotation offsets and pi destinations, in the order lanes are visited starting from lane 1
+    constexpr int rho[24] = {1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20,
+        44};
+    constexpr int pi[24] = {10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1};
+    uint64_t a[25] = {};
+    for (int i = 0; i < 25; ++i) {
+        a[i] = state[i];
+    }
+    for (const auto rc : round_constants) {
+        // Theta
+        uint64_t c[5] = {};
+        for (int x = 0; x < 5; ++x) {
+            c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+        }
+        for (int x = 0; x < 5; ++x) {
+            const uint64_t d = c[x == 0 ? 4 : x - 1] ^ keccak_rotl(c[x == 4 ? 0 : x + 1], 1);
+            a[x] ^= d;
+            a[x + 5] ^= d;
+            a[x + 10] ^= d;
+            a[x + 15] ^= d;
+            a[x + 20] ^= d;
+        }
+        // Rho and pi
+        uint64_t t = a[1];
+        for (int i = 0; i < 24; ++i) {
+            const uint64_t next = a[pi[i]];
+            a[pi[i]] = keccak_rotl(t, rho[i]);
+            t = next;
+        }
+        // Chi
+        for (int y = 0; y < 25; y += 5) {
+            const uint64_t b0 = a[y];
+            const uint64_t b1 = a[y + 1];
+            const uint64_t b2 = a[y + 2];
+            const uint64_t b3 = a[y + 3];
+            const uint64_t b4 = a[y + 4];
+            a[y] = b0 ^ (~b1 & b2);
+            a[y + 1] = b1 ^ (~b2 & b3);
+            a[y + 2] = b2 ^ (~b3 & b4);
+            a[y + 3] = b3 ^ (~b4 & b0);
+            a[y + 4] = b4 ^ (~b0 & b1);
+        }
+        // Iota
+        a[0] ^= rc;
+    }
+    for (int i = 0; i < 25; ++i) {
+        state[i] = a[i];
+    }
+}
+
+/// \brief XORs a byte into the state, lanes being little-endian
+constexpr void keccak_xor_byte(keccak_state_type &a, size_t offset, unsigned char byte) {
+    a[offset / 8] ^= static_cast<uint64_t>(byte) << (8 * (offset % 8));
+}
+
+} // namespace detail
+
+/// \brief Computes the Keccak-256 hash of data in a constant expression
+/// \tparam N Length of data
+/// \param data Data to hash
+/// \return The hash of data
+template <size_t N>
+constexpr std::array<unsigned char, detail::KECCAK_256_DIGEST_SIZE> constexpr_keccak_256(
+    const std::array<unsigned char, N> &data) {
+    detail::keccak_state_type a{};
+    size_t offset = 0;
+    for (size_t i = 0; i < N; ++i) {
+        detail::keccak_xor_byte(a, offset, data[i]);
+        if (++offset == detail::KECCAK_256_RATE) {
+            detail::keccak_f1600(a);
+            offset = 0;
+        }
+    }
+    // Original Keccak padding (not the SHA-3 one)
+    detail::keccak_xor_byte(a, offset, 0x01);
+    detail::keccak_xor_byte(a, detail::KECCAK_256_RATE - 1, 0x80);
+    detail::keccak_f1600(a);
+    std::array<unsigned char, detail::KECCAK_256_DIGEST_SIZE> hash{};
+    for (size_t i = 0; i < hash.size(); ++i) {
+        hash[i] = static_cast<unsigned char>(a[i / 8] >> (8 * (i % 8)));
+    }
+    return hash;
+}
+
+/// \brief Computes the Keccak-256 hash of concatenated hashes in a constant expression
+/// \param left Left hash to concatenate
+/// \param right Right hash to concatenate
+/// \return The hash of the concatenation
+constexpr std::array<unsigned char, detail::KECCAK_256_DIGEST_SIZE> constexpr_keccak_256_concat(
+    const std::array<unsigned char, detail::KECCAK_256_DIGEST_SIZE> &left,
+    const std::array<unsigned char, detail::KECCAK_256_DIGEST_SIZE> &right) {
+    std::array<unsigned char, 2 * detail::KECCAK_256_DIGEST_SIZE> data{};
+    for (size_t i = 0; i < detail::KECCAK_256_DIGEST_SIZE; ++i) {
+        data[i] = left[i];
+        data[i + detail::KECCAK_256_DIGEST_SIZE] = right[i];
+    }
+    return constexpr_keccak_256(data);
+}
+
+} // namespace cartesi
+
+#endif
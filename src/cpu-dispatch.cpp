@@ -0,0 +1,82 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "cpu-dispatch.h"
+
+// ifunc resolution needs an ELF dynamic loader, so clones are only generated for x86-64 Linux.
+// They are also skipped when the whole binary is already built for the current processor (native=yes).
+#if defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__)
+#define CPU_DISPATCH_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define CPU_DISPATCH_CLONES
+#endif
+
+namespace cartesi {
+
+const char *get_cpu_dispatch_isa(void) {
+#if defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__)
+    // Mirrors the priority order the ifunc resolver uses for target_clones. SSE2 is the x86-64 baseline.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return "avx512f";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return "avx2";
+    }
+    return "sse2";
+#elif defined(__AVX512F__)
+    return "avx512f";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+    return "neon";
+#else
+    return "generic";
+#endif
+}
+
+// The kernels below OR-reduce bytes instead of returning at the first non-null byte. The branchless form is what
+// allows the compiler to vectorize each clone for its target instruction set.
+
+CPU_DISPATCH_CLONES
+bool is_null(const unsigned char *data, size_t length) {
+    unsigned char acc = 0;
+    for (size_t i = 0; i < length; ++i) {
+        acc |= data[i];
+    }
+    return acc == 0;
+}
+
+CPU_DISPATCH_CLONES
+uint64_t count_null_terminated_entries(const unsigned char *data, size_t length, size_t entry_length) {
+    if (entry_length == 0) {
+        return 0;
+    }
+    const size_t entries = length / entry_length;
+    for (size_t count = 0; count < entries; ++count) {
+        const unsigned char *entry = data + count * entry_length;
+        unsigned char acc = 0;
+        for (size_t i = 0; i < entry_length; ++i) {
+            acc |= entry[i];
+        }
+        if (acc == 0) {
+            return count;
+        }
+    }
+    return entries;
+}
+
+} // namespace cartesi
@@ -0,0 +1,51 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// \file
+/// \brief Hot kernels compiled for several instruction set variants and selected at load time.
+/// \details On x86-64 Linux, each kernel is cloned for AVX-512 and AVX2 on top of the SSE2 baseline, and the
+/// dynamic loader picks the best clone for the running CPU (via ifunc). On AArch64, NEON is part of the baseline ISA,
+/// so the default build is already vectorized. Elsewhere, the portable version is used.
+
+namespace cartesi {
+
+/// \brief Returns the name of the instruction set variant selected for the hot kernels
+/// \return Name such as "avx512f", "avx2", "sse2", "neon", or "generic"
+const char *get_cpu_dispatch_isa(void);
+
+/// \brief Checks if all bytes in a range are null
+/// \param data Pointer to first byte
+/// \param length Number of bytes
+/// \return True if all are null, false otherwise
+bool is_null(const unsigned char *data, size_t length);
+
+/// \brief Counts number of fixed-length entries until the first entry with all bytes null
+/// \param data Pointer to first byte
+/// \param length Number of bytes
+/// \param entry_length Length of each entry
+/// \return Number of entries
+/// \details Trailing bytes that do not form a complete entry are ignored
+uint64_t count_null_terminated_entries(const unsigned char *data, size_t length, size_t entry_length);
+
+} // namespace cartesi
+
+#endif
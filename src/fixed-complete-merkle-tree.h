@@ -0,0 +1,230 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef FIXED_COMPLETE_MERKLE_TREE_H
+#define FIXED_COMPLETE_MERKLE_TREE_H
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "complete-merkle-tree.h"
+#include "fixed-merkle-tree-proof.h"
+#include "keccak-256-hasher.h"
+#include "meta.h"
+#include "pristine-hashes.h"
+
+/// \file
+/// \brief Complete Merkle tree with sizes fixed at compile time.
+
+namespace cartesi {
+
+/// \brief Complete Merkle tree with sizes fixed at compile time
+/// \details This class implements the same complete Merkle tree as
+/// complete_merkle_tree, but the tree geometry is known at compile time.
+/// Level lookups and address math are resolved statically, proofs use
+/// fixed_merkle_tree_proof, which does not allocate, and pristine hashes
+/// come from the shared table computed at compile time, so creating a
+/// tree does not hash anything.
+/// \tparam LOG2_ROOT_SIZE Log<sub>2</sub> of tree size
+/// \tparam LOG2_LEAF_SIZE Log<sub>2</sub> of leaf node
+/// \tparam LOG2_WORD_SIZE Log<sub>2</sub> of word
+template <int LOG2_ROOT_SIZE, int LOG2_LEAF_SIZE, int LOG2_WORD_SIZE>
+class fixed_complete_merkle_tree {
+public:
+    /// \brief Hasher class.
+    using hasher_type = keccak_256_hasher;
+
+    /// \brief Storage for a hash.
+    using hash_type = hasher_type::hash_type;
+
+    /// \brief Storage for an address.
+    using address_type = uint64_t;
+
+    /// \brief Storage for a proof of a node of a given size.
+    template <int LOG2_TARGET_SIZE>
+    using proof_type = fixed_merkle_tree_proof<hash_type, LOG2_ROOT_SIZE, LOG2_TARGET_SIZE, address_type>;
+
+    /// \brief Storage for a level in the tree.
+    using level_type = std::vector<hash_type>;
+
+    static_assert(LOG2_LEAF_SIZE >= 0, "log2_leaf_size is negative");
+    static_assert(LOG2_WORD_SIZE >= 0, "log2_word_size is negative");
+    static_assert(LOG2_LEAF_SIZE <= LOG2_ROOT_SIZE, "log2_leaf_size is greater than log2_root_size");
+    static_assert(LOG2_WORD_SIZE <= LOG2_LEAF_SIZE, "log2_word_size is greater than log2_leaf_size");
+    static_assert(LOG2_ROOT_SIZE < std::numeric_limits<address_type>::digits, "tree is too large for address type");
+
+    /// \brief Constructor for pristine tree
+    fixed_complete_merkle_tree(void) = default;
+
+    /// \brief Constructor from non-pristine leaves (assumed flushed left)
+    /// \param leaves Leaf hashes
+    template <typename L>
+    explicit fixed_complete_merkle_tree(L &&leaves) {
+        static_assert(std::is_same<level_type, typename remove_cvref<L>::type>::value, "not a leaves vector");
+        if (leaves.size() > get_max_leaves()) {
+            throw std::out_of_range{"too many leaves"};
+        }
+        get_level(LOG2_LEAF_SIZE) = std::forward<L>(leaves);
+        bubble_up();
+    }
+
+    /// \brief Returns log<sub>2</sub> of size of tree
+    static constexpr int get_log2_root_size(void) {
+        return LOG2_ROOT_SIZE;
+    }
+
+    /// \brief Returns log<sub>2</sub> of size of leaf
+    static constexpr int get_log2_leaf_size(void) {
+        return LOG2_LEAF_SIZE;
+    }
+
+    /// \brief Returns maximum number of leaves in tree
+    static constexpr address_type get_max_leaves(void) {
+        return address_type{1} << (LOG2_ROOT_SIZE - LOG2_LEAF_SIZE);
+    }
+
+    /// \brief Returns the tree's root hash
+    /// \returns Root hash
+    const hash_type &get_root_hash(void) const {
+        return get_node_hash(0, LOG2_ROOT_SIZE);
+    }
+
+    /// \brief Returns the hash of a node at a given address of a given size
+    /// \param address Node address
+    /// \param log2_size Log<sub>2</sub> size subintended by node
+    const hash_type &get_node_hash(address_type address, int log2_size) const {
+        const auto &level = get_level(log2_size);
+        address >>= log2_size;
+        assert(address < (address_type{1} << (LOG2_ROOT_SIZE - log2_size)) && "address is out of bounds");
+        if (address < level.size()) {
+            return level[address];
+        }
+        return pristine_hashes<LOG2_WORD_SIZE>::get_hash(log2_size);
+    }
+
+    /// \brief Returns proof for a given node
+    /// \tparam LOG2_TARGET_SIZE Log<sub>2</sub> size subintended by node
+    /// \param address Node address
+    /// \returns Proof, or throws exception
+    template <int LOG2_TARGET_SIZE>
+    proof_type<LOG2_TARGET_SIZE> get_proof(address_type address) const {
+        static_assert(LOG2_TARGET_SIZE >= LOG2_LEAF_SIZE && LOG2_TARGET_SIZE <= LOG2_ROOT_SIZE,
+            "log2_size is out of bounds");
+        if (((address >> LOG2_TARGET_SIZE) << LOG2_TARGET_SIZE) != address) {
+            throw std::out_of_range{"address is misaligned"};
+        }
+        if (address >= (address_type{1} << LOG2_ROOT_SIZE)) {
+            throw std::out_of_range{"address is out of bounds"};
+        }
+        proof_type<LOG2_TARGET_SIZE> proof;
+        proof.set_root_hash(get_root_hash());
+        proof.set_target_address(address);
+        proof.set_target_hash(get_node_hash(address, LOG2_TARGET_SIZE));
+        for (int log2_sibling_size = LOG2_TARGET_SIZE; log2_sibling_size < LOG2_ROOT_SIZE; ++log2_sibling_size) {
+            auto sibling_address = address ^ (address_type{1} << log2_sibling_size);
+            proof.set_sibling_hash(get_node_hash(sibling_address, log2_sibling_size), log2_sibling_size);
+        }
+        return proof;
+    }
+
+    /// \brief Appends a new leaf hash to the tree
+    /// \param hash Hash to append
+    void push_back(const hash_type &hash) {
+        auto &leaves = get_level(LOG2_LEAF_SIZE);
+        if (leaves.size() >= get_max_leaves()) {
+            throw std::out_of_range{"tree is full"};
+        }
+        leaves.push_back(hash);
+        bubble_up();
+    }
+
+    /// \brief Appends a range of leaf hashes to the tree
+    /// \param first Iterator to first hash to append
+    /// \param last Iterator to one past last hash to append
+    /// \details The tree is updated once for the whole range, instead of
+    /// once per leaf as with repeated calls to push_back.
+    template <typename IT>
+    void push_back_range(IT first, IT last) {
+        auto &leaves = get_level(LOG2_LEAF_SIZE);
+        const auto count = static_cast<address_type>(std::distance(first, last));
+        if (count > get_max_leaves() - leaves.size()) {
+            throw std::out_of_range{"tree is full"};
+        }
+        leaves.insert(leaves.end(), first, last);
+        bubble_up();
+    }
+
+    /// \brief Returns number of leaves in tree
+    address_type size(void) const {
+        return get_level(LOG2_LEAF_SIZE).size();
+    };
+
+private:
+    /// \brief Update node hashes when a new set of non-pristine nodes is added
+    /// to the leaf level
+    void bubble_up(void) {
+        hasher_type h;
+        // Go bottom up, updating hashes
+        for (int log2_next_size = LOG2_LEAF_SIZE + 1; log2_next_size <= LOG2_ROOT_SIZE; ++log2_next_size) {
+            auto log2_prev_size = log2_next_size - 1;
+            const auto &prev = get_level(log2_prev_size);
+            auto &next = get_level(log2_next_size);
+            // Redo last entry (if any) because it may have been constructed
+            // from the last non-pristine entry in the previous level paired
+            // with a pristine entry (i.e., the previous level was odd).
+            auto first_entry = !next.empty() ? next.size() - 1 : next.size();
+            // Next level needs half as many (rounded up) as previous
+            next.resize((prev.size() + 1) / 2);
+            assert(first_entry <= next.size());
+            // Last safe entry has two non-pristine leafs
+            auto last_safe_entry = prev.size() / 2;
+            // Do all entries for which we have two non-pristine children
+            concat_hash_level(prev, next, first_entry, last_safe_entry);
+            // Maybe do last odd entry
+            if (prev.size() > 2 * last_safe_entry) {
+                get_concat_hash(h, prev.back(), pristine_hashes<LOG2_WORD_SIZE>::get_hash(log2_prev_size),
+                    next[last_safe_entry]);
+            }
+        }
+    }
+
+    ///< \brief Returns hashes at a given level
+    ///< \param log2_size Log<sub>2</sub> of size subintended by each
+    /// hash at level
+    const level_type &get_level(int log2_size) const {
+        assert(log2_size >= LOG2_LEAF_SIZE && log2_size <= LOG2_ROOT_SIZE && "log2_size is out of bounds");
+        return m_tree[LOG2_ROOT_SIZE - log2_size];
+    }
+
+    ///< \brief Returns hashes at a given level
+    ///< \param log2_size Log<sub>2</sub> of size subintended by each
+    /// hash at level
+    level_type &get_level(int log2_size) {
+        assert(log2_size >= LOG2_LEAF_SIZE && log2_size <= LOG2_ROOT_SIZE && "log2_size is out of bounds");
+        return m_tree[LOG2_ROOT_SIZE - log2_size];
+    }
+
+    std::array<level_type, LOG2_ROOT_SIZE - LOG2_LEAF_SIZE + 1> m_tree{}; ///< Merkle tree
+};
+
+} // namespace cartesi
+
+#endif
@@ -0,0 +1,193 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef FIXED_MERKLE_TREE_PROOF_H
+#define FIXED_MERKLE_TREE_PROOF_H
+
+/// \file
+/// \brief Merkle tree proof structure with sizes fixed at compile time
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
+#include "i-hasher.h"
+#include "merkle-tree-proof.h"
+
+namespace cartesi {
+
+/// \brief Merkle tree proof structure with sizes fixed at compile time
+/// \details \{
+/// This structure holds a proof that the node spanning a LOG2_TARGET_SIZE
+/// at a given address in the tree has a certain hash.
+/// Unlike merkle_tree_proof, the sibling hashes are stored inline, so the
+/// proof never allocates, and accesses are only checked in debug builds.
+/// \}
+/// \tparam HASH_TYPE the type that holds a hash
+/// \tparam LOG2_ROOT_SIZE log<sub>2</sub> of size subintended by entire tree
+/// \tparam LOG2_TARGET_SIZE log<sub>2</sub> of size subintended by target node
+/// \tparam ADDRESS_TYPE the type that holds an address
+template <typename HASH_TYPE, int LOG2_ROOT_SIZE, int LOG2_TARGET_SIZE, typename ADDRESS_TYPE = uint64_t>
+class fixed_merkle_tree_proof final {
+    static_assert(LOG2_ROOT_SIZE > 0, "log2_root_size is not positive");
+    static_assert(LOG2_TARGET_SIZE >= 0, "log2_target_size is negative");
+    static_assert(LOG2_TARGET_SIZE <= LOG2_ROOT_SIZE, "log2_target_size is greater than log2_root_size");
+    static_assert(LOG2_ROOT_SIZE <= std::numeric_limits<ADDRESS_TYPE>::digits, "tree is too large for address type");
+
+public:
+    using hash_type = HASH_TYPE;
+
+    using address_type = ADDRESS_TYPE;
+
+    /// \brief Storage for the hashes of the siblings of all nodes along
+    /// the path from the root node to the target node.
+    using sibling_hashes_type = std::array<hash_type, LOG2_ROOT_SIZE - LOG2_TARGET_SIZE>;
+
+    /// \brief Gets log<sub>2</sub> of size subintended by entire tree.
+    /// \returns log<sub>2</sub> of size subintended by entire tree.
+    static constexpr int get_log2_root_size(void) {
+        return LOG2_ROOT_SIZE;
+    }
+
+    /// \brief Gets log<sub>2</sub> of size subintended by target node.
+    /// \returns log<sub>2</sub> of size subintended by target node.
+    static constexpr int get_log2_target_size(void) {
+        return LOG2_TARGET_SIZE;
+    }
+
+    /// \brief Set target node address
+    /// \param target_address New address.
+    void set_target_address(address_type target_address) {
+        m_target_address = target_address;
+    }
+
+    /// \brief Gets address of target node
+    /// \return Reference to hash.
+    const address_type &get_target_address(void) const {
+        return m_target_address;
+    }
+
+    /// \brief Set hash of target node
+    /// \param hash New hash.
+    void set_target_hash(const hash_type &hash) {
+        m_target_hash = hash;
+    }
+
+    /// \brief Gets hash of target node
+    /// \return Reference to hash.
+    const hash_type &get_target_hash(void) const {
+        return m_target_hash;
+    }
+
+    /// \brief Set hash of root node
+    /// \param hash New hash.
+    void set_root_hash(const hash_type &hash) {
+        m_root_hash = hash;
+    }
+
+    /// \brief Gets hash of root node
+    /// \return Reference to hash.
+    const hash_type &get_root_hash(void) const {
+        return m_root_hash;
+    }
+
+    /// \brief Get hash corresponding to log2_size from the list of siblings.
+    /// \param log2_size log<sub>2</sub> of size subintended by hash.
+    /// \return Reference to hash inside list of siblings.
+    const hash_type &get_sibling_hash(int log2_size) const {
+        return m_sibling_hashes[log2_size_to_index(log2_size)];
+    }
+
+    /// \brief Modify hash corresponding to log2_size in the list of siblings.
+    /// \param hash New hash.
+    /// \param log2_size log<sub>2</sub> of size subintended by hash.
+    void set_sibling_hash(const hash_type &hash, int log2_size) {
+        m_sibling_hashes[log2_size_to_index(log2_size)] = hash;
+    }
+
+    /// \brief Checks if two Merkle proofs are equal
+    bool operator==(const fixed_merkle_tree_proof &other) const {
+        return get_target_address() == other.get_target_address() && get_root_hash() == other.get_root_hash() &&
+            get_target_hash() == other.get_target_hash() && m_sibling_hashes == other.m_sibling_hashes;
+    }
+
+    /// \brief Checks if two Merkle proofs are different
+    bool operator!=(const fixed_merkle_tree_proof &other) const {
+        return !(operator==(other));
+    }
+
+    ///< \brief Verify if proof is valid
+    ///< \tparam HASHER_TYPE Hasher class to use
+    ///< \param h Hasher object to use
+    ///< \return True if proof is valid, false otherwise
+    template <typename HASHER_TYPE>
+    bool verify(HASHER_TYPE &&h) const {
+        return bubble_up(std::forward<HASHER_TYPE>(h), get_target_hash()) == get_root_hash();
+    }
+
+    ///< \brief Computes the root hash obtained by replacing the target hash
+    ///< \tparam HASHER_TYPE Hasher class to use
+    ///< \param h Hasher object to use
+    ///< \param new_target_hash New target hash to replace
+    ///< \return New root hash
+    template <typename HASHER_TYPE>
+    hash_type bubble_up(HASHER_TYPE &&h, const hash_type &new_target_hash) const {
+        static_assert(is_an_i_hasher<HASHER_TYPE>::value, "not an i_hasher");
+        static_assert(std::is_same<typename remove_cvref<HASHER_TYPE>::type::hash_type, hash_type>::value,
+            "incompatible hash types");
+        hash_type hash = new_target_hash;
+        for (int log2_size = LOG2_TARGET_SIZE; log2_size < LOG2_ROOT_SIZE; ++log2_size) {
+            const int bit = (get_target_address() & (static_cast<address_type>(1) << log2_size)) != 0;
+            if (bit) {
+                get_concat_hash(h, get_sibling_hash(log2_size), hash, hash);
+            } else {
+                get_concat_hash(h, hash, get_sibling_hash(log2_size), hash);
+            }
+        }
+        return hash;
+    }
+
+    /// \brief Converts to a proof with sizes known only at runtime
+    /// \return Equivalent merkle_tree_proof
+    merkle_tree_proof<hash_type, address_type> to_merkle_tree_proof(void) const {
+        merkle_tree_proof<hash_type, address_type> proof{LOG2_ROOT_SIZE, LOG2_TARGET_SIZE};
+        proof.set_target_address(get_target_address());
+        proof.set_target_hash(get_target_hash());
+        proof.set_root_hash(get_root_hash());
+        for (int log2_size = LOG2_TARGET_SIZE; log2_size < LOG2_ROOT_SIZE; ++log2_size) {
+            proof.set_sibling_hash(get_sibling_hash(log2_size), log2_size);
+        }
+        return proof;
+    }
+
+private:
+    /// \brief Converts log2_size to index into siblings array
+    /// \return Index into siblings array
+    static constexpr int log2_size_to_index(int log2_size) {
+        assert(log2_size >= LOG2_TARGET_SIZE && log2_size < LOG2_ROOT_SIZE && "log2_size is out of range");
+        return LOG2_ROOT_SIZE - 1 - log2_size;
+    }
+
+    address_type m_target_address{};        ///< Address of target node
+    hash_type m_target_hash{};              ///< Hash of target node
+    hash_type m_root_hash{};                ///< Hash of root node
+    sibling_hashes_type m_sibling_hashes{}; ///< Hashes of siblings in path from target to root
+};
+
+} // namespace cartesi
+
+#endif
@@ -0,0 +1,152 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <utility>
+
+/// \file
+/// \brief Least-recently-used cache.
+
+namespace cartesi {
+
+/// \brief Cache that evicts the least recently used entries once their total cost exceeds a capacity
+/// \tparam KEY Type of key. Must be ordered by operator<.
+/// \tparam VALUE Type of cached value
+/// \details Each entry has a cost, 1 by default, so the capacity can be a number of entries or a number of bytes.
+template <typename KEY, typename VALUE>
+class lru_cache final {
+
+    /// \brief Cached entry
+    struct entry_type {
+        KEY key;
+        VALUE value;
+        size_t cost;
+    };
+
+    using list_type = std::list<entry_type>;
+
+public:
+    /// \brief Constructor
+    /// \param capacity Maximum total cost of entries
+    explicit lru_cache(size_t capacity) : m_capacity{capacity} {}
+
+    /// \brief Looks up an entry and marks it as the most recently used
+    /// \param key Key to look up
+    /// \returns Pointer to cached value, or nullptr if not cached. Valid until the next modification.
+    const VALUE *find(const KEY &key) {
+        auto it = m_index.find(key);
+        if (it == m_index.end()) {
+            ++m_misses;
+            return nullptr;
+        }
+        ++m_hits;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return &it->second->value;
+    }
+
+    /// \brief Inserts or replaces an entry as the most recently used, evicting others as needed
+    /// \param key Key of entry
+    /// \param value Value to cache
+    /// \param cost Cost of entry. Entries costing more than the capacity are not cached.
+    void insert(const KEY &key, VALUE value, size_t cost = 1) {
+        erase(key);
+        if (cost > m_capacity) {
+            return;
+        }
+        while (m_cost + cost > m_capacity) {
+            erase(m_entries.back().key);
+        }
+        m_entries.push_front(entry_type{key, std::move(value), cost});
+        m_index.emplace(key, m_entries.begin());
+        m_cost += cost;
+    }
+
+    /// \brief Removes an entry, if cached
+    /// \param key Key of entry
+    void erase(const KEY &key) {
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_cost -= it->second->cost;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+    }
+
+    /// \brief Removes all entries whose keys satisfy a predicate
+    /// \param pred Predicate receiving a key
+    template <typename PRED>
+    void erase_if(PRED pred) {
+        for (auto it = m_index.begin(); it != m_index.end();) {
+            if (pred(it->first)) {
+                m_cost -= it->second->cost;
+                m_entries.erase(it->second);
+                it = m_index.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// \brief Removes all entries
+    void clear(void) {
+        m_index.clear();
+        m_entries.clear();
+        m_cost = 0;
+    }
+
+    /// \brief Returns number of cached entries
+    size_t size(void) const {
+        return m_index.size();
+    }
+
+    /// \brief Returns total cost of cached entries
+    size_t get_cost(void) const {
+        return m_cost;
+    }
+
+    /// \brief Returns maximum total cost of entries
+    size_t get_capacity(void) const {
+        return m_capacity;
+    }
+
+    /// \brief Returns number of lookups that found an entry
+    uint64_t get_hits(void) const {
+        return m_hits;
+    }
+
+    /// \brief Returns number of lookups that did not find an entry
+    uint64_t get_misses(void) const {
+        return m_misses;
+    }
+
+private:
+    list_type m_entries;                                 ///< Entries, most recently used first
+    std::map<KEY, typename list_type::iterator> m_index; ///< Entries by key
+    size_t m_capacity;                                   ///< Maximum total cost of entries
+    size_t m_cost{};                                     ///< Total cost of entries
+    uint64_t m_hits{};                                   ///< Number of lookups that found an entry
+    uint64_t m_misses{};                                 ///< Number of lookups that did not find an entry
+};
+
+} // namespace cartesi
+
+#endif
@@ -0,0 +1,83 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped-file.h"
+
+namespace cartesi {
+
+mapped_file::mapped_file(const std::string &path) : m_path{path} {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error{errno, std::generic_category(), "unable to open '" + path + "'"};
+    }
+    struct stat st {};
+    if (fstat(fd, &st) < 0) {
+        const int error = errno;
+        close(fd);
+        throw std::system_error{error, std::generic_category(), "unable to stat '" + path + "'"};
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    // mmap rejects zero-length mappings
+    if (m_size > 0) {
+        void *addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error{error, std::generic_category(), "unable to map '" + path + "'"};
+        }
+        m_data = static_cast<const unsigned char *>(addr);
+    }
+    // The mapping keeps its own reference to the file
+    close(fd);
+}
+
+mapped_file::~mapped_file() {
+    release();
+}
+
+mapped_file::mapped_file(mapped_file &&other) noexcept :
+    m_path{std::move(other.m_path)},
+    m_data{std::exchange(other.m_data, nullptr)},
+    m_size{std::exchange(other.m_size, 0)} {}
+
+mapped_file &mapped_file::operator=(mapped_file &&other) noexcept {
+    if (this != &other) {
+        release();
+        m_path = std::move(other.m_path);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+void mapped_file::release(void) noexcept {
+    if (m_data != nullptr) {
+        munmap(const_cast<unsigned char *>(m_data), m_size); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
+
+} // namespace cartesi
@@ -0,0 +1,72 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/// \file
+/// \brief Read-only memory-mapped file interface.
+
+namespace cartesi {
+
+/// \brief Read-only view of a file mapped into memory
+/// \details The contents are backed by the page cache, so they do not count against the process heap and can be
+/// evicted by the kernel when memory is scarce.
+class mapped_file {
+public:
+    /// \brief Maps an entire file
+    /// \param path Path to file
+    /// \details Throws std::system_error if the file cannot be opened or mapped
+    explicit mapped_file(const std::string &path);
+
+    /// \brief Unmaps the file
+    ~mapped_file();
+
+    mapped_file(const mapped_file &other) = delete;
+    mapped_file &operator=(const mapped_file &other) = delete;
+    mapped_file(mapped_file &&other) noexcept;
+    mapped_file &operator=(mapped_file &&other) noexcept;
+
+    /// \brief Returns pointer to first byte of file contents
+    const unsigned char *data(void) const {
+        return m_data;
+    }
+
+    /// \brief Returns length of file contents
+    size_t size(void) const {
+        return m_size;
+    }
+
+    /// \brief Returns path to mapped file
+    const std::string &path(void) const {
+        return m_path;
+    }
+
+private:
+    /// \brief Releases the mapping, if any
+    void release(void) noexcept;
+
+    std::string m_path;            ///< Path to mapped file
+    const unsigned char *m_data{}; ///< Start of mapping, or nullptr if file is empty
+    size_t m_size{};               ///< Length of mapping
+};
+
+} // namespace cartesi
+
+#endif
@@ -0,0 +1,95 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef PRISTINE_HASHES_H
+#define PRISTINE_HASHES_H
+
+/// \file
+/// \brief Pristine Merkle tree hashes computed at compile time.
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+#include "constexpr-keccak-256.h"
+
+namespace cartesi {
+
+/// \brief Storage for a Keccak-256 hash.
+using pristine_hash_type = std::array<unsigned char, detail::KECCAK_256_DIGEST_SIZE>;
+
+/// \brief Keccak-256 hash of a pristine subtree, computed at compile time
+/// \tparam LOG2_WORD_SIZE Log<sub>2</sub> of word
+/// \tparam LOG2_SIZE Log<sub>2</sub> of subtree size
+/// \details Each level is a separate constant expression, so no single
+/// evaluation runs more than one Keccak permutation.
+template <int LOG2_WORD_SIZE, int LOG2_SIZE>
+struct pristine_hash {
+    static_assert(LOG2_SIZE > LOG2_WORD_SIZE, "log2_size is smaller than log2_word_size");
+    static constexpr pristine_hash_type value = constexpr_keccak_256_concat(
+        pristine_hash<LOG2_WORD_SIZE, LOG2_SIZE - 1>::value, pristine_hash<LOG2_WORD_SIZE, LOG2_SIZE - 1>::value);
+};
+
+/// \brief Keccak-256 hash of a pristine word, computed at compile time
+/// \tparam LOG2_WORD_SIZE Log<sub>2</sub> of word
+template <int LOG2_WORD_SIZE>
+struct pristine_hash<LOG2_WORD_SIZE, LOG2_WORD_SIZE> {
+    static constexpr pristine_hash_type value =
+        constexpr_keccak_256(std::array<unsigned char, size_t{1} << LOG2_WORD_SIZE>{});
+};
+
+/// \brief Read-only table with the hashes of pristine subtrees of all sizes
+/// up to the whole 64-bit address space
+/// \tparam LOG2_WORD_SIZE Log<sub>2</sub> of word
+/// \details There is a single instance of each table in the program,
+/// shared by all Merkle trees with the same word size.
+template <int LOG2_WORD_SIZE>
+class pristine_hashes {
+public:
+    /// \brief Log<sub>2</sub> of largest subtree in table
+    static constexpr int LOG2_ROOT_SIZE = 64;
+
+    static_assert(LOG2_WORD_SIZE >= 0 && LOG2_WORD_SIZE <= LOG2_ROOT_SIZE, "log2_word_size is out of range");
+
+    /// \brief Storage for the table
+    using table_type = std::array<pristine_hash_type, LOG2_ROOT_SIZE - LOG2_WORD_SIZE + 1>;
+
+    /// \brief Returns hash of pristine subtree
+    /// \param log2_size Log<sub>2</sub> of subtree size. Must be between
+    /// LOG2_WORD_SIZE (inclusive) and LOG2_ROOT_SIZE (inclusive).
+    static constexpr const pristine_hash_type &get_hash(int log2_size) {
+        assert(log2_size >= LOG2_WORD_SIZE && log2_size <= LOG2_ROOT_SIZE && "log2_size is out of range");
+        return table[log2_size - LOG2_WORD_SIZE];
+    }
+
+    /// \brief Returns pointer to first entry in table, the hash of a pristine word
+    static constexpr const pristine_hash_type *data(void) {
+        return table.data();
+    }
+
+private:
+    template <size_t... I>
+    static constexpr table_type make_table(std::index_sequence<I...> /*unused*/) {
+        return {pristine_hash<LOG2_WORD_SIZE, LOG2_WORD_SIZE + static_cast<int>(I)>::value...};
+    }
+
+    static constexpr table_type table = make_table(std::make_index_sequence<LOG2_ROOT_SIZE - LOG2_WORD_SIZE + 1>{});
+};
+
+} // namespace cartesi
+
+#endif
@@ -15,18 +15,40 @@
 //
 
 #include "pristine-merkle-tree.h"
+#include "pristine-hashes.h"
 #include <cassert>
 #include <stdexcept>
+#include <type_traits>
 
 /// \file
 /// \brief Pristine Merkle tree implementation.
 
 namespace cartesi {
 
+/// \brief Hashes all pristine subtrees from a word up to the root
+/// \param log2_root_size Log<sub>2</sub> of root node
+/// \param log2_word_size Log<sub>2</sub> of word
+/// \return Vector with hashes
+static std::shared_ptr<const std::vector<pristine_merkle_tree::hash_type>> compute_hashes(int log2_root_size,
+    int log2_word_size) {
+    auto hashes = std::make_shared<std::vector<pristine_merkle_tree::hash_type>>(
+        std::max(0, log2_root_size - log2_word_size + 1));
+    std::vector<uint8_t> word(1 << log2_word_size, 0);
+    assert(word.size() == (UINT64_C(1) << log2_word_size));
+    pristine_merkle_tree::hasher_type h;
+    h.begin();
+    h.add_data(word.data(), word.size());
+    h.end((*hashes)[0]);
+    for (unsigned i = 1; i < hashes->size(); ++i) {
+        get_concat_hash(h, (*hashes)[i - 1], (*hashes)[i - 1], (*hashes)[i]);
+    }
+    return hashes;
+}
+
 pristine_merkle_tree::pristine_merkle_tree(int log2_root_size, int log2_word_size) :
     m_log2_root_size{log2_root_size},
     m_log2_word_size{log2_word_size},
-    m_hashes(std::max(0, log2_root_size - log2_word_size + 1)) {
+    m_hashes{nullptr} {
     if (log2_root_size < 0) {
         throw std::out_of_range{"log2_root_size is negative"};
     }
@@ -36,14 +58,14 @@ pristine_merkle_tree::pristine_merkle_tree(int log2_root_size, int log2_word_siz
     if (log2_word_size > log2_root_size) {
         throw std::out_of_range{"log2_word_size is greater than log2_root_size"};
     }
-    std::vector<uint8_t> word(1 << log2_word_size, 0);
-    assert(word.size() == (UINT64_C(1) << log2_word_size));
-    hasher_type h;
-    h.begin();
-    h.add_data(word.data(), word.size());
-    h.end(m_hashes[0]);
-    for (unsigned i = 1; i < m_hashes.size(); ++i) {
-        get_concat_hash(h, m_hashes[i - 1], m_hashes[i - 1], m_hashes[i]);
+    static_assert(std::is_same<hash_type, pristine_hash_type>::value, "incompatible hash types");
+    if (log2_word_size == 3 && log2_root_size <= pristine_hashes<3>::LOG2_ROOT_SIZE) {
+        m_hashes = pristine_hashes<3>::data();
+    } else if (log2_word_size == 5 && log2_root_size <= pristine_hashes<5>::LOG2_ROOT_SIZE) {
+        m_hashes = pristine_hashes<5>::data();
+    } else {
+        m_own = compute_hashes(log2_root_size, log2_word_size);
+        m_hashes = m_own->data();
     }
 }
 
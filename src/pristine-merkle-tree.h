@@ -18,6 +18,7 @@
 #define PRISTINE_MERKLE_TREE_H
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "keccak-256-hasher.h"
@@ -28,6 +29,11 @@
 namespace cartesi {
 
 /// \brief Hashes of pristine subtrees for a range of sizes
+/// \details For the word sizes used by the machine (8 bytes) and by
+/// the epoch trees (32 bytes), the hashes come from read-only tables
+/// computed at compile time and shared by all instances, so
+/// construction does not hash anything. Other word sizes are hashed
+/// at construction.
 class pristine_merkle_tree {
 public:
     /// \brief Hasher class.
@@ -50,9 +56,10 @@ public:
     const hash_type &get_hash(int log2_size) const;
 
 private:
-    int m_log2_root_size;            ///< Log<sub>2</sub> of tree size
-    int m_log2_word_size;            ///< Log<sub>2</sub> of word size
-    std::vector<hash_type> m_hashes; ///< Vector with hashes
+    int m_log2_root_size;                                ///< Log<sub>2</sub> of tree size
+    int m_log2_word_size;                                ///< Log<sub>2</sub> of word size
+    std::shared_ptr<const std::vector<hash_type>> m_own; ///< Hashes computed at runtime, if any
+    const hash_type *m_hashes;                           ///< Hashes for all sizes, starting at word size
 };
 
 } // namespace cartesi
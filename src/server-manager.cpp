@@ -22,15 +22,27 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <new>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -42,6 +54,7 @@
 #endif
 #define BOOST_LOG_DYN_LINK 1 // NOLINT(cppcoreguidelines-macro-usage)
 #include <boost/core/demangle.hpp>
+#include <boost/context/stack_traits.hpp>
 #include <boost/coroutine2/coroutine.hpp>
 #include <boost/endian/conversion.hpp>
 #include <boost/iostreams/device/null.hpp>
@@ -71,6 +84,7 @@
 #endif
 #include <grpc++/alarm.h>
 #include <grpc++/grpc++.h>
+#include <google/protobuf/io/coded_stream.h>
 #include <grpc++/resource_quota.h>
 
 #include "cartesi-machine-checkin.grpc.pb.h"
@@ -82,11 +96,18 @@
 #pragma clang diagnostic pop
 #endif
 
-#include "complete-merkle-tree.h"
+#include "back-merkle-tree.h"
+#include "batch-proof-verifier.h"
+#include "cpu-dispatch.h"
+#include "fixed-complete-merkle-tree.h"
 #include "htif-defines.h"
 #include "keccak-256-hasher.h"
+#include "lru-cache.h"
+#include "mapped-file.h"
 #include "merkle-tree-proof.h"
 #include "protobuf-util.h"
+#include "stack-pool.h"
+#include "thread-pool.h"
 
 constexpr const uint64_t ROLLUP_ADVANCE_STATE = 0;
 constexpr const uint64_t ROLLUP_INSPECT_STATE = 1;
@@ -235,6 +256,8 @@ static std::string request_metadata(const grpc::ServerContext &context) {
 // coroutine returns because it is finished, it will be deleted. If the
 // coroutine returns because it "yielded", and if it yielded
 // side_effect::shutdown, it will be deleted and the server will be shutdown.
+// If it yielded side_effect::migrate, it will be moved to the completion
+// queue of another shard (see below).
 // Otherwise, the coroutine must have yielded side_effect::none, and therefore
 // it *must* arrange for itself to arrive again in the completion queue. If it
 // doesn't arrange this, it will never be deleted. THIS WILL LEAK.
@@ -243,6 +266,16 @@ static std::string request_metadata(const grpc::ServerContext &context) {
 // immediately deleted and a dangling pointer will be returned by the completion
 // queue. THIS WILL CRASH!
 //
+// The server is split into shards, each with its own completion queue
+// served by its own dispatch thread. Every session belongs to the shard
+// selected by the hash of its id, and only that shard's thread touches
+// the session. An RPC, however, arrives in whichever shard posted the
+// handler that accepted it. Once a handler knows the session id, it
+// yields side_effect::migrate and its shard moves it to the session's
+// shard, where it resumes. Completions of the RPC itself keep arriving in
+// the shard that accepted it, which forwards them to the session's shard.
+// When the migrated handler finishes, it is sent back to be deleted there.
+//
 
 /// \brief Class to use when computing hashes
 using hasher_type = cartesi::keccak_256_hasher;
@@ -258,13 +291,76 @@ using time_point_type = std::chrono::time_point<std::chrono::system_clock>;
 
 /// \brief Desired side effect when a handler yields
 enum class side_effect {
-    none,    ///< do nothing
-    shutdown ///< shutdown server
+    none,     ///< do nothing
+    shutdown, ///< shutdown server
+    migrate   ///< move to the shard in handler_context::migrate_to
 };
 
 /// \brief A handler is simply a coroutine that returns a side_effect
 using handler_type = boost::coroutines2::coroutine<side_effect>;
 
+/// \brief Kinds of handler, each with its own coroutine stack size
+enum class handler_kind {
+    get_version,
+    get_status,
+    start_session,
+    advance_state,
+    advance_state_batch,
+    inspect_state,
+    finish_epoch,
+    finish_epoch_stream,
+    get_output_proof,
+    delete_epoch,
+    end_session,
+    get_session_status,
+    get_epoch_status,
+    watch_epoch,
+    checkin,
+    checkin_deadline,
+    inspect_replica,
+    health_check,
+    health_watch,
+    count ///< number of handler kinds
+};
+
+/// \brief Names of handler kinds, as used in the command line
+static constexpr std::array<const char *, static_cast<size_t>(handler_kind::count)> handler_kind_names = {
+    "GetVersion",
+    "GetStatus",
+    "StartSession",
+    "AdvanceState",
+    "AdvanceStateBatch",
+    "InspectState",
+    "FinishEpoch",
+    "FinishEpochStream",
+    "GetOutputProof",
+    "DeleteEpoch",
+    "EndSession",
+    "GetSessionStatus",
+    "GetEpochStatus",
+    "WatchEpoch",
+    "CheckIn",
+    "CheckInDeadline",
+    "InspectReplica",
+    "HealthCheck",
+    "HealthWatch",
+};
+
+/// \brief Returns whether handlers of a kind are posted to accept RPCs, as opposed to running internal work
+/// \param kind Kind of handler
+static constexpr bool is_accepting_kind(handler_kind kind) {
+    return kind != handler_kind::checkin_deadline && kind != handler_kind::inspect_replica;
+}
+
+/// \brief Maximum number of bytes kept mapped for the stacks of deleted handlers
+static constexpr size_t MAX_POOLED_STACK_BYTES = 64 << 20;
+
+/// \brief Maximum number of deleted handlers each shard keeps for reuse
+static constexpr size_t MAX_FREE_HANDLERS = 1024;
+
+/// \brief Minimum number of items (inputs, proofs) worth moving their processing to the worker pool
+static constexpr size_t MIN_POOL_WORK_ITEMS = 16;
+
 /// \brief Memory range description
 struct memory_range_description_type {
     uint64_t index{};
@@ -296,6 +392,12 @@ constexpr const uint64_t VOUCHER_HEADER_LENGTH = EVM_ABI_ADDRESS_LENGTH + EVM_AB
 constexpr const uint64_t EVM_ABI_INPUT_METADATA_LENGTH = EVM_ABI_ADDRESS_LENGTH + 4 * EVM_ABI_UINT64_LENGTH;
 constexpr const uint64_t EVM_ABI_STRING_HEADER_LENGTH = EVM_ABI_OFFSET_LENGTH + EVM_ABI_LENGTH_LENGTH;
 
+/// \brief Epoch Merkle tree type
+using epoch_tree_type = cartesi::fixed_complete_merkle_tree<LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE>;
+
+/// \brief Proof of an entry in an epoch Merkle tree
+using epoch_proof_type = epoch_tree_type::proof_type<LOG2_KECCAK_SIZE>;
+
 using evm_abi_input_metadata_type = std::array<uint8_t, EVM_ABI_INPUT_METADATA_LENGTH>;
 
 /// \brief Type holding an AdvanceState input for processing
@@ -305,6 +407,7 @@ struct input_type {
     }
     std::vector<uint8_t> payload;
     input_metadata_type metadata{};
+    std::chrono::steady_clock::time_point enqueued_at{std::chrono::steady_clock::now()}; ///< When input was enqueued
 };
 
 /// \brief Type holding an voucher/notice metadata generated by a processed input
@@ -343,10 +446,10 @@ enum class completion_status {
 };
 
 /// \brief Type holding an input that was successfully processed
+/// \details Only what goes into responses is kept. The hashes of the voucher and notice hashes memory ranges
+/// live in the epoch Merkle trees, so their proofs in the machine are not retained.
 struct accepted_data_type {
-    proof_type voucher_hashes_in_machine;
     std::vector<voucher_type> vouchers;
-    proof_type notice_hashes_in_machine;
     std::vector<notice_type> notices;
 };
 
@@ -354,15 +457,17 @@ struct accepted_data_type {
 using exception_data_type = std::string;
 
 /// \brief Type holding a processed input
+/// \details A processed input never changes once it is pushed to its epoch, so the ProcessedInput message served
+/// for it is encoded only once, into serialized. The payloads are then released from the structured contents, which
+/// keep only what proofs need.
 struct processed_input_type {
     uint64_t input_index;               ///< Index of input since genesis
     uint64_t epoch_input_index;         ///< Index of input in epoch
     hash_type most_recent_machine_hash; ///< Machine hash after processing input
-    proof_type voucher_hashes_in_epoch; ///< Proof of the new vouchers entry in the epoch Merkle tree
-    proof_type notice_hashes_in_epoch;  ///< Proof of the new notices entry to the epoch Merkle tree
     completion_status status;           ///< Completion status of the processed input
     std::variant<accepted_data_type, exception_data_type> processed; // Accepted data or exception data
     std::vector<report_type> reports; ///< List of reports produced while input was processed
+    std::string serialized;           ///< Serialized ProcessedInput message
 };
 
 /// \brief Type holding an InspectState request/response while it is processed
@@ -376,6 +481,7 @@ struct query_type {
     uint64_t processed_input_count{0};
     std::optional<exception_data_type> exception_data;
     std::vector<report_type> reports;
+    std::chrono::steady_clock::time_point arrived_at{std::chrono::steady_clock::now()}; ///< When query arrived
 };
 
 /// \brief State of epoch
@@ -384,16 +490,36 @@ enum class epoch_state { active, finished };
 /// \brief Type of session ids
 using id_type = std::string;
 
+/// \brief Type holding the Merkle tree of the voucher (or notice) hashes memory ranges of all inputs in an epoch
+/// \details While the epoch is active, the root is maintained by a back_merkle_tree in O(log n) memory and the
+/// leaves are only stored. The complete tree, needed for proofs, is built once, when the epoch is finished.
+struct epoch_output_tree_type {
+    cartesi::back_merkle_tree back{LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE}; ///< Root of active epoch
+    std::vector<hash_type> leaves;                                                     ///< Leaves of active epoch
+    std::optional<epoch_tree_type> complete;                                           ///< Tree of finished epoch
+};
+
+/// \brief Immutable view of an epoch, taken after it changes, that read RPCs serve without locking the session
+/// \details Processed inputs are shared with the epoch, so a snapshot costs one pointer per input. A reader holding
+/// a snapshot keeps its contents alive, even if the epoch is stored or deleted in the meantime.
+struct epoch_snapshot_type {
+    epoch_state state{epoch_state::active};                                    ///< State of epoch
+    std::vector<std::shared_ptr<const processed_input_type>> processed_inputs; ///< Processed inputs kept in memory
+    std::shared_ptr<const cartesi::mapped_file> storage; ///< Mapping of finished epoch file, if epoch was moved to disk
+};
+
 /// \brief Type holding an epoch;
 struct epoch_type {
     uint64_t epoch_index{};
     epoch_state state{epoch_state::active};
     hash_type most_recent_machine_hash{};
-    cartesi::complete_merkle_tree vouchers_tree{LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE};
-    cartesi::complete_merkle_tree notices_tree{LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE};
-    std::vector<processed_input_type> processed_inputs;
+    epoch_output_tree_type vouchers_tree;
+    epoch_output_tree_type notices_tree;
+    std::vector<std::shared_ptr<const processed_input_type>> processed_inputs;
     std::deque<input_type> pending_inputs;
-    std::optional<query_type> pending_query;
+    std::shared_ptr<const cartesi::mapped_file> storage; ///< Mapping of finished epoch file, if epoch was moved to disk
+    std::shared_ptr<const epoch_snapshot_type> snapshot; ///< Last snapshot taken, or nullptr if epoch changed since
+    std::vector<handler_type::pull_type *> watchers;     ///< WatchEpoch handlers waiting for the epoch to change
 };
 
 /// \brief Type holding the deadlines for varios server tasks
@@ -425,6 +551,46 @@ struct cycles_config_type {
     uint64_t inspect_state_increment{}; ///< Number of cycles in each increment to processing a query
 };
 
+/// \brief Policy deciding when InspectState queries waiting for the machine run between inputs
+enum class inspect_schedule_policy {
+    inspect_priority, ///< Queries run before the next input, unless it has waited longer than the latency bound
+    input_priority,   ///< Queries run only once there are no pending inputs
+    weighted,         ///< Up to a number of queries run after each run of a number of inputs
+};
+
+/// \brief Type holding how InspectState queries are scheduled between inputs
+struct inspect_schedule_type {
+    /// Policy
+    inspect_schedule_policy policy{inspect_schedule_policy::inspect_priority};
+    std::chrono::milliseconds max_input_latency{0}; ///< Input latency bound for inspect_priority (0 means unbounded)
+    uint64_t input_weight{1};                         ///< Number of inputs in each run, for weighted
+    uint64_t inspect_weight{1};                       ///< Number of queries after each run of inputs, for weighted
+};
+
+/// \brief Type holding statistics about how InspectState queries and inputs waited for the machine
+struct inspect_schedule_stats_type {
+    uint64_t inspect_count{};                        ///< Number of queries that ran on the machine
+    std::chrono::microseconds total_inspect_wait{0}; ///< Total time queries waited for the machine
+    std::chrono::microseconds max_inspect_wait{0};   ///< Longest time a query waited for the machine
+    uint64_t input_count{};                          ///< Number of inputs that started processing
+    std::chrono::microseconds total_input_lag{0};    ///< Total time inputs waited to start processing
+    std::chrono::microseconds max_input_lag{0};      ///< Longest time an input waited to start processing
+};
+
+/// \brief Type holding an input processed by a session, for its inspect replicas to replay
+struct replayed_input_type {
+    std::shared_ptr<const input_type> input; ///< Input, or nullptr if the session skipped it
+    uint64_t mcycle{};                       ///< Session mcycle after processing input
+};
+
+struct replica_type;
+
+/// \brief Type holding an InspectState query that accepts a stale read, while it waits for an inspect replica
+struct stale_query_waiter_type {
+    handler_type::pull_type *coroutine{};  ///< Handler waiting
+    std::shared_ptr<replica_type> replica; ///< Replica lent to handler, or nullptr if session has no replicas left
+};
+
 /// \brief Type holding a session;
 struct session_type {
     id_type id{};                                 ///< Session id
@@ -444,6 +610,28 @@ struct session_type {
     cycles_config_type server_cycles;             ///< Cycle count limits for various server tasks
     boost::process::group server_process_group{}; ///< remote-cartesi-machine process group
     std::string server_address{};                 ///< remote-cartesi-machine address
+    /// Read-only replicas of machine, serving InspectState in parallel with input processing
+    std::vector<std::shared_ptr<replica_type>> replicas{};
+    /// Processed inputs that some replica has yet to replay
+    std::deque<replayed_input_type> replica_log{};
+    /// Number of processed inputs since genesis before the first in replica_log
+    uint64_t replica_log_start{};
+    /// InspectState queries waiting for the machine, in arrival order
+    std::deque<query_type *> pending_queries{};
+    /// Lock for handler processing a query while no inputs are being processed
+    bool query_lock{};
+    /// Handler processing inputs that waits for the query holding query_lock
+    handler_type::pull_type *processing_waiter{};
+    /// How waiting queries are scheduled between inputs
+    inspect_schedule_type inspect_schedule{};
+    /// Inputs processed since waiting queries last ran between inputs, for the weighted policy
+    uint64_t inputs_since_queries{};
+    /// How queries and inputs waited for the machine
+    inspect_schedule_stats_type inspect_schedule_stats{};
+    /// Number of InspectState queries served from the inspect cache
+    uint64_t inspect_cache_hit_count{};
+    /// InspectState queries accepting stale reads that wait for an inspect replica to finish replaying an input
+    std::deque<stale_query_waiter_type *> stale_waiters{};
 };
 
 /// \brief Encodes an input metadata structure according to the EVM ABI
@@ -525,25 +713,242 @@ struct checkin_context {
     handler_type::pull_type *coroutine{nullptr}; ///< Coroutine that should be continued
     std::unique_ptr<grpc::Alarm> alarm;          ///< Check-in deadline alarm
     std::optional<bool> status;                  ///< Check-in status
+    std::string address;                         ///< Address of machine server that checked in
+};
+
+/// \brief Key of cached output proofs (session id, epoch index, input index in epoch, output enum, output index)
+using output_proof_key_type = std::tuple<id_type, uint64_t, uint64_t, int, uint64_t>;
+
+/// \brief Maximum number of proofs kept in the output proof cache
+static constexpr size_t OUTPUT_PROOF_CACHE_CAPACITY = 1024;
+
+/// \brief Key of cached InspectState responses (session id, machine hash, keccak of query payload)
+using inspect_cache_key_type = std::tuple<id_type, hash_type, hash_type>;
+
+/// \brief Default maximum number of InspectState queries waiting for the machine of each session
+static constexpr size_t DEFAULT_INSPECT_QUEUE_DEPTH = 64;
+
+/// \brief Default number of bytes of InspectState responses kept in the inspect cache of each shard
+static constexpr size_t DEFAULT_INSPECT_CACHE_SIZE = 16 << 20;
+
+struct server_context;
+struct handler_context;
+
+/// \brief Function that creates a handler and starts accepting requests
+using new_handler_type = handler_type::pull_type *(*)(handler_context &);
+
+/// \brief Counters of how RPCs of one kind found the handlers posted to accept them
+/// \details Written by the dispatch thread of the shard and read by GetStatus from any shard
+struct accept_stats_type {
+    std::atomic<uint64_t> arrivals{0};     ///< Number of RPCs accepted
+    std::atomic<uint64_t> exhausted{0};    ///< Number of times the last posted handler was taken
+    std::atomic<uint64_t> exhausted_us{0}; ///< Microseconds spent with no handler posted
 };
 
-/// \brief Context shared by all handlers
+/// \brief Context shared by all handlers in a shard
 struct handler_context {
+    server_context *server{};                           ///< Context shared by all shards
     std::string remote_cartesi_machine_path;            ///< Path to remote-cartesi-machine executable
     std::string manager_address;                        ///< Address to which manager is bound
     std::string server_address;                         ///< Address to which machine servers are bound
-    std::unordered_map<id_type, session_type> sessions; ///< Known sessions
+    std::string epoch_storage_directory;                ///< Directory receiving finished epochs (empty if disabled)
+    bool proof_self_check{true};                        ///< Verify output proofs sliced from machine proofs
+    /// Maximum number of queries waiting for the machine of a session
+    size_t inspect_queue_depth{DEFAULT_INSPECT_QUEUE_DEPTH};
+    std::unordered_map<id_type, session_type> sessions; ///< Sessions belonging to shard
+    /// Guards insertions and removals in sessions, and reads from other shards
+    std::mutex sessions_mutex;
+    /// Recently served output proofs
+    cartesi::lru_cache<output_proof_key_type, Proof> output_proof_cache{OUTPUT_PROOF_CACHE_CAPACITY};
+    /// Recently served InspectState responses, costing their size in bytes
+    cartesi::lru_cache<inspect_cache_key_type, InspectStateResponse> inspect_cache{DEFAULT_INSPECT_CACHE_SIZE};
     /// Sessions waiting for server checkin
     std::unordered_map<id_type, checkin_context> sessions_waiting_checkin;
+    /// Handlers accepted by this shard that migrated to the shard of their session
+    std::unordered_map<handler_type::pull_type *, handler_context *> migrated;
+    /// Handlers that migrated to this shard from the shard that accepted them
+    std::unordered_map<handler_type::pull_type *, handler_context *> adopted;
+    std::mutex retired_mutex; ///< Guards retired
+    /// Migrated handlers that finished in another shard and must be deleted here
+    std::vector<handler_type::pull_type *> retired;
+    std::mutex forwarded_mutex; ///< Guards forwarded
+    /// Status of completions that the shard that accepted an adopted handler forwarded here
+    std::unordered_map<handler_type::pull_type *, bool> forwarded;
+    handler_context *migrate_to{};                                 ///< Target of handler yielding side_effect::migrate
+    std::unique_ptr<grpc::ServerCompletionQueue> completion_queue; ///< Completion queue where shard handlers arrive
+    std::vector<handler_type::pull_type *> drained;                ///< Handlers left in queue during shutdown
+    std::vector<void *> free_handlers;                             ///< Memory of deleted handlers, for reuse
+    /// Number of handlers of each kind waiting for an RPC to arrive
+    std::array<uint64_t, static_cast<size_t>(handler_kind::count)> posted_handlers{};
+    /// Number of handlers of each kind taken by arriving RPCs and not yet replaced
+    std::array<uint64_t, static_cast<size_t>(handler_kind::count)> taken_handlers{};
+    /// Function creating the replacements of each kind of handler taken
+    std::array<new_handler_type, static_cast<size_t>(handler_kind::count)> replacements{};
+    /// When each kind of handler with none posted ran out of them
+    std::array<std::chrono::steady_clock::time_point, static_cast<size_t>(handler_kind::count)> exhausted_since{};
+    /// How RPCs of each kind found the handlers posted to accept them
+    std::array<accept_stats_type, static_cast<size_t>(handler_kind::count)> accept_stats{};
+    bool refill_pending{false}; ///< Some handlers taken by arriving RPCs were not yet replaced
+    bool ok;                                                       ///< gRPC status of requests arriving in queue
+};
+
+/// \brief Manager service. GetEpochStatus is a raw method, so its responses can splice serialized processed inputs.
+using manager_async_service_type = ServerManager::WithRawMethod_GetEpochStatus<ServerManager::AsyncService>;
+
+/// \brief Context shared by all shards
+struct server_context {
     /// Health status of each service
     std::unordered_map<service_name_type, health_status_type> service_health;
-    ServerManager::AsyncService manager_async_service;             ///< Assynchronous manager service
-    MachineCheckIn::AsyncService checkin_async_service;            ///< Assynchronous checkin service
-    grpc::health::v1::Health::AsyncService health_async_service;   ///< Assynchronous health check service
-    std::unique_ptr<grpc::ServerCompletionQueue> completion_queue; ///< Completion queue where all handlers arrive
-    bool ok;                                                       ///< gRPC status of requests arriving in queue
+    manager_async_service_type manager_async_service;            ///< Assynchronous manager service
+    MachineCheckIn::AsyncService checkin_async_service;          ///< Assynchronous checkin service
+    grpc::health::v1::Health::AsyncService health_async_service; ///< Assynchronous health check service
+    /// Guards replica_shards and next_replica_serial. Declared before shards, which hold the replicas.
+    std::mutex replicas_mutex;
+    /// Shard of the session each inspect replica belongs to, by replica id
+    std::unordered_map<id_type, handler_context *> replica_shards;
+    uint64_t next_replica_serial{}; ///< Serial number of next inspect replica, which makes its id unique
+    std::vector<std::unique_ptr<handler_context>> shards;        ///< Shards, each with its own dispatch thread
+    std::mutex shutdown_mutex;                                   ///< Guards shutdown state
+    std::condition_variable shutdown_cv;                         ///< Signals changes in shutdown state
+    bool shutdown_requested{false};                              ///< A handler yielded side_effect::shutdown
+    std::atomic<bool> stopping{false};                           ///< Shards must stop resuming handlers
+    size_t stopped_shards{0};                                    ///< Number of shards that stopped resuming handlers
+    cartesi::stack_pool stack_pool{MAX_POOLED_STACK_BYTES};      ///< Stacks of handler coroutines
+    /// Coroutine stack size of each kind of handler
+    std::array<size_t, static_cast<size_t>(handler_kind::count)> stack_size{};
+    /// Number of handlers of each kind each shard keeps waiting for RPCs
+    std::array<size_t, static_cast<size_t>(handler_kind::count)> accept_depth{};
+    std::atomic<uint64_t> live_handlers{0}; ///< Number of handlers allocated and not yet deleted
+    std::unique_ptr<cartesi::thread_pool> worker_pool; ///< Runs CPU-heavy work off the dispatch threads
+};
+
+/// \brief Maximum number of inspect replicas in a session
+static constexpr uint64_t MAX_INSPECT_REPLICAS = 16;
+
+/// \brief Type holding a read-only replica of a session's machine, serving InspectState in parallel with inputs
+/// \details A replica is a remote-cartesi-machine of its own, loaded from the same directory as the session's
+/// machine. It follows the session by replaying the inputs the session accepted, ignoring their outputs. Skipped
+/// inputs leave the machine as it was, so they are not replayed. Queries run on a replica between snapshot and
+/// rollback, just as they do on the session's machine.
+/// While the replica exists, its id is registered with the server, so the check-ins of its machine server reach the
+/// shard of its session. Its machine server is terminated with the process group once the replica is destroyed.
+struct replica_type {
+    /// \brief Constructor registers replica
+    /// \param shard Handler context of the session's shard
+    /// \param session Session the replica belongs to
+    replica_type(handler_context &shard, const session_type &session) : server{*shard.server} {
+        std::lock_guard<std::mutex> lock(server.replicas_mutex);
+        machine.id = session.id + "#replica-" + std::to_string(server.next_replica_serial++);
+        server.replica_shards.emplace(machine.id, &shard);
+        machine.processed_input_count = session.processed_input_count;
+        machine.max_input_payload_length = session.max_input_payload_length;
+        machine.memory_range = session.memory_range;
+        machine.server_deadline = session.server_deadline;
+        machine.server_cycles = session.server_cycles;
+    }
+
+    replica_type(const replica_type &other) = delete;
+    replica_type(replica_type &&other) = delete;
+    replica_type &operator=(const replica_type &other) = delete;
+    replica_type &operator=(replica_type &&other) = delete;
+
+    /// \brief Destructor unregisters replica
+    ~replica_type() {
+        std::lock_guard<std::mutex> lock(server.replicas_mutex);
+        server.replica_shards.erase(machine.id);
+    }
+
+    server_context &server; ///< Context where replica is registered
+    session_type machine;   ///< Machine server of replica, with the limits of its session
+    bool busy{true};        ///< A handler is starting, refreshing, or querying the replica
 };
 
+/// \brief Allocates memory for a new handler, reusing the memory of a deleted handler if possible
+/// \param hctx Handler context of shard creating the handler
+/// \returns Memory where handler must be constructed with a stack allocator from get_stack_allocator
+static handler_type::pull_type *allocate_handler(handler_context &hctx) {
+    void *h = nullptr;
+    if (hctx.free_handlers.empty()) {
+        h = operator new(sizeof(handler_type::pull_type));
+    } else {
+        h = hctx.free_handlers.back();
+        hctx.free_handlers.pop_back();
+    }
+    hctx.server->live_handlers++;
+    return static_cast<handler_type::pull_type *>(h);
+}
+
+/// \brief Returns the stack allocator for a new handler
+/// \param hctx Handler context of shard creating the handler
+/// \param kind Kind of handler
+static cartesi::stack_pool::allocator get_stack_allocator(handler_context &hctx, handler_kind kind) {
+    auto &server = *hctx.server;
+    return server.stack_pool.get_allocator(server.stack_size[static_cast<size_t>(kind)]);
+}
+
+/// \brief Deletes a handler, returning its stack to the pool and keeping its memory for reuse
+/// \param hctx Handler context of shard deleting the handler
+/// \param h Handler
+static void delete_handler(handler_context &hctx, handler_type::pull_type *h) {
+    std::destroy_at(h);
+    if (hctx.free_handlers.size() < MAX_FREE_HANDLERS) {
+        hctx.free_handlers.push_back(h);
+    } else {
+        operator delete(h);
+    }
+    hctx.server->live_handlers--;
+}
+
+/// \brief Posts a handler to accept an RPC
+/// \param hctx Handler context of shard
+/// \param kind Kind of handler
+/// \param new_handler Function creating the handler
+static void post_handler(handler_context &hctx, handler_kind kind, new_handler_type new_handler) {
+    new_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+    ++hctx.posted_handlers[static_cast<size_t>(kind)];
+}
+
+/// \brief Records the arrival of an RPC, leaving the handler it took to be replaced by refill_handlers
+/// \param hctx Handler context of shard
+/// \param kind Kind of handler
+/// \param new_handler Function creating the replacement
+/// \details The arriving RPC runs first, and the replacement is only posted once the handler yields. If the
+/// arrival took the last posted handler of its kind, RPCs of that kind arriving in the meantime find no handler
+/// and are buffered by gRPC, so the time until the replacement is posted is accounted as exhausted.
+static void replace_handler(handler_context &hctx, handler_kind kind, new_handler_type new_handler) {
+    const auto k = static_cast<size_t>(kind);
+    hctx.accept_stats[k].arrivals++;
+    if (--hctx.posted_handlers[k] == 0) {
+        hctx.exhausted_since[k] = std::chrono::steady_clock::now();
+        hctx.accept_stats[k].exhausted++;
+    }
+    hctx.replacements[k] = new_handler;
+    ++hctx.taken_handlers[k];
+    hctx.refill_pending = true;
+}
+
+/// \brief Posts the replacements of all handlers taken by arriving RPCs since the last call
+/// \param hctx Handler context of shard
+static void refill_handlers(handler_context &hctx) {
+    if (!hctx.refill_pending) {
+        return;
+    }
+    hctx.refill_pending = false;
+    for (size_t k = 0; k < hctx.taken_handlers.size(); ++k) {
+        if (hctx.taken_handlers[k] == 0) {
+            continue;
+        }
+        if (hctx.posted_handlers[k] == 0) {
+            const auto exhausted = std::chrono::steady_clock::now() - hctx.exhausted_since[k];
+            hctx.accept_stats[k].exhausted_us +=
+                std::chrono::duration_cast<std::chrono::microseconds>(exhausted).count();
+        }
+        for (; hctx.taken_handlers[k] > 0; --hctx.taken_handlers[k]) {
+            post_handler(hctx, static_cast<handler_kind>(k), hctx.replacements[k]);
+        }
+    }
+}
+
 /// \brief Context for internal functions that need to perform async operations
 struct async_context {
     session_type &session;
@@ -559,6 +964,133 @@ static void enqueue_completion_queue(grpc::ServerCompletionQueue *cq, handler_ty
     alarm.Set(cq, gpr_now(gpr_clock_type::GPR_CLOCK_REALTIME), self);
 }
 
+/// \brief Returns the shard a session belongs to
+/// \param hctx Handler context of any shard
+/// \param id Session id
+static handler_context &get_session_shard(handler_context &hctx, const id_type &id) {
+    auto &shards = hctx.server->shards;
+    return *shards[std::hash<id_type>{}(id) % shards.size()];
+}
+
+/// \brief Returns the shard of the session an inspect replica belongs to
+/// \param server Context shared by all shards
+/// \param id Replica id
+/// \returns Handler context of shard, or nullptr if id is not of an inspect replica
+static handler_context *find_replica_shard(server_context &server, const id_type &id) {
+    std::lock_guard<std::mutex> lock(server.replicas_mutex);
+    auto it = server.replica_shards.find(id);
+    return it != server.replica_shards.end() ? it->second : nullptr;
+}
+
+/// \brief Moves a handler to a shard
+/// \param hctx Handler context of shard running the handler
+/// \param shard Handler context of target shard
+/// \param self Handler coroutine
+/// \param yield Handler yield object
+/// \returns Handler context of shard that now runs the handler
+/// \details From here on, the handler must use the returned context for everything but the RPC it is serving
+static handler_context &enter_shard(handler_context &hctx, handler_context &shard, handler_type::pull_type *self,
+    handler_type::push_type &yield) {
+    if (&shard != &hctx) {
+        hctx.migrate_to = &shard;
+        yield(side_effect::migrate);
+        // Here we are running in the dispatch thread of the target shard
+        shard.adopted.emplace(self, &hctx);
+    }
+    return shard;
+}
+
+/// \brief Moves a handler to the shard a session belongs to
+/// \param hctx Handler context of shard running the handler
+/// \param id Session id
+/// \param self Handler coroutine
+/// \param yield Handler yield object
+/// \returns Handler context of shard that now runs the handler
+/// \details From here on, the handler must use the returned context for everything but the RPC it is serving
+static handler_context &enter_session_shard(handler_context &hctx, const id_type &id, handler_type::pull_type *self,
+    handler_type::push_type &yield) {
+    return enter_shard(hctx, get_session_shard(hctx, id), self, yield);
+}
+
+/// \brief Adds a session to a shard, replacing any session with the same id
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \param session Session to add
+/// \returns Reference to session in shard
+static session_type &insert_session(handler_context &shard, const id_type &id, session_type &&session) {
+    std::lock_guard<std::mutex> lock(shard.sessions_mutex);
+    return shard.sessions[id] = std::move(session);
+}
+
+/// \brief Resumes the WatchEpoch handlers waiting for an epoch to change
+/// \param shard Handler context of the session's shard
+/// \param e Epoch that changed
+static void wake_epoch_watchers(handler_context &shard, epoch_type &e) {
+    for (auto *h : e.watchers) {
+        enqueue_completion_queue(shard.completion_queue.get(), h);
+    }
+    e.watchers.clear();
+}
+
+/// \brief Resumes the WatchEpoch handlers waiting for any epoch in a session to change
+/// \param shard Handler context of the session's shard
+/// \param session Session that changed
+static void wake_session_watchers(handler_context &shard, session_type &session) {
+    for (auto &entry : session.epochs) {
+        wake_epoch_watchers(shard, entry.second);
+    }
+}
+
+/// \brief Marks a session as tainted
+/// \param shard Handler context of the session's shard
+/// \param session Session to taint
+/// \param status Reason for taint
+static void set_session_taint(handler_context &shard, session_type &session, const grpc::Status &status) {
+    session.tainted = true;
+    session.taint_status = status;
+    wake_session_watchers(shard, session);
+}
+
+/// \brief Removes a session from a shard
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \details Handlers watching the session's epochs are resumed, so they find the session gone
+static void erase_session(handler_context &shard, const id_type &id) {
+    auto it = shard.sessions.find(id);
+    if (it != shard.sessions.end()) {
+        wake_session_watchers(shard, it->second);
+    }
+    std::lock_guard<std::mutex> lock(shard.sessions_mutex);
+    shard.sessions.erase(id);
+}
+
+/// \brief Runs work in the worker pool, while the handler yields, then resumes the handler in its shard
+/// \param hctx Handler context of shard running the handler
+/// \param self Handler coroutine
+/// \param yield Handler yield object
+/// \param work Work to run. Until it is done, other handlers in the shard run, so it must not touch anything
+/// they may touch.
+/// \details Exceptions thrown by work are rethrown in the handler
+template <typename F>
+static void await_on_pool(handler_context &hctx, handler_type::pull_type *self, handler_type::push_type &yield,
+    F &&work) {
+    std::exception_ptr error;
+    auto *cq = hctx.completion_queue.get();
+    hctx.server->worker_pool->submit([&work, &error, cq, self]() {
+        try {
+            work();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // Even if we get here before the handler yields, only the dispatch thread that is running it can resume it
+        enqueue_completion_queue(cq, self);
+    });
+    yield(side_effect::none);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
 /// \brief Checks if integer is a power of 2
 /// \param value Integer to test
 /// \return True if integer is power of 2, false otherwise
@@ -615,16 +1147,17 @@ private:
 /// \brief Creates a new handler for the GetVersion RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_GetVersion_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::get_version);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         Void request;
         ServerAsyncResponseWriter<GetVersionResponse> writer(&request_context);
         auto *cq = hctx.completion_queue.get();
-        hctx.manager_async_service.RequestGetVersion(&request_context, &request, &writer, cq, cq, self);
+        hctx.server->manager_async_service.RequestGetVersion(&request_context, &request, &writer, cq, cq, self);
         yield(side_effect::none);
-        new_GetVersion_handler(hctx);
+        replace_handler(hctx, handler_kind::get_version, new_GetVersion_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received GetVersion RPC with handle_context ok set to false";
@@ -645,19 +1178,56 @@ static handler_type::pull_type *new_GetVersion_handler(handler_context &hctx) {
     return self;
 }
 
+/// \brief Fills out the handler, coroutine stack and accept counters of a server
+/// \param server Server context
+/// \param proto_stats Pointer to proto HandlerStatistics receiving the counters
+static void set_proto_handler_stats(const server_context &server, HandlerStatistics *proto_stats) {
+    const auto stack_stats = server.stack_pool.get_stats();
+    proto_stats->set_live_handler_count(server.live_handlers);
+    proto_stats->set_stacks_in_use(stack_stats.stacks_in_use);
+    proto_stats->set_stack_bytes_in_use(stack_stats.bytes_in_use);
+    proto_stats->set_stacks_pooled(stack_stats.stacks_pooled);
+    proto_stats->set_stack_bytes_pooled(stack_stats.bytes_pooled);
+    proto_stats->set_stack_allocation_count(stack_stats.allocations);
+    proto_stats->set_stack_reuse_count(stack_stats.reused);
+    // Accept counters are kept by each shard, and summed over all of them
+    proto_stats->mutable_accept()->Reserve(static_cast<int>(handler_kind_names.size()));
+    for (size_t k = 0; k < handler_kind_names.size(); ++k) {
+        if (!is_accepting_kind(static_cast<handler_kind>(k))) {
+            continue;
+        }
+        auto *proto_accept = proto_stats->add_accept();
+        proto_accept->set_rpc(handler_kind_names[k]);
+        proto_accept->set_depth(server.accept_depth[k]);
+        uint64_t arrivals = 0;
+        uint64_t exhausted = 0;
+        uint64_t exhausted_us = 0;
+        for (const auto &shard : server.shards) {
+            const auto &stats = shard->accept_stats[k];
+            arrivals += stats.arrivals;
+            exhausted += stats.exhausted;
+            exhausted_us += stats.exhausted_us;
+        }
+        proto_accept->set_arrival_count(arrivals);
+        proto_accept->set_exhausted_count(exhausted);
+        proto_accept->set_exhausted_us(exhausted_us);
+    }
+}
+
 /// \brief Creates a new handler for the GetStatus RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_GetStatus_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::get_status);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         Void request;
         ServerAsyncResponseWriter<GetStatusResponse> writer(&request_context);
         auto *cq = hctx.completion_queue.get();
-        hctx.manager_async_service.RequestGetStatus(&request_context, &request, &writer, cq, cq, self);
+        hctx.server->manager_async_service.RequestGetStatus(&request_context, &request, &writer, cq, cq, self);
         yield(side_effect::none);
-        new_GetStatus_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        replace_handler(hctx, handler_kind::get_status, new_GetStatus_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) { // NOLINT: Unknown. Maybe linter bug?
             LOG_CONTEXT(error, request_context) << "Received GetStatus RPC with handle_context ok set to false";
@@ -666,10 +1236,15 @@ static handler_type::pull_type *new_GetStatus_handler(handler_context &hctx) {
         LOG_CONTEXT(info, request_context) << "Received GetStatus"; // NOLINT: avoid boost warnings?
         Status status;
         GetStatusResponse response;
-        for (const auto &[session_id, session] : hctx.sessions) {
-            LOG_CONTEXT(debug, request_context) << "  " << session_id;
-            response.add_session_id(session_id);
+        // Sessions are spread over all shards
+        for (auto &shard : hctx.server->shards) {
+            std::lock_guard<std::mutex> lock(shard->sessions_mutex);
+            for (const auto &[session_id, session] : shard->sessions) {
+                LOG_CONTEXT(debug, request_context) << "  " << session_id;
+                response.add_session_id(session_id);
+            }
         }
+        set_proto_handler_stats(*hctx.server, response.mutable_handler_statistics());
         writer.Finish(response, grpc::Status::OK, self); // NOLINT: Unknown. Maybe linter bug?
         yield(side_effect::none);
     }};
@@ -698,15 +1273,63 @@ static void store(async_context &actx, const std::string &directory) {
     CHECK_STATUS_OR_FAIL(status, "store", actx.request_context);
 }
 
-/// \brief Marks epoch finished and update all proofs now that all leaves are present
+/// \brief Appends the hash of an input's voucher (or notice) hashes memory range to an epoch tree
+/// \param t Epoch tree
+/// \param hash Hash to append
+static void push_back(epoch_output_tree_type &t, const hash_type &hash) {
+    assert(!t.complete.has_value());
+    t.back.push_back(hash);
+    t.leaves.push_back(hash);
+}
+
+/// \brief Returns the number of leaves in an epoch tree
+/// \param t Epoch tree
+static uint64_t get_leaf_count(const epoch_output_tree_type &t) {
+    return t.complete.has_value() ? t.complete->size() : t.leaves.size();
+}
+
+/// \brief Returns the root hash of an epoch tree
+/// \param t Epoch tree
+static hash_type get_epoch_root_hash(const epoch_output_tree_type &t) {
+    return t.complete.has_value() ? t.complete->get_root_hash() : t.back.get_root_hash();
+}
+
+/// \brief Returns the proof for the voucher (or notice) hashes memory range of an input in a finished epoch tree
+/// \param t Epoch tree
+/// \param epoch_input_index Index of input in epoch
+static epoch_proof_type get_output_hashes_in_epoch_proof(const epoch_output_tree_type &t,
+    uint64_t epoch_input_index) {
+    return t.complete.value().get_proof<LOG2_KECCAK_SIZE>(epoch_input_index << LOG2_KECCAK_SIZE);
+}
+
+/// \brief Builds the complete epoch tree from the leaves of an epoch tree, leaving the epoch tree untouched
+/// \param t Epoch tree
+/// \returns Complete tree, already checked against the root of the back tree
+static epoch_tree_type build_complete_epoch_tree(const epoch_output_tree_type &t) {
+    epoch_tree_type complete{std::vector<hash_type>{t.leaves}};
+    if (complete.get_root_hash() != t.back.get_root_hash()) {
+        throw std::logic_error{"complete and back epoch Merkle trees disagree"};
+    }
+    return complete;
+}
+
+/// \brief Replaces the leaves of an epoch tree with its complete tree
+/// \param t Epoch tree
+/// \param complete Complete tree returned by build_complete_epoch_tree
+static void complete_epoch_tree(epoch_output_tree_type &t, epoch_tree_type &&complete) {
+    t.complete.emplace(std::move(complete));
+    t.leaves = std::vector<hash_type>{};
+}
+
+/// \brief Builds the complete Merkle trees of an epoch now that all leaves are present, then marks it finished
 /// \param e Associated epoch
+/// \details Both trees are built and checked before the epoch changes, so it is left untouched if they fail.
 static void finish_epoch(epoch_type &e) {
+    auto vouchers = build_complete_epoch_tree(e.vouchers_tree);
+    auto notices = build_complete_epoch_tree(e.notices_tree);
+    complete_epoch_tree(e.vouchers_tree, std::move(vouchers));
+    complete_epoch_tree(e.notices_tree, std::move(notices));
     e.state = epoch_state::finished;
-    for (auto &i : e.processed_inputs) {
-        i.voucher_hashes_in_epoch =
-            e.vouchers_tree.get_proof(i.epoch_input_index << LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE);
-        i.notice_hashes_in_epoch = e.notices_tree.get_proof(i.epoch_input_index << LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE);
-    }
 }
 
 /// \brief Start a new epoch in session
@@ -720,11 +1343,165 @@ static void start_new_epoch(epoch_type &prev_epoch, session_type &session) {
     session.epochs[e.epoch_index] = std::move(e);
 }
 
+/// \brief Returns the snapshot of an epoch, taking a new one if the epoch changed since the last
+/// \param e Associated epoch
+/// \returns Snapshot of epoch
+/// \details Taking a snapshot copies one pointer per processed input, so it is only done when a read RPC asks for
+/// it after the epoch changed. Handlers that let the worker pool change an epoch take its snapshot beforehand, so
+/// read RPCs never look at the epoch itself while it changes.
+static std::shared_ptr<const epoch_snapshot_type> get_epoch_snapshot(epoch_type &e) {
+    if (!e.snapshot) {
+        e.snapshot = std::make_shared<const epoch_snapshot_type>(
+            epoch_snapshot_type{e.state, e.processed_inputs, e.storage});
+    }
+    return e.snapshot;
+}
+
 /// \brief Gives a description for why the session was locked
 static std::string get_session_lock_reason(const std::string &rpc, const std::string &peer) {
     return "RPC " + rpc + " from " + peer;
 }
 
+/// \brief Makes sure no InspectState query is using or waiting for the machine, or a replica, of a session
+/// \param session Session
+/// \param request_context Context of the RPC about to use the machine or end the session
+/// \details Queries do not lock the session. A query may even run between inputs after the last one was processed,
+/// while process_pending_inputs still holds the processing lock.
+static void check_no_pending_queries(const session_type &session, const grpc::ServerContext &request_context) {
+    if (session.processing_lock || session.query_lock || !session.pending_queries.empty() ||
+        !session.stale_waiters.empty()) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
+                          "concurrent query in session (" + std::to_string(session.pending_queries.size()) +
+                              " pending queries)"}),
+            request_context);
+    }
+}
+
+/// \brief Converts C++ address to proto Address
+/// \param a C++ address to convert
+/// \param proto_a Pointer to proto Address receiving result of conversion
+static void set_proto_evm_address(const evm_address_type &a, Address *proto_a) {
+    proto_a->set_data(a.data(), a.size());
+}
+
+/// \brief Converts proto Address to C++ address
+/// \param proto_a Proto Address to convert
+/// \returns Converted C++ address
+evm_address_type get_proto_evm_address(const Address &proto_a) {
+    evm_address_type a;
+    if (proto_a.data().size() != a.size()) {
+        throw std::invalid_argument("invalid address size");
+    }
+    memcpy(a.data(), proto_a.data().data(), proto_a.data().size());
+    return a;
+}
+
+/// \brief Fills out Voucher message from structure
+/// \param i Structure
+/// \param proto_i Pointer to message receiving structure contents
+static void set_proto_voucher(const voucher_type &o, Voucher *proto_o) {
+    set_proto_evm_address(o.destination, proto_o->mutable_destination());
+    proto_o->set_payload(o.payload);
+}
+
+/// \brief Fills out Notice message from structure
+/// \param m Structure
+/// \param proto_m Pointer to message receiving structure contents
+static void set_proto_notice(const notice_type &m, Notice *proto_m) {
+    proto_m->set_payload(m.payload);
+}
+
+/// \brief Fills out Report message from structure
+/// \param m Structure
+/// \param proto_m Pointer to message receiving structure contents
+static void set_proto_report(const report_type &m, Report *proto_m) {
+    proto_m->set_payload(m.payload);
+}
+
+/// \brief Fills out ProcessedInput accepted data message from structure
+/// \param i Structure
+/// \param proto_i Pointer to message receiving structure contents
+static void set_proto_accepted_data(const processed_input_type &i, ProcessedInput *proto_i) {
+    if (std::holds_alternative<accepted_data_type>(i.processed)) {
+        const auto &data = std::get<accepted_data_type>(i.processed);
+        auto *accepted_data_p = proto_i->mutable_accepted_data();
+        for (const auto &o : data.vouchers) {
+            set_proto_voucher(o, accepted_data_p->add_vouchers());
+        }
+        for (const auto &m : data.notices) {
+            set_proto_notice(m, accepted_data_p->add_notices());
+        }
+    }
+}
+
+/// \brief Fills out ProcessedInput exception data message from structure
+/// \param i Structure
+/// \param proto_i Pointer to message receiving structure contents
+static void set_proto_exception_data(const processed_input_type &i, ProcessedInput *proto_i) {
+    if (std::holds_alternative<std::string>(i.processed)) {
+        const auto &data = std::get<std::string>(i.processed);
+        proto_i->set_exception_data(data);
+    }
+}
+
+/// \brief Fills out ProcessedInput message from structure
+/// \param i Structure, still holding its payloads
+/// \param proto_i Pointer to message receiving structure contents
+static void set_proto_processed_input(const processed_input_type &i, ProcessedInput *proto_i) {
+    proto_i->set_input_index(i.input_index);
+    for (const auto &r : i.reports) {
+        set_proto_report(r, proto_i->add_reports());
+    }
+    switch (i.status) {
+        case completion_status::accepted:
+            proto_i->set_status(CompletionStatus::ACCEPTED);
+            set_proto_accepted_data(i, proto_i);
+            break;
+        case completion_status::rejected:
+            proto_i->set_status(CompletionStatus::REJECTED);
+            break;
+        case completion_status::exception:
+            proto_i->set_status(CompletionStatus::EXCEPTION);
+            set_proto_exception_data(i, proto_i);
+            break;
+        case completion_status::machine_halted:
+            proto_i->set_status(CompletionStatus::MACHINE_HALTED);
+            break;
+        case completion_status::cycle_limit_exceeded:
+            proto_i->set_status(CompletionStatus::CYCLE_LIMIT_EXCEEDED);
+            break;
+        case completion_status::time_limit_exceeded:
+            proto_i->set_status(CompletionStatus::TIME_LIMIT_EXCEEDED);
+            break;
+        case completion_status::payload_length_limit_exceeded:
+            proto_i->set_status(CompletionStatus::PAYLOAD_LENGTH_LIMIT_EXCEEDED);
+            break;
+    }
+}
+
+/// \brief Encodes the ProcessedInput message of a processed input, then releases its payloads
+/// \param i Processed input, complete with payloads
+/// \returns Processed input ready to be pushed to its epoch
+/// \details From then on, responses splice the serialized message instead of converting the structure again
+static std::shared_ptr<const processed_input_type> seal_processed_input(processed_input_type &&i) {
+    ProcessedInput proto_i;
+    set_proto_processed_input(i, &proto_i);
+    i.serialized = proto_i.SerializeAsString();
+    if (std::holds_alternative<accepted_data_type>(i.processed)) {
+        auto &data = std::get<accepted_data_type>(i.processed);
+        for (auto &v : data.vouchers) {
+            v.payload = std::string{};
+        }
+        for (auto &n : data.notices) {
+            n.payload = std::string{};
+        }
+    } else {
+        std::get<exception_data_type>(i.processed) = exception_data_type{};
+    }
+    i.reports = std::vector<report_type>{};
+    return std::make_shared<const processed_input_type>(std::move(i));
+}
+
 /// \brief Fills out OutputValidityProof
 /// \param e Epoch type
 /// \param input_index Input index in epoch
@@ -733,14 +1510,18 @@ static std::string get_session_lock_reason(const std::string &rpc, const std::st
 /// \param keccak_in_hashes Voucher/Notice hash in hashes proof
 /// \param proto_p Pointer to message receiving the proof contents
 static void set_proto_output_validity_proof(const epoch_type &e, uint64_t input_index,
-    const proof_type &output_hashes_in_epoch, uint64_t output_index, const proof_type &output_hash_in_hashes,
+    const epoch_proof_type &output_hashes_in_epoch, uint64_t output_index, const proof_type &output_hash_in_hashes,
     OutputValidityProof *proto_ovp) {
     proto_ovp->set_input_index_within_epoch(input_index);
     proto_ovp->set_output_index_within_input(output_index);
     cartesi::set_proto_hash(output_hash_in_hashes.get_root_hash(), proto_ovp->mutable_output_hashes_root_hash());
-    cartesi::set_proto_hash(e.vouchers_tree.get_root_hash(), proto_ovp->mutable_vouchers_epoch_root_hash());
-    cartesi::set_proto_hash(e.notices_tree.get_root_hash(), proto_ovp->mutable_notices_epoch_root_hash());
+    cartesi::set_proto_hash(get_epoch_root_hash(e.vouchers_tree), proto_ovp->mutable_vouchers_epoch_root_hash());
+    cartesi::set_proto_hash(get_epoch_root_hash(e.notices_tree), proto_ovp->mutable_notices_epoch_root_hash());
     cartesi::set_proto_hash(e.most_recent_machine_hash, proto_ovp->mutable_machine_state_hash());
+    proto_ovp->mutable_output_hash_in_output_hashes_siblings()->Reserve(
+        output_hash_in_hashes.get_log2_root_size() - output_hash_in_hashes.get_log2_target_size());
+    proto_ovp->mutable_output_hashes_in_epoch_siblings()->Reserve(
+        output_hashes_in_epoch.get_log2_root_size() - output_hashes_in_epoch.get_log2_target_size());
     for (int log2_size = output_hash_in_hashes.get_log2_target_size();
          log2_size < output_hash_in_hashes.get_log2_root_size(); ++log2_size) {
         cartesi::set_proto_hash(output_hash_in_hashes.get_sibling_hash(log2_size),
@@ -753,6 +1534,12 @@ static void set_proto_output_validity_proof(const epoch_type &e, uint64_t input_
     }
 }
 
+/// \brief Largest block the FinishEpoch response arena requests from the heap at once
+static constexpr size_t FINISH_EPOCH_ARENA_MAX_BLOCK_SIZE = 1 << 20;
+
+/// \brief Maximum number of proofs in each message of a FinishEpochStream response
+static constexpr uint64_t FINISH_EPOCH_STREAM_CHUNK_PROOFS = 256;
+
 static std::array<unsigned char, EVM_ABI_UINT64_LENGTH> get_abi_encoded_context(uint64_t epoch_index) {
     using namespace boost::endian;
     std::array<unsigned char, EVM_ABI_UINT64_LENGTH> context{};
@@ -762,67 +1549,684 @@ static std::array<unsigned char, EVM_ABI_UINT64_LENGTH> get_abi_encoded_context(
     return context;
 }
 
-/// \brief Fills out OutputValidityProofs on a FinishEpochResponse
+/// \brief Fills out the Proof of one output of an accepted input
+/// \param e Finished epoch
+/// \param i Processed input
+/// \param output_enum Whether output is a voucher or a notice
+/// \param output_index Output index in input
+/// \param output_hashes_in_epoch Voucher/Notice hashes in epoch proof for input
+/// \param output_hash_in_hashes Voucher/Notice hash in hashes proof
+/// \param context ABI-encoded context of epoch
+/// \param proto_p Pointer to message receiving the proof contents
+static void set_proto_proof(const epoch_type &e, const processed_input_type &i, OutputEnum output_enum,
+    uint64_t output_index, const epoch_proof_type &output_hashes_in_epoch, const proof_type &output_hash_in_hashes,
+    const std::array<unsigned char, EVM_ABI_UINT64_LENGTH> &context, Proof *proto_p) {
+    proto_p->set_input_index(i.input_index);
+    proto_p->set_output_index(output_index);
+    proto_p->set_output_enum(output_enum);
+    proto_p->set_context(context.data(), context.size());
+    set_proto_output_validity_proof(e, i.epoch_input_index, output_hashes_in_epoch, output_index,
+        output_hash_in_hashes, proto_p->mutable_validity());
+}
+
+/// \brief Returns the number of outputs, and therefore of proofs, in an epoch
+/// \param e Epoch type
+static uint64_t get_proof_count(const epoch_type &e) {
+    uint64_t proof_count = 0;
+    for (const auto &i : e.processed_inputs) {
+        if (std::holds_alternative<accepted_data_type>(i->processed)) {
+            const auto &data = std::get<accepted_data_type>(i->processed);
+            proof_count += data.vouchers.size() + data.notices.size();
+        }
+    }
+    return proof_count;
+}
+
+/// \brief Fills out the hashes of a finished epoch on a FinishEpochResponse
 /// \param e Epoch type
 /// \param response FinishEpochResponse
-static void set_proto_finish_epoch_response(const epoch_type &e, FinishEpochResponse &response) {
+static void set_proto_finish_epoch_hashes(const epoch_type &e, FinishEpochResponse &response) {
     cartesi::set_proto_hash(e.most_recent_machine_hash, response.mutable_machine_hash());
-    cartesi::set_proto_hash(e.vouchers_tree.get_root_hash(), response.mutable_vouchers_epoch_root_hash());
-    cartesi::set_proto_hash(e.notices_tree.get_root_hash(), response.mutable_notices_epoch_root_hash());
+    cartesi::set_proto_hash(get_epoch_root_hash(e.vouchers_tree), response.mutable_vouchers_epoch_root_hash());
+    cartesi::set_proto_hash(get_epoch_root_hash(e.notices_tree), response.mutable_notices_epoch_root_hash());
+}
+
+/// \brief Position of the next proof of a finished epoch, in FinishEpochResponse order
+struct proof_cursor_type {
+    uint64_t epoch_input_index{}; ///< Input index in epoch
+    uint64_t output_index{};      ///< Output index in input, counting vouchers first, then notices
+};
+
+/// \brief Adds the proofs of a finished epoch to a FinishEpochResponse, in order, resuming where the last call stopped
+/// \param e Finished epoch, with complete epoch trees
+/// \param cursor Position of first proof to add, advanced past the last proof added
+/// \param max_count Maximum number of proofs to add
+/// \param response FinishEpochResponse receiving the proofs
+static void add_proto_finish_epoch_proofs(const epoch_type &e, proof_cursor_type &cursor, uint64_t max_count,
+    FinishEpochResponse &response) {
     const auto context = get_abi_encoded_context(e.epoch_index);
-    for (const auto &i : e.processed_inputs) {
+    uint64_t count = 0;
+    while (count < max_count && cursor.epoch_input_index < e.processed_inputs.size()) {
+        const auto &i = *e.processed_inputs[cursor.epoch_input_index];
         if (std::holds_alternative<accepted_data_type>(i.processed)) {
             const auto &data = std::get<accepted_data_type>(i.processed);
-            uint64_t output_index = 0;
-            for (const auto &v : data.vouchers) {
-                Proof *proto_p = response.add_proofs();
-                proto_p->set_input_index(i.input_index);
-                proto_p->set_output_index(output_index);
-                proto_p->set_output_enum(OutputEnum::VOUCHER);
-                auto *p_context = proto_p->mutable_context();
-                p_context->insert(p_context->end(), context.begin(), context.end());
-                set_proto_output_validity_proof(e, i.epoch_input_index, i.voucher_hashes_in_epoch, output_index,
-                    v.hash.value().keccak_in_hashes, proto_p->mutable_validity());
-                output_index++;
-            }
-            output_index = 0;
-            for (const auto &n : data.notices) {
-                Proof *proto_p = response.add_proofs();
-                proto_p->set_input_index(i.input_index);
-                proto_p->set_output_index(output_index);
-                proto_p->set_output_enum(OutputEnum::NOTICE);
-                auto *p_context = proto_p->mutable_context();
-                p_context->insert(p_context->end(), context.begin(), context.end());
-                set_proto_output_validity_proof(e, i.epoch_input_index, i.notice_hashes_in_epoch, output_index,
-                    n.hash.value().keccak_in_hashes, proto_p->mutable_validity());
-                output_index++;
+            const uint64_t voucher_count = data.vouchers.size();
+            const uint64_t output_count = voucher_count + data.notices.size();
+            if (cursor.output_index < voucher_count) {
+                const auto voucher_hashes_in_epoch =
+                    get_output_hashes_in_epoch_proof(e.vouchers_tree, i.epoch_input_index);
+                for (; cursor.output_index < voucher_count && count < max_count; ++cursor.output_index, ++count) {
+                    set_proto_proof(e, i, OutputEnum::VOUCHER, cursor.output_index, voucher_hashes_in_epoch,
+                        data.vouchers[cursor.output_index].hash.value().keccak_in_hashes, context,
+                        response.add_proofs());
+                }
             }
+            if (cursor.output_index >= voucher_count && cursor.output_index < output_count && count < max_count) {
+                const auto notice_hashes_in_epoch =
+                    get_output_hashes_in_epoch_proof(e.notices_tree, i.epoch_input_index);
+                for (; cursor.output_index < output_count && count < max_count; ++cursor.output_index, ++count) {
+                    const auto output_index = cursor.output_index - voucher_count;
+                    set_proto_proof(e, i, OutputEnum::NOTICE, output_index, notice_hashes_in_epoch,
+                        data.notices[output_index].hash.value().keccak_in_hashes, context, response.add_proofs());
+                }
+            }
+            // Stop in the middle of the input if there is no room for all its proofs
+            if (cursor.output_index < output_count) {
+                break;
+            }
+        }
+        ++cursor.epoch_input_index;
+        cursor.output_index = 0;
+    }
+}
+
+/// \brief Fills out OutputValidityProofs on a FinishEpochResponse
+/// \param e Epoch type
+/// \param response FinishEpochResponse
+static void set_proto_finish_epoch_response(const epoch_type &e, FinishEpochResponse &response) {
+    set_proto_finish_epoch_hashes(e, response);
+    const uint64_t proof_count = get_proof_count(e);
+    response.mutable_proofs()->Reserve(static_cast<int>(proof_count));
+    proof_cursor_type cursor;
+    add_proto_finish_epoch_proofs(e, cursor, proof_count, response);
+}
+
+/// \brief Appends the sibling hashes of a proof, from its target up to its root, to a packed bytes field
+/// \param p Proof
+/// \param packed Bytes field receiving the hashes, previously reserved
+template <typename PROOF>
+static void append_packed_siblings(const PROOF &p, std::string *packed) {
+    for (int log2_size = p.get_log2_target_size(); log2_size < p.get_log2_root_size(); ++log2_size) {
+        const auto &sibling = p.get_sibling_hash(log2_size);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        packed->append(reinterpret_cast<const char *>(sibling.data()), sibling.size());
+    }
+}
+
+/// \brief Returns the number of bytes taken by the packed sibling hashes of a proof
+/// \param p Proof
+template <typename PROOF>
+static size_t get_packed_siblings_size(const PROOF &p) {
+    return static_cast<size_t>(p.get_log2_root_size() - p.get_log2_target_size()) * sizeof(hash_type);
+}
+
+/// \brief Fills out the compact proofs of the vouchers (or notices) of an input
+/// \param t Epoch tree of the outputs
+/// \param epoch_input_index Input index in epoch
+/// \param outputs Vouchers or notices of input, with their hashes
+/// \param root_hash Pointer to field receiving the root hash of the output hashes memory range
+/// \param in_epoch_siblings Pointer to field receiving the siblings of the output hashes in the epoch tree
+/// \param in_hashes_siblings Pointer to field receiving the siblings of each output hash in the output hashes
+/// \details The epoch tree path is shared by all outputs of the input, so it is stored once. Each field is reserved
+/// once and the hashes are appended in place, so there is no allocation per hash.
+template <typename OUTPUTS>
+static void set_proto_compact_output_proofs(const epoch_output_tree_type &t, uint64_t epoch_input_index,
+    const OUTPUTS &outputs, std::string *root_hash, std::string *in_epoch_siblings,
+    std::string *in_hashes_siblings) {
+    if (outputs.empty()) {
+        return;
+    }
+    const auto &first = outputs.front().hash.value().keccak_in_hashes;
+    const auto root = first.get_root_hash();
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    root_hash->assign(reinterpret_cast<const char *>(root.data()), root.size());
+    const auto in_epoch = get_output_hashes_in_epoch_proof(t, epoch_input_index);
+    in_epoch_siblings->reserve(get_packed_siblings_size(in_epoch));
+    append_packed_siblings(in_epoch, in_epoch_siblings);
+    in_hashes_siblings->reserve(outputs.size() * get_packed_siblings_size(first));
+    for (const auto &o : outputs) {
+        append_packed_siblings(o.hash.value().keccak_in_hashes, in_hashes_siblings);
+    }
+}
+
+/// \brief Fills out the compact proofs of a finished epoch on a FinishEpochResponse, instead of the Proof messages
+/// \param e Epoch type
+/// \param response FinishEpochResponse
+/// \details The hashes in the response and the context in CompactProofs are the header shared by all proofs.
+/// Only inputs with outputs are listed.
+static void set_proto_finish_epoch_compact_response(const epoch_type &e, FinishEpochResponse &response) {
+    set_proto_finish_epoch_hashes(e, response);
+    auto *compact = response.mutable_compact_proofs();
+    const auto context = get_abi_encoded_context(e.epoch_index);
+    compact->set_context(context.data(), context.size());
+    int input_count = 0;
+    for (const auto &i : e.processed_inputs) {
+        if (std::holds_alternative<accepted_data_type>(i->processed)) {
+            const auto &data = std::get<accepted_data_type>(i->processed);
+            input_count += !data.vouchers.empty() || !data.notices.empty() ? 1 : 0;
+        }
+    }
+    compact->mutable_inputs()->Reserve(input_count);
+    for (const auto &i : e.processed_inputs) {
+        if (!std::holds_alternative<accepted_data_type>(i->processed)) {
+            continue;
+        }
+        const auto &data = std::get<accepted_data_type>(i->processed);
+        if (data.vouchers.empty() && data.notices.empty()) {
+            continue;
+        }
+        auto *proto_i = compact->add_inputs();
+        proto_i->set_input_index(i->input_index);
+        proto_i->set_input_index_within_epoch(i->epoch_input_index);
+        proto_i->set_voucher_count(data.vouchers.size());
+        proto_i->set_notice_count(data.notices.size());
+        set_proto_compact_output_proofs(e.vouchers_tree, i->epoch_input_index, data.vouchers,
+            proto_i->mutable_voucher_hashes_root_hash(), proto_i->mutable_voucher_hashes_in_epoch_siblings(),
+            proto_i->mutable_voucher_hash_in_voucher_hashes_siblings());
+        set_proto_compact_output_proofs(e.notices_tree, i->epoch_input_index, data.notices,
+            proto_i->mutable_notice_hashes_root_hash(), proto_i->mutable_notice_hashes_in_epoch_siblings(),
+            proto_i->mutable_notice_hash_in_notice_hashes_siblings());
+    }
+}
+
+/// \brief Fills out the Proof of one output in a finished epoch kept in memory
+/// \param e Finished epoch, with complete epoch trees
+/// \param epoch_input_index Input index in epoch
+/// \param output_enum Whether output is a voucher or a notice
+/// \param output_index Output index in input
+/// \param proto_p Pointer to message receiving the proof contents
+/// \returns True if the output exists, false otherwise
+/// \details Only the sibling path of the requested input is read from the epoch tree, in O(log n)
+static bool set_proto_output_proof(const epoch_type &e, uint64_t epoch_input_index, OutputEnum output_enum,
+    uint64_t output_index, Proof *proto_p) {
+    if (epoch_input_index >= e.processed_inputs.size()) {
+        return false;
+    }
+    const auto &i = *e.processed_inputs[epoch_input_index];
+    if (!std::holds_alternative<accepted_data_type>(i.processed)) {
+        return false;
+    }
+    const auto &data = std::get<accepted_data_type>(i.processed);
+    const proof_type *output_hash_in_hashes = nullptr;
+    if (output_enum == OutputEnum::VOUCHER && output_index < data.vouchers.size()) {
+        output_hash_in_hashes = &data.vouchers[output_index].hash.value().keccak_in_hashes;
+    } else if (output_enum == OutputEnum::NOTICE && output_index < data.notices.size()) {
+        output_hash_in_hashes = &data.notices[output_index].hash.value().keccak_in_hashes;
+    } else {
+        return false;
+    }
+    const auto &tree = output_enum == OutputEnum::VOUCHER ? e.vouchers_tree : e.notices_tree;
+    set_proto_proof(e, i, output_enum, output_index, get_output_hashes_in_epoch_proof(tree, epoch_input_index),
+        *output_hash_in_hashes, get_abi_encoded_context(e.epoch_index), proto_p);
+    return true;
+}
+
+/// \brief Magic number at the start of finished epoch files
+static constexpr std::array<char, 8> EPOCH_FILE_MAGIC{'C', 'T', 'S', 'I', 'E', 'P', 'C', 'H'};
+
+/// \brief Version of finished epoch file layout
+static constexpr uint64_t EPOCH_FILE_VERSION = 1;
+
+/// \brief Indices of little-endian 64-bit words in finished epoch file header
+enum epoch_file_header_word : uint64_t {
+    EPOCH_FILE_MAGIC_WORD,       ///< Magic number
+    EPOCH_FILE_VERSION_WORD,     ///< Version of file layout
+    EPOCH_FILE_EPOCH_INDEX_WORD, ///< Epoch index
+    EPOCH_FILE_INPUT_COUNT_WORD, ///< Number of ProcessedInput records
+    EPOCH_FILE_PROOF_COUNT_WORD, ///< Number of Proof records
+    EPOCH_FILE_HEADER_WORDS      ///< Number of words in header, followed by the offset table
+};
+
+/// \brief Returns path to file holding a finished epoch
+/// \param directory Epoch storage directory
+/// \param id Session id
+/// \param epoch_index Epoch index
+/// \details Session ids are chosen by clients, so they are hex-encoded to obtain a safe file name
+static std::string get_epoch_file_path(const std::string &directory, const id_type &id, uint64_t epoch_index) {
+    static constexpr const char *digits = "0123456789abcdef";
+    std::string name;
+    name.reserve(2 * id.size());
+    for (auto c : id) {
+        const auto b = static_cast<unsigned char>(c);
+        name.push_back(digits[b >> 4]);
+        name.push_back(digits[b & 15]);
+    }
+    return (std::filesystem::path{directory} / (name + "-" + std::to_string(epoch_index) + ".epoch")).string();
+}
+
+/// \brief Reads a little-endian 64-bit word from a finished epoch file
+/// \param f Mapped file
+/// \param index Index of word in file
+static uint64_t get_epoch_file_word(const cartesi::mapped_file &f, uint64_t index) {
+    using namespace boost::endian;
+    return endian_load<uint64_t, sizeof(uint64_t), order::little>(f.data() + index * sizeof(uint64_t));
+}
+
+/// \brief Checks that a mapped file holds the expected finished epoch and that all offsets are within bounds
+/// \param f Mapped file
+/// \param epoch_index Expected epoch index
+static void check_epoch_file(const cartesi::mapped_file &f, uint64_t epoch_index) {
+    if (f.size() < EPOCH_FILE_HEADER_WORDS * sizeof(uint64_t) ||
+        memcmp(f.data(), EPOCH_FILE_MAGIC.data(), EPOCH_FILE_MAGIC.size()) != 0) {
+        throw std::runtime_error{"invalid epoch file '" + f.path() + "'"};
+    }
+    if (get_epoch_file_word(f, EPOCH_FILE_VERSION_WORD) != EPOCH_FILE_VERSION) {
+        throw std::runtime_error{"unsupported epoch file version in '" + f.path() + "'"};
+    }
+    if (get_epoch_file_word(f, EPOCH_FILE_EPOCH_INDEX_WORD) != epoch_index) {
+        throw std::runtime_error{"epoch index mismatch in '" + f.path() + "'"};
+    }
+    const uint64_t words = f.size() / sizeof(uint64_t) - EPOCH_FILE_HEADER_WORDS;
+    const uint64_t input_count = get_epoch_file_word(f, EPOCH_FILE_INPUT_COUNT_WORD);
+    const uint64_t proof_count = get_epoch_file_word(f, EPOCH_FILE_PROOF_COUNT_WORD);
+    if (input_count >= words || proof_count >= words - input_count) {
+        throw std::runtime_error{"truncated epoch file '" + f.path() + "'"};
+    }
+    const uint64_t count = input_count + proof_count;
+    uint64_t prev = (EPOCH_FILE_HEADER_WORDS + count + 1) * sizeof(uint64_t);
+    for (uint64_t i = 0; i <= count; ++i) {
+        const uint64_t offset = get_epoch_file_word(f, EPOCH_FILE_HEADER_WORDS + i);
+        if (offset < prev || offset > f.size() || (i == count && offset != f.size())) {
+            throw std::runtime_error{"corrupt offset table in epoch file '" + f.path() + "'"};
+        }
+        prev = offset;
+    }
+}
+
+/// \brief Returns the serialized message of a record in a finished epoch file
+/// \param f Mapped file, previously checked by check_epoch_file
+/// \param index Index of record. ProcessedInput records come first, followed by Proof records.
+static std::string_view get_epoch_file_record_bytes(const cartesi::mapped_file &f, uint64_t index) {
+    const uint64_t begin = get_epoch_file_word(f, EPOCH_FILE_HEADER_WORDS + index);
+    const uint64_t end = get_epoch_file_word(f, EPOCH_FILE_HEADER_WORDS + index + 1);
+    return {reinterpret_cast<const char *>(f.data()) + begin, end - begin};
+}
+
+/// \brief Parses a record from a finished epoch file
+/// \param f Mapped file, previously checked by check_epoch_file
+/// \param index Index of record. ProcessedInput records come first, followed by Proof records.
+/// \param proto_m Pointer to message receiving the record contents
+static void get_epoch_file_record(const cartesi::mapped_file &f, uint64_t index, google::protobuf::Message *proto_m) {
+    const auto record = get_epoch_file_record_bytes(f, index);
+    if (!proto_m->ParseFromArray(record.data(), static_cast<int>(record.size()))) {
+        throw std::runtime_error{"unable to parse record from epoch file '" + f.path() + "'"};
+    }
+}
+
+/// \brief Parts of ProcessedInput messages a caller chose to leave out
+struct processed_input_omissions_type {
+    bool payloads{false};       ///< Leave out payloads of vouchers and notices, but not the outputs themselves
+    bool reports{false};        ///< Leave out reports
+    bool exception_data{false}; ///< Leave out exception data
+};
+
+/// \brief Leaves parts out of a complete ProcessedInput message
+/// \param omit Parts of message to leave out
+/// \param proto_i Pointer to message
+static void omit_proto_processed_input_parts(const processed_input_omissions_type &omit, ProcessedInput *proto_i) {
+    if (omit.payloads && proto_i->has_accepted_data()) {
+        auto *accepted_data_p = proto_i->mutable_accepted_data();
+        for (auto &o : *accepted_data_p->mutable_vouchers()) {
+            o.clear_payload();
+        }
+        for (auto &m : *accepted_data_p->mutable_notices()) {
+            m.clear_payload();
+        }
+    }
+    if (omit.reports) {
+        proto_i->clear_reports();
+    }
+    if (omit.exception_data && proto_i->ProcessedInputOneOf_case() == ProcessedInput::kExceptionData) {
+        proto_i->clear_exception_data();
+    }
+}
+
+/// \brief Returns the number of processed inputs in an epoch snapshot
+/// \param snapshot Epoch snapshot
+static uint64_t get_processed_input_count(const epoch_snapshot_type &snapshot) {
+    if (snapshot.storage) {
+        return get_epoch_file_word(*snapshot.storage, EPOCH_FILE_INPUT_COUNT_WORD);
+    }
+    return snapshot.processed_inputs.size();
+}
+
+/// \brief Returns the serialized ProcessedInput message of one processed input of an epoch snapshot
+/// \param snapshot Epoch snapshot
+/// \param epoch_input_index Input index in epoch, less than get_processed_input_count(snapshot)
+/// \details The bytes live in the epoch file or in the processed input, both kept alive by the snapshot
+static std::string_view get_serialized_processed_input(const epoch_snapshot_type &snapshot,
+    uint64_t epoch_input_index) {
+    if (snapshot.storage) {
+        return get_epoch_file_record_bytes(*snapshot.storage, epoch_input_index);
+    }
+    return snapshot.processed_inputs[epoch_input_index]->serialized;
+}
+
+/// \brief Fills out one processed input of an epoch snapshot, wherever the epoch is kept
+/// \param snapshot Epoch snapshot
+/// \param epoch_input_index Input index in epoch, less than get_processed_input_count(snapshot)
+/// \param proto_i Pointer to ProcessedInput receiving the input
+/// \param omit Parts of message to leave out
+static void set_proto_processed_input(const epoch_snapshot_type &snapshot, uint64_t epoch_input_index,
+    ProcessedInput *proto_i, const processed_input_omissions_type &omit = {}) {
+    const auto bytes = get_serialized_processed_input(snapshot, epoch_input_index);
+    if (!proto_i->ParseFromArray(bytes.data(), static_cast<int>(bytes.size()))) {
+        throw std::runtime_error{"unable to parse processed input " + std::to_string(epoch_input_index)};
+    }
+    omit_proto_processed_input_parts(omit, proto_i);
+}
+
+/// \brief Protobuf wire type of strings, bytes and embedded messages
+static constexpr uint32_t PROTO_WIRETYPE_LENGTH_DELIMITED = 2;
+
+/// \brief Appends one processed input of an epoch snapshot to a serialized GetEpochStatusResponse
+/// \param snapshot Epoch snapshot
+/// \param epoch_input_index Input index in epoch, less than get_processed_input_count(snapshot)
+/// \param omit Parts of message to leave out
+/// \param response Serialized response receiving the input as one more element of its processed_inputs field
+/// \details Unless parts must be left out, the cached bytes are copied as they are, with no encoding at all
+static void append_serialized_processed_input(const epoch_snapshot_type &snapshot, uint64_t epoch_input_index,
+    const processed_input_omissions_type &omit, std::string &response) {
+    auto bytes = get_serialized_processed_input(snapshot, epoch_input_index);
+    std::string filtered;
+    if (omit.payloads || omit.reports || omit.exception_data) {
+        ProcessedInput proto_i;
+        set_proto_processed_input(snapshot, epoch_input_index, &proto_i, omit);
+        filtered = proto_i.SerializeAsString();
+        bytes = filtered;
+    }
+    using google::protobuf::io::CodedOutputStream;
+    std::array<uint8_t, 16> prefix{}; // Varints of the tag and of the length take at most 5 and 10 bytes
+    const uint32_t tag = (static_cast<uint32_t>(GetEpochStatusResponse::kProcessedInputsFieldNumber) << 3) |
+        PROTO_WIRETYPE_LENGTH_DELIMITED;
+    auto *end = CodedOutputStream::WriteVarint32ToArray(tag, prefix.data());
+    end = CodedOutputStream::WriteVarint64ToArray(bytes.size(), end);
+    response.append(reinterpret_cast<const char *>(prefix.data()), end - prefix.data());
+    response.append(bytes.data(), bytes.size());
+}
+
+/// \brief Returns the position of a proof in FinishEpochResponse order: by input, vouchers first, then by output
+static std::tuple<uint64_t, int, uint64_t> get_proof_order(uint64_t epoch_input_index, OutputEnum output_enum,
+    uint64_t output_index) {
+    return {epoch_input_index, output_enum == OutputEnum::VOUCHER ? 0 : 1, output_index};
+}
+
+/// \brief Fills out the Proof of one output in a finished epoch file
+/// \param f Mapped file, previously checked by check_epoch_file
+/// \param epoch_input_index Input index in epoch
+/// \param output_enum Whether output is a voucher or a notice
+/// \param output_index Output index in input
+/// \param proto_p Pointer to message receiving the proof contents
+/// \returns True if the output exists, false otherwise
+/// \details Proof records are stored in FinishEpochResponse order, so the lookup is a binary search that parses
+/// O(log n) records
+static bool set_proto_stored_output_proof(const cartesi::mapped_file &f, uint64_t epoch_input_index,
+    OutputEnum output_enum, uint64_t output_index, Proof *proto_p) {
+    const auto order = get_proof_order(epoch_input_index, output_enum, output_index);
+    uint64_t first = get_epoch_file_word(f, EPOCH_FILE_INPUT_COUNT_WORD);
+    uint64_t last = first + get_epoch_file_word(f, EPOCH_FILE_PROOF_COUNT_WORD);
+    while (first < last) {
+        const uint64_t middle = first + (last - first) / 2;
+        get_epoch_file_record(f, middle, proto_p);
+        const auto middle_order = get_proof_order(proto_p->validity().input_index_within_epoch(),
+            proto_p->output_enum(), proto_p->output_index());
+        if (middle_order < order) {
+            first = middle + 1;
+        } else if (order < middle_order) {
+            last = middle;
+        } else {
+            return true;
+        }
+    }
+    proto_p->Clear();
+    return false;
+}
+
+/// \brief Writes a finished epoch file one Proof record at a time, so the proofs need not all be kept in memory
+/// \details The file holds the serialized ProcessedInput messages served by GetEpochStatus and the serialized
+/// Proof messages, in FinishEpochResponse order, preceded by an offset table, so reads need no parsing beyond the
+/// requested records. Records are written to a temporary file as they come, and the header and offset table, which
+/// precede them, are written last. The temporary file is removed unless the writer is committed.
+class epoch_file_writer final {
+public:
+    /// \brief Constructor creates the temporary file and writes the ProcessedInput records
+    /// \param directory Epoch storage directory
+    /// \param id Session id
+    /// \param e Finished epoch
+    /// \param proof_count Number of Proof records that will be added
+    epoch_file_writer(const std::string &directory, const id_type &id, const epoch_type &e, uint64_t proof_count) :
+        m_path{get_epoch_file_path(directory, id, e.epoch_index)},
+        m_temp_path{m_path + ".tmp"},
+        m_epoch_index{e.epoch_index},
+        m_input_count{e.processed_inputs.size()},
+        m_proof_count{proof_count},
+        m_out{m_temp_path, std::ios::binary | std::ios::trunc} {
+        m_offsets.reserve(m_input_count + m_proof_count + 1);
+        m_offsets.push_back(get_header_size());
+        m_out.seekp(static_cast<std::streamoff>(m_offsets.back()));
+        // Processed inputs were serialized when they were pushed, so only proofs need encoding.
+        // Errors are sticky, so they are only checked on commit.
+        for (const auto &i : e.processed_inputs) {
+            write_record(i->serialized);
+        }
+    }
+
+    epoch_file_writer(const epoch_file_writer &other) = delete;
+    epoch_file_writer(epoch_file_writer &&other) = delete;
+    epoch_file_writer &operator=(const epoch_file_writer &other) = delete;
+    epoch_file_writer &operator=(epoch_file_writer &&other) = delete;
+
+    /// \brief Appends the next Proof record
+    /// \param p Proof, in FinishEpochResponse order
+    void add_proof(const Proof &p) {
+        if (m_offsets.size() > m_input_count + m_proof_count) {
+            throw std::runtime_error{"too many proofs for epoch file '" + m_temp_path + "'"};
+        }
+        write_record(p.SerializeAsString());
+    }
+
+    /// \brief Writes the header, moves the temporary file into place, and maps it
+    /// \returns Mapping of finished epoch file
+    std::shared_ptr<const cartesi::mapped_file> commit(void) {
+        using namespace boost::endian;
+        if (m_offsets.size() != m_input_count + m_proof_count + 1) {
+            throw std::runtime_error{"missing proofs for epoch file '" + m_temp_path + "'"};
+        }
+        std::vector<unsigned char> header(get_header_size());
+        const auto set_header_word = [&header](uint64_t index, uint64_t value) {
+            endian_store<uint64_t, sizeof(uint64_t), order::little>(header.data() + index * sizeof(uint64_t), value);
+        };
+        memcpy(header.data(), EPOCH_FILE_MAGIC.data(), EPOCH_FILE_MAGIC.size());
+        set_header_word(EPOCH_FILE_VERSION_WORD, EPOCH_FILE_VERSION);
+        set_header_word(EPOCH_FILE_EPOCH_INDEX_WORD, m_epoch_index);
+        set_header_word(EPOCH_FILE_INPUT_COUNT_WORD, m_input_count);
+        set_header_word(EPOCH_FILE_PROOF_COUNT_WORD, m_proof_count);
+        for (uint64_t i = 0; i < m_offsets.size(); ++i) {
+            set_header_word(EPOCH_FILE_HEADER_WORDS + i, m_offsets[i]);
+        }
+        m_out.seekp(0);
+        m_out.write(reinterpret_cast<const char *>(header.data()), static_cast<std::streamsize>(header.size()));
+        m_out.close();
+        check();
+        std::filesystem::rename(m_temp_path, m_path);
+        m_committed = true;
+        auto f = std::make_shared<const cartesi::mapped_file>(m_path);
+        check_epoch_file(*f, m_epoch_index);
+        return f;
+    }
+
+    /// \brief Destructor removes the temporary file, unless committed
+    ~epoch_file_writer() {
+        if (!m_committed) {
+            m_out.close();
+            std::error_code ec;
+            std::filesystem::remove(m_temp_path, ec);
+        }
+    }
+
+private:
+    /// \brief Returns the size of the header, including the offset table
+    uint64_t get_header_size(void) const {
+        return (EPOCH_FILE_HEADER_WORDS + m_input_count + m_proof_count + 1) * sizeof(uint64_t);
+    }
+
+    /// \brief Appends a record and its end to the offset table
+    void write_record(std::string_view record) {
+        m_out.write(record.data(), static_cast<std::streamsize>(record.size()));
+        m_offsets.push_back(m_offsets.back() + record.size());
+    }
+
+    /// \brief Throws if the temporary file could not be written
+    void check(void) const {
+        if (!m_out) {
+            throw std::runtime_error{"unable to write epoch file '" + m_temp_path + "'"};
+        }
+    }
+
+    std::string m_path;              ///< Path to finished epoch file
+    std::string m_temp_path;         ///< Path to temporary file
+    uint64_t m_epoch_index;          ///< Index of epoch
+    uint64_t m_input_count;          ///< Number of ProcessedInput records
+    uint64_t m_proof_count;          ///< Number of Proof records
+    std::ofstream m_out;             ///< Temporary file
+    std::vector<uint64_t> m_offsets; ///< Offset of each record written so far, then of the next
+    bool m_committed{false};         ///< Whether the temporary file was moved into place
+};
+
+/// \brief Releases the in-memory parts of a finished epoch that was moved to a file
+/// \param e Finished epoch
+/// \param f Mapping of finished epoch file
+/// \details Only the back trees, which take O(log n) memory, remain to provide the root hashes
+static void release_stored_epoch(epoch_type &e, std::shared_ptr<const cartesi::mapped_file> f) {
+    e.storage = std::move(f);
+    e.processed_inputs = std::vector<std::shared_ptr<const processed_input_type>>{};
+    e.vouchers_tree.complete.reset();
+    e.notices_tree.complete.reset();
+}
+
+/// \brief Moves a finished epoch to a file in the epoch storage directory, keeping only a mapping of it in memory
+/// \param directory Epoch storage directory
+/// \param id Session id
+/// \param e Finished epoch
+/// \param response FinishEpochResponse with all proofs for the epoch, or with its compact proofs
+/// \details On failure, the epoch is left untouched in memory.
+static void store_finished_epoch(const std::string &directory, const id_type &id, epoch_type &e,
+    const FinishEpochResponse &response) {
+    const uint64_t proof_count = get_proof_count(e);
+    epoch_file_writer writer{directory, id, e, proof_count};
+    if (!response.has_compact_proofs()) {
+        for (const auto &p : response.proofs()) {
+            writer.add_proof(p);
+        }
+    } else {
+        // A compact response has no Proof messages to reuse, so they are built a chunk at a time
+        FinishEpochResponse chunk;
+        proof_cursor_type cursor;
+        for (uint64_t added = 0; added < proof_count; added += FINISH_EPOCH_STREAM_CHUNK_PROOFS) {
+            chunk.Clear();
+            add_proto_finish_epoch_proofs(e, cursor, FINISH_EPOCH_STREAM_CHUNK_PROOFS, chunk);
+            for (const auto &p : chunk.proofs()) {
+                writer.add_proof(p);
+            }
+        }
+    }
+    release_stored_epoch(e, writer.commit());
+}
+
+/// \brief Removes the file backing a finished epoch, if any
+/// \param e Epoch
+static void remove_epoch_file(epoch_type &e) {
+    if (e.storage) {
+        const auto path = e.storage->path();
+        e.storage.reset();
+        std::error_code ec;
+        if (!std::filesystem::remove(path, ec) && ec) {
+            BOOST_LOG_TRIVIAL(warning) << "unable to remove epoch file '" << path << "' (" << ec.message() << ")";
         }
     }
 }
 
+/// \brief Checks a FinishEpoch request against a locked session
+/// \param session Session
+/// \param request FinishEpochRequest
+/// \param request_context ServerContext used by handler
+/// \returns Epoch to finish
+static epoch_type &get_epoch_to_finish(session_type &session, const FinishEpochRequest &request,
+    const grpc::ServerContext &request_context) {
+    const auto epoch_index = request.active_epoch_index();
+    // If session is tainted, report potential data loss
+    if (session.tainted) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::DATA_LOSS,
+                          "session was previously tainted ("s + session.taint_status.error_message() + ")"}),
+            request_context);
+    }
+    auto &epochs = session.epochs;
+    // If epoch is unknown, a bail out
+    if (epochs.find(epoch_index) == epochs.end()) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "unknown epoch index"}),
+            request_context);
+    }
+    auto &e = epochs[epoch_index];
+    // If epoch is not active, bail out
+    if (e.state != epoch_state::active) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch already finished"}),
+            request_context);
+    }
+    // If there are still pending inputs to process, bail out
+    if (!e.pending_inputs.empty()) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch still has pending inputs"}),
+            request_context);
+    }
+    // If the number of processed inputs does not match the expected, bail out
+    if (e.processed_inputs.size() != request.processed_input_count_within_epoch()) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                          "incorrect processed input count (expected " + std::to_string(e.processed_inputs.size()) +
+                              ", got " + std::to_string(request.processed_input_count_within_epoch()) + ")"}),
+            request_context);
+    }
+    return e;
+}
+
 /// \brief Creates a new handler for the FinishEpoch RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_FinishEpoch_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::finish_epoch);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         FinishEpochRequest request;
         ServerAsyncResponseWriter<FinishEpochResponse> writer(&request_context);
         auto *cq = hctx.completion_queue.get();
-        hctx.manager_async_service.RequestFinishEpoch(&request_context, &request, &writer, cq, cq, self);
+        hctx.server->manager_async_service.RequestFinishEpoch(&request_context, &request, &writer, cq, cq, self);
         yield(side_effect::none);
-        new_FinishEpoch_handler(hctx);
+        replace_handler(hctx, handler_kind::finish_epoch, new_FinishEpoch_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received FinishEpoch RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
         try {
             Status status; // NOLINT: Unknown. Maybe linter bug?
-            FinishEpochResponse response;
-            auto &sessions = hctx.sessions;
+            // The response holds thousands of small messages and strings for large epochs. Allocating them all
+            // from an arena replaces one heap allocation per hash with a few large blocks, freed all at once.
+            google::protobuf::ArenaOptions arena_options;
+            arena_options.max_block_size = FINISH_EPOCH_ARENA_MAX_BLOCK_SIZE;
+            google::protobuf::Arena arena{arena_options};
+            auto &response = *google::protobuf::Arena::CreateMessage<FinishEpochResponse>(&arena);
+            auto &sessions = shard.sessions;
             const auto &id = request.session_id();
             auto epoch_index = request.active_epoch_index();
             LOG_CONTEXT(info, request_context) << "Received FinishEpoch for session " << id << " epoch " << epoch_index;
@@ -850,47 +2254,284 @@ static handler_type::pull_type *new_FinishEpoch_handler(handler_context &hctx) {
             // Lock session so other rpcs to the same session are rejected
             auto_lock session_lock(session.session_lock, "FinishEpoch session lock", request_context);
             session.session_lock_reason = new_lock_reason;
-            // If session is tainted, report potential data loss
-            if (session.tainted) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::DATA_LOSS,
-                                  "session was previously tainted ("s + session.taint_status.error_message() + ")"}),
-                    request_context);
+            check_no_pending_queries(session, request_context);
+            auto &e = get_epoch_to_finish(session, request, request_context);
+            // Try to store session before we change anything
+            if (!request.storage_directory().empty()) {
+                LOG_CONTEXT(debug, request_context) << "  Storing into " << request.storage_directory();
+                async_context actx{session, request_context, shard.completion_queue.get(), self, yield};
+                store(actx, request.storage_directory());
             }
-            auto &epochs = session.epochs;
-            // If epoch is unknown, a bail out
-            if (epochs.find(epoch_index) == epochs.end()) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "unknown epoch index"}),
+            // Completing the trees and building the proofs is the bulk of the work, so it runs in the worker pool.
+            // The session is locked and has no pending inputs, so no other handler changes the epoch meanwhile.
+            // Read RPCs keep serving the snapshot taken here.
+            get_epoch_snapshot(e);
+            await_on_pool(shard, self, yield, [&]() {
+                finish_epoch(e);
+                if (request.compact_proofs()) {
+                    set_proto_finish_epoch_compact_response(e, response);
+                } else {
+                    set_proto_finish_epoch_response(e, response);
+                }
+                // Move finished epoch out of memory, if so configured. The epoch is still usable in memory on failure.
+                if (!shard.epoch_storage_directory.empty()) {
+                    try {
+                        store_finished_epoch(shard.epoch_storage_directory, id, e, response);
+                        LOG_CONTEXT(debug, request_context) << "  Stored epoch into " << e.storage->path();
+                    } catch (std::exception &x) {
+                        LOG_CONTEXT(warning, request_context) << "  Unable to store epoch (" << x.what() << ")";
+                    }
+                }
+            });
+            e.snapshot.reset();
+            wake_epoch_watchers(shard, e);
+            start_new_epoch(e, session);
+            writer.Finish(response, grpc::Status::OK, self);
+            yield(side_effect::none);
+        } catch (finish_error_yield_none &e) {
+            LOG_CONTEXT(error, request_context) << "Caught finish_error_yield_none " << e.status().error_message();
+            writer.FinishWithError(e.status(), self);
+            yield(side_effect::none);
+        } catch (std::exception &e) {
+            LOG_CONTEXT(error, request_context) << "Caught unexpected exception " << e.what();
+            writer.FinishWithError(
+                grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + e.what()}, self);
+            yield(side_effect::none);
+        }
+    }};
+    return self;
+}
+
+/// \brief Creates a new handler for the FinishEpochStream RPC and starts accepting requests
+/// \param hctx Handler context shared between all handlers
+/// \details \{
+/// Finishes the epoch like FinishEpoch, then streams the response in messages of at most
+/// FINISH_EPOCH_STREAM_CHUNK_PROOFS proofs. The first message also holds the hashes, so the messages merged in order
+/// are the FinishEpoch response. Each message is only built once the previous one was written, so memory stays flat
+/// however many outputs the epoch has, and a slow client slows the stream down instead of making it pile up. The
+/// epoch file, if so configured, is written as the proofs go.
+/// The session stays locked until the last message is sent. If the client goes away before that, the epoch is
+/// still finished, but stays in memory.
+/// \}
+static handler_type::pull_type *new_FinishEpochStream_handler(handler_context &hctx) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::finish_epoch_stream);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
+        using namespace grpc;
+        ServerContext request_context;
+        FinishEpochRequest request;
+        ServerAsyncWriter<FinishEpochResponse> writer(&request_context);
+        auto *cq = hctx.completion_queue.get();
+        hctx.server->manager_async_service.RequestFinishEpochStream(&request_context, &request, &writer, cq, cq,
+            self);
+        yield(side_effect::none);
+        replace_handler(hctx, handler_kind::finish_epoch_stream, new_FinishEpochStream_handler);
+        // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
+        if (!hctx.ok) {
+            LOG_CONTEXT(error, request_context)
+                << "Received FinishEpochStream RPC with handle_context ok set to false";
+            return;
+        }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
+        try {
+            auto &sessions = shard.sessions;
+            const auto &id = request.session_id();
+            auto epoch_index = request.active_epoch_index();
+            LOG_CONTEXT(info, request_context)
+                << "Received FinishEpochStream for session " << id << " epoch " << epoch_index;
+            // If a session is unknown, a bail out
+            if (sessions.find(id) == sessions.end()) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found"}),
                     request_context);
             }
-            auto &e = epochs[epoch_index];
-            // If epoch is not active, bail out
-            if (e.state != epoch_state::active) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch already finished"}),
+            // Otherwise, get session and lock until we exit handler
+            auto &session = sessions[id];
+            // If active_epoch_index is too large, bail
+            if (session.active_epoch_index == UINT64_MAX) {
+                THROW_CONTEXT(
+                    (finish_error_yield_none{grpc::StatusCode::OUT_OF_RANGE, "active epoch index will overflow"}),
                     request_context);
             }
-            // If there are still pending inputs to process, bail out
-            if (!e.pending_inputs.empty()) {
-                THROW_CONTEXT(
-                    (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch still has pending inputs"}),
+            // If session is already locked, bail out
+            auto new_lock_reason = get_session_lock_reason("FinishEpochStream", request_context.peer());
+            if (session.session_lock) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
+                                  "concurrent call in session (already locked by " + session.session_lock_reason +
+                                      " when attempted lock by " + new_lock_reason + ")"}),
                     request_context);
             }
-            // If the number of processed inputs does not match the expected, bail out
-            if (e.processed_inputs.size() != request.processed_input_count_within_epoch()) {
-                THROW_CONTEXT(
-                    (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
-                        "incorrect processed input count (expected " + std::to_string(e.processed_inputs.size()) +
-                            ", got " + std::to_string(request.processed_input_count_within_epoch()) + ")"}),
+            // Lock session so other rpcs to the same session are rejected
+            auto_lock session_lock(session.session_lock, "FinishEpochStream session lock", request_context);
+            session.session_lock_reason = new_lock_reason;
+            check_no_pending_queries(session, request_context);
+            auto &e = get_epoch_to_finish(session, request, request_context);
+            // Compact proofs are sent whole, so they cannot be streamed in chunks
+            if (request.compact_proofs()) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                                  "compact proofs not supported by FinishEpochStream"}),
                     request_context);
             }
             // Try to store session before we change anything
             if (!request.storage_directory().empty()) {
                 LOG_CONTEXT(debug, request_context) << "  Storing into " << request.storage_directory();
-                async_context actx{session, request_context, hctx.completion_queue.get(), self, yield};
+                async_context actx{session, request_context, shard.completion_queue.get(), self, yield};
                 store(actx, request.storage_directory());
             }
-            finish_epoch(e);
+            // Completing the trees runs in the worker pool, as in FinishEpoch
+            get_epoch_snapshot(e);
+            const uint64_t proof_count = get_proof_count(e);
+            std::optional<epoch_file_writer> file;
+            await_on_pool(shard, self, yield, [&]() {
+                finish_epoch(e);
+                if (!shard.epoch_storage_directory.empty()) {
+                    file.emplace(shard.epoch_storage_directory, id, e, proof_count);
+                }
+            });
+            // The epoch is finished from here on, however the stream ends
+            e.snapshot.reset();
+            wake_epoch_watchers(shard, e);
             start_new_epoch(e, session);
-            set_proto_finish_epoch_response(e, response);
+            // Send one chunk of proofs at a time, reusing the message, and wait for it to be written before building
+            // the next
+            FinishEpochResponse response;
+            set_proto_finish_epoch_hashes(e, response);
+            proof_cursor_type cursor;
+            std::shared_ptr<const cartesi::mapped_file> stored;
+            uint64_t sent_count = 0;
+            for (;;) {
+                const uint64_t count = std::min(proof_count - sent_count, FINISH_EPOCH_STREAM_CHUNK_PROOFS);
+                const bool last = sent_count + count == proof_count;
+                auto add_proofs = [&]() {
+                    add_proto_finish_epoch_proofs(e, cursor, count, response);
+                    // Move finished epoch out of memory, if so configured. The epoch is still usable in memory on
+                    // failure.
+                    if (file) {
+                        try {
+                            for (const auto &p : response.proofs()) {
+                                file->add_proof(p);
+                            }
+                            if (last) {
+                                stored = file->commit();
+                            }
+                        } catch (std::exception &x) {
+                            LOG_CONTEXT(warning, request_context) << "  Unable to store epoch (" << x.what() << ")";
+                            file.reset();
+                        }
+                    }
+                };
+                if (count >= MIN_POOL_WORK_ITEMS) {
+                    await_on_pool(shard, self, yield, add_proofs);
+                } else {
+                    add_proofs();
+                }
+                sent_count += count;
+                if (last) {
+                    break;
+                }
+                writer.Write(response, self);
+                yield(side_effect::none);
+                // The client went away. The epoch file, if any, is abandoned.
+                if (!shard.ok) {
+                    LOG_CONTEXT(debug, request_context)
+                        << "  FinishEpochStream closed by client after " << sent_count << " proofs";
+                    writer.Finish(grpc::Status::CANCELLED, self);
+                    yield(side_effect::none);
+                    return;
+                }
+                response.Clear();
+            }
+            // Release the epoch from memory here, not in the worker pool, since GetOutputProof reads it meanwhile
+            if (stored) {
+                release_stored_epoch(e, std::move(stored));
+                e.snapshot.reset();
+                LOG_CONTEXT(debug, request_context) << "  Stored epoch into " << e.storage->path();
+            }
+            writer.WriteAndFinish(response, grpc::WriteOptions{}, grpc::Status::OK, self);
+            yield(side_effect::none);
+        } catch (finish_error_yield_none &e) {
+            LOG_CONTEXT(error, request_context) << "Caught finish_error_yield_none " << e.status().error_message();
+            writer.Finish(e.status(), self);
+            yield(side_effect::none);
+        } catch (std::exception &e) {
+            LOG_CONTEXT(error, request_context) << "Caught unexpected exception " << e.what();
+            writer.Finish(grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + e.what()},
+                self);
+            yield(side_effect::none);
+        }
+    }};
+    return self;
+}
+
+/// \brief Creates a new handler for the GetOutputProof RPC and starts accepting requests
+/// \param hctx Handler context shared between all handlers
+static handler_type::pull_type *new_GetOutputProof_handler(handler_context &hctx) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::get_output_proof);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
+        using namespace grpc;
+        ServerContext request_context;
+        GetOutputProofRequest request;
+        ServerAsyncResponseWriter<GetOutputProofResponse> writer(&request_context);
+        auto *cq = hctx.completion_queue.get();
+        hctx.server->manager_async_service.RequestGetOutputProof(&request_context, &request, &writer, cq, cq, self);
+        yield(side_effect::none);
+        replace_handler(hctx, handler_kind::get_output_proof, new_GetOutputProof_handler);
+        // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
+        if (!hctx.ok) {
+            LOG_CONTEXT(error, request_context) << "Received GetOutputProof RPC with handle_context ok set to false";
+            return;
+        }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
+        try {
+            GetOutputProofResponse response; // NOLINT: Unknown. Maybe linter bug?
+            auto &sessions = shard.sessions;
+            const auto &id = request.session_id();
+            auto epoch_index = request.epoch_index();
+            auto epoch_input_index = request.input_index_within_epoch();
+            auto output_enum = request.output_enum();
+            auto output_index = request.output_index();
+            LOG_CONTEXT(info, request_context)
+                << "Received GetOutputProof for session " << id << " epoch " << epoch_index << " input "
+                << epoch_input_index << " " << OutputEnum_Name(output_enum) << " " << output_index;
+            // If a session is unknown, a bail out
+            if (sessions.find(id) == sessions.end()) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found"}),
+                    request_context);
+            }
+            // Otherwise, get session. There is no need to lock it: finished epochs no longer change.
+            auto &session = sessions[id];
+            auto &epochs = session.epochs;
+            // If epoch is unknown, a bail out
+            if (epochs.find(epoch_index) == epochs.end()) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "unknown epoch index"}),
+                    request_context);
+            }
+            auto &e = epochs[epoch_index];
+            // Proofs only exist for finished epochs. The snapshot, unlike the epoch, is only marked finished once
+            // FinishEpoch is done with it.
+            const auto snapshot = get_epoch_snapshot(e);
+            if (snapshot->state != epoch_state::finished) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch is not finished"}),
+                    request_context);
+            }
+            const output_proof_key_type key{id, epoch_index, epoch_input_index, output_enum, output_index};
+            if (const auto *cached = shard.output_proof_cache.find(key)) {
+                LOG_CONTEXT(debug, request_context) << "  Found proof in cache";
+                *response.mutable_proof() = *cached;
+            } else {
+                const bool found = snapshot->storage ?
+                    set_proto_stored_output_proof(*snapshot->storage, epoch_input_index, output_enum, output_index,
+                        response.mutable_proof()) :
+                    set_proto_output_proof(e, epoch_input_index, output_enum, output_index, response.mutable_proof());
+                // Either the input index is out of range, the input was not accepted, or it has fewer outputs
+                if (!found) {
+                    THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "unknown output"}),
+                        request_context);
+                }
+                shard.output_proof_cache.insert(key, response.proof());
+            }
             writer.Finish(response, grpc::Status::OK, self);
             yield(side_effect::none);
         } catch (finish_error_yield_none &e) {
@@ -910,24 +2551,27 @@ static handler_type::pull_type *new_FinishEpoch_handler(handler_context &hctx) {
 /// \brief Creates a new handler for the DeleteEpoch RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_DeleteEpoch_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::delete_epoch);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         DeleteEpochRequest request;
         ServerAsyncResponseWriter<Void> writer(&request_context);
         auto *cq = hctx.completion_queue.get();
-        hctx.manager_async_service.RequestDeleteEpoch(&request_context, &request, &writer, cq, cq, self);
+        hctx.server->manager_async_service.RequestDeleteEpoch(&request_context, &request, &writer, cq, cq, self);
         yield(side_effect::none);
-        new_DeleteEpoch_handler(hctx);
+        replace_handler(hctx, handler_kind::delete_epoch, new_DeleteEpoch_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received DeleteEpoch RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
         try {
             Void response; // NOLINT: Unknown. Maybe linter bug?
-            auto &sessions = hctx.sessions;
+            auto &sessions = shard.sessions;
             const auto &id = request.session_id();
             auto epoch_index = request.epoch_index();
             LOG_CONTEXT(info, request_context) << "Received DeleteEpoch for session " << id << " epoch " << epoch_index;
@@ -960,6 +2604,10 @@ static handler_type::pull_type *new_DeleteEpoch_handler(handler_context &hctx) {
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch is active"}),
                     request_context);
             }
+            remove_epoch_file(it->second);
+            shard.output_proof_cache.erase_if([&id, epoch_index](const output_proof_key_type &key) {
+                return std::get<0>(key) == id && std::get<1>(key) == epoch_index;
+            });
             session.epochs.erase(it);
             writer.Finish(response, grpc::Status::OK, self);
             yield(side_effect::none);
@@ -994,25 +2642,28 @@ static void shutdown_server(async_context &actx) {
 /// \brief Creates a new handler for the EndSession RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_EndSession_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::end_session);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         EndSessionRequest request;
         ServerAsyncResponseWriter<Void> writer(&request_context);
         auto *cq = hctx.completion_queue.get();
-        hctx.manager_async_service.RequestEndSession(&request_context, &request, &writer, cq, cq, self);
+        hctx.server->manager_async_service.RequestEndSession(&request_context, &request, &writer, cq, cq, self);
         yield(side_effect::none);
-        new_EndSession_handler(hctx);
+        replace_handler(hctx, handler_kind::end_session, new_EndSession_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received EndSession RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
         try {
             Status status; // NOLINT: Unknown. Maybe linter bug?
             Void response;
-            auto &sessions = hctx.sessions;
+            auto &sessions = shard.sessions;
             const auto &id = request.session_id();
             LOG_CONTEXT(info, request_context) << "Received EndSession for session " << id;
             // If a session is unknown, a bail out
@@ -1033,7 +2684,8 @@ static handler_type::pull_type *new_EndSession_handler(handler_context &hctx) {
             // Lock session so other rpcs to the same session are rejected
             auto_lock session_lock(session.session_lock, "EndSession session lock", request_context);
             session.session_lock_reason = new_lock_reason;
-            async_context actx{session, request_context, cq, self, yield};
+            check_no_pending_queries(session, request_context);
+            async_context actx{session, request_context, shard.completion_queue.get(), self, yield};
             // If the session is tainted, nothing is going on with it, so we can erase it
             if (!session.tainted) {
                 // If the session is not tainted, we will only delete it if the active epoch is pristine
@@ -1061,7 +2713,14 @@ static handler_type::pull_type *new_EndSession_handler(handler_context &hctx) {
                     << "Session " << id << " is tainted. Terminating remote machine server process group";
                 session.server_process_group.terminate();
             }
-            sessions.erase(id);
+            for (auto &entry : session.epochs) {
+                remove_epoch_file(entry.second);
+            }
+            shard.output_proof_cache.erase_if(
+                [&id](const output_proof_key_type &key) { return std::get<0>(key) == id; });
+            shard.inspect_cache.erase_if(
+                [&id](const inspect_cache_key_type &key) { return std::get<0>(key) == id; });
+            erase_session(shard, id);
             writer.Finish(response, grpc::Status::OK, self);
             yield(side_effect::none);
         } catch (finish_error_yield_none &e) {
@@ -1078,27 +2737,53 @@ static handler_type::pull_type *new_EndSession_handler(handler_context &hctx) {
     return self;
 }
 
+/// \brief Converts C++ inspect schedule statistics to proto InspectScheduleStatistics
+/// \param stats C++ statistics to convert
+/// \param proto_stats Pointer to proto InspectScheduleStatistics receiving result of conversion
+static void set_proto_inspect_schedule_stats(const inspect_schedule_stats_type &stats,
+    InspectScheduleStatistics *proto_stats) {
+    proto_stats->set_inspect_count(stats.inspect_count);
+    proto_stats->set_total_inspect_wait_us(stats.total_inspect_wait.count());
+    proto_stats->set_max_inspect_wait_us(stats.max_inspect_wait.count());
+    proto_stats->set_input_count(stats.input_count);
+    proto_stats->set_total_input_lag_us(stats.total_input_lag.count());
+    proto_stats->set_max_input_lag_us(stats.max_input_lag.count());
+}
+
+/// \brief Counts the inspect replicas of a session that could serve a query right now
+/// \param session Session
+/// \returns Number of idle replicas that reflect all inputs the session processed
+static uint64_t count_ready_inspect_replicas(const session_type &session) {
+    return static_cast<uint64_t>(
+        std::count_if(session.replicas.begin(), session.replicas.end(), [&session](const auto &replica) {
+            return !replica->busy && replica->machine.processed_input_count == session.processed_input_count;
+        }));
+}
+
 /// \brief Creates a new handler for the GetSessionStatus RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_GetSessionStatus_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::get_session_status);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         GetSessionStatusRequest request;
         ServerAsyncResponseWriter<GetSessionStatusResponse> writer(&request_context);
         auto *cq = hctx.completion_queue.get();
-        hctx.manager_async_service.RequestGetSessionStatus(&request_context, &request, &writer, cq, cq, self);
+        hctx.server->manager_async_service.RequestGetSessionStatus(&request_context, &request, &writer, cq, cq, self);
         yield(side_effect::none);
-        new_GetSessionStatus_handler(hctx);
+        replace_handler(hctx, handler_kind::get_session_status, new_GetSessionStatus_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received GetSessionStatus RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
         Status status; // NOLINT: cannot leak (pointer is in completion queue)
         GetSessionStatusResponse response;
-        auto &sessions = hctx.sessions;
+        auto &sessions = shard.sessions;
         const auto &id = request.session_id();
         LOG_CONTEXT(info, request_context) << "Received GetSessionStatus for session " << id;
         try {
@@ -1107,19 +2792,9 @@ static handler_type::pull_type *new_GetSessionStatus_handler(handler_context &hc
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found!"}),
                     request_context);
             }
-            // Otherwise, get session and lock until we exit handler
+            // Otherwise, get session. The response is built without yielding, and nothing it reads is changed by
+            // the worker pool, so there is no need to lock the session.
             auto &session = sessions[id];
-            // If session is already locked, bail out
-            auto new_lock_reason = get_session_lock_reason("GetSessionStatus", request_context.peer());
-            if (session.session_lock) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
-                                  "concurrent call in session (already locked by " + session.session_lock_reason +
-                                      " when attempted lock by " + new_lock_reason + ")"}),
-                    request_context);
-            }
-            // Lock session so other rpcs to the same session are rejected
-            auto_lock session_lock(session.session_lock, "GetSessionStatus session lock", request_context);
-            session.session_lock_reason = new_lock_reason;
             response.set_session_id(id);
             response.set_active_epoch_index(session.active_epoch_index);
             for (const auto &[index, epoch] : session.epochs) {
@@ -1130,6 +2805,11 @@ static handler_type::pull_type *new_GetSessionStatus_handler(handler_context &hc
                 response.mutable_taint_status()->set_error_code(session.taint_status.error_code());
                 response.mutable_taint_status()->set_error_message(session.taint_status.error_message());
             }
+            set_proto_inspect_schedule_stats(session.inspect_schedule_stats,
+                response.mutable_inspect_schedule_statistics());
+            response.set_inspect_replica_count(session.replicas.size());
+            response.set_ready_inspect_replica_count(count_ready_inspect_replicas(session));
+            response.set_inspect_cache_hit_count(session.inspect_cache_hit_count);
             writer.Finish(response, grpc::Status::OK, self);
             yield(side_effect::none);
         } catch (finish_error_yield_none &e) {
@@ -1146,129 +2826,145 @@ static handler_type::pull_type *new_GetSessionStatus_handler(handler_context &hc
     return self;
 }
 
-/// \brief Converts C++ address to proto Address
-/// \param a C++ address to convert
-/// \param proto_a Pointer to proto Address receiving result of conversion
-static void set_proto_evm_address(const evm_address_type &a, Address *proto_a) {
-    proto_a->set_data(a.data(), a.size());
-}
-
-/// \brief Converts proto Address to C++ address
-/// \param proto_a Proto Address to convert
-/// \returns Converted C++ address
-evm_address_type get_proto_evm_address(const Address &proto_a) {
-    evm_address_type a;
-    if (proto_a.data().size() != a.size()) {
-        throw std::invalid_argument("invalid address size");
-    }
-    memcpy(a.data(), proto_a.data().data(), proto_a.data().size());
-    return a;
-}
-
-/// \brief Fills out Voucher message from structure
-/// \param i Structure
-/// \param proto_i Pointer to message receiving structure contents
-static void set_proto_voucher(const voucher_type &o, Voucher *proto_o) {
-    set_proto_evm_address(o.destination, proto_o->mutable_destination());
-    proto_o->set_payload(o.payload);
-}
-
-/// \brief Fills out Notice message from structure
-/// \param m Structure
-/// \param proto_m Pointer to message receiving structure contents
-static void set_proto_notice(const notice_type &m, Notice *proto_m) {
-    proto_m->set_payload(m.payload);
-}
-
-/// \brief Fills out Report message from structure
-/// \param m Structure
-/// \param proto_m Pointer to message receiving structure contents
-static void set_proto_report(const report_type &m, Report *proto_m) {
-    proto_m->set_payload(m.payload);
-}
-
-/// \brief Fills out ProcessedInput accepted data message from structure
-/// \param i Structure
-/// \param proto_i Pointer to message receiving structure contents
-static void set_proto_accepted_data(const processed_input_type &i, ProcessedInput *proto_i) {
-    if (std::holds_alternative<accepted_data_type>(i.processed)) {
-        const auto &data = std::get<accepted_data_type>(i.processed);
-        auto *accepted_data_p = proto_i->mutable_accepted_data();
-        for (const auto &o : data.vouchers) {
-            set_proto_voucher(o, accepted_data_p->add_vouchers());
+/// \brief Creates a new handler for the WatchEpoch RPC and starts accepting requests
+/// \param hctx Handler context shared between all handlers
+/// \details The handler streams the processed inputs of the epoch, starting from the requested one, as they are
+/// processed. The stream ends when the epoch is finished or the session is tainted, after telling the client so.
+/// While there is nothing new to send, the handler waits in the epoch's list of watchers, so a client that goes away
+/// in the meantime is only noticed at the next write.
+static handler_type::pull_type *new_WatchEpoch_handler(handler_context &hctx) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::watch_epoch);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
+        using namespace grpc;
+        ServerContext request_context;
+        WatchEpochRequest request;
+        ServerAsyncWriter<WatchEpochResponse> writer(&request_context);
+        auto *cq = hctx.completion_queue.get();
+        hctx.server->manager_async_service.RequestWatchEpoch(&request_context, &request, &writer, cq, cq, self);
+        yield(side_effect::none);
+        replace_handler(hctx, handler_kind::watch_epoch, new_WatchEpoch_handler);
+        // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
+        if (!hctx.ok) {
+            LOG_CONTEXT(error, request_context) << "Received WatchEpoch RPC with handle_context ok set to false";
+            return;
         }
-        for (const auto &m : data.notices) {
-            set_proto_notice(m, accepted_data_p->add_notices());
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
+        try {
+            auto &sessions = shard.sessions;
+            const auto &id = request.session_id();
+            auto epoch_index = request.epoch_index();
+            LOG_CONTEXT(info, request_context) << "Received WatchEpoch for session " << id << " epoch " << epoch_index
+                                               << " from input " << request.processed_input_index();
+            auto next_input_index = request.processed_input_index();
+            for (;;) {
+                // Whenever we come back, the session or the epoch may be gone
+                auto session_it = sessions.find(id);
+                if (session_it == sessions.end()) {
+                    THROW_CONTEXT(
+                        (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found"}),
+                        request_context);
+                }
+                auto &session = session_it->second;
+                auto epoch_it = session.epochs.find(epoch_index);
+                if (epoch_it == session.epochs.end()) {
+                    THROW_CONTEXT(
+                        (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "unknown epoch index"}),
+                        request_context);
+                }
+                auto &e = epoch_it->second;
+                const auto snapshot = get_epoch_snapshot(e);
+                // Send processed inputs first, then how the stream ends, if it does
+                WatchEpochResponse response;
+                bool last = false;
+                if (next_input_index < get_processed_input_count(*snapshot)) {
+                    set_proto_processed_input(*snapshot, next_input_index, response.mutable_processed_input());
+                    ++next_input_index;
+                } else if (session.tainted) {
+                    response.mutable_taint_status()->set_error_code(session.taint_status.error_code());
+                    response.mutable_taint_status()->set_error_message(session.taint_status.error_message());
+                    last = true;
+                } else if (snapshot->state == epoch_state::finished) {
+                    response.set_state(EpochState::FINISHED);
+                    last = true;
+                } else {
+                    // Nothing to send until the epoch or the session changes
+                    e.watchers.push_back(self);
+                    yield(side_effect::none);
+                    continue;
+                }
+                if (last) {
+                    writer.WriteAndFinish(response, grpc::WriteOptions{}, grpc::Status::OK, self);
+                    yield(side_effect::none);
+                    return;
+                }
+                writer.Write(response, self);
+                yield(side_effect::none);
+                // The client went away
+                if (!shard.ok) {
+                    LOG_CONTEXT(debug, request_context) << "  WatchEpoch stream closed by client";
+                    writer.Finish(grpc::Status::CANCELLED, self);
+                    yield(side_effect::none);
+                    return;
+                }
+            }
+        } catch (finish_error_yield_none &e) {
+            LOG_CONTEXT(error, request_context) << "Caught finish_error_yield_none " << e.status().error_message();
+            writer.Finish(e.status(), self);
+            yield(side_effect::none);
+        } catch (std::exception &e) {
+            LOG_CONTEXT(error, request_context) << "Caught unexpected exception " << e.what();
+            writer.Finish(grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + e.what()},
+                self);
+            yield(side_effect::none);
         }
-    }
+    }};
+    return self;
 }
 
-/// \brief Fills out ProcessedInput exception data message from structure
-/// \param i Structure
-/// \param proto_i Pointer to message receiving structure contents
-static void set_proto_exception_data(const processed_input_type &i, ProcessedInput *proto_i) {
-    if (std::holds_alternative<std::string>(i.processed)) {
-        const auto &data = std::get<std::string>(i.processed);
-        proto_i->set_exception_data(data);
-    }
-}
-
-/// \brief Fills out ProcessedInput message from structure
-/// \param i Structure
-/// \param proto_i Pointer to message receiving structure contents
-static void set_proto_processed_input(const processed_input_type &i, ProcessedInput *proto_i) {
-    proto_i->set_input_index(i.input_index);
-    for (const auto &r : i.reports) {
-        set_proto_report(r, proto_i->add_reports());
-    }
-    switch (i.status) {
-        case completion_status::accepted:
-            proto_i->set_status(CompletionStatus::ACCEPTED);
-            set_proto_accepted_data(i, proto_i);
-            break;
-        case completion_status::rejected:
-            proto_i->set_status(CompletionStatus::REJECTED);
-            break;
-        case completion_status::exception:
-            proto_i->set_status(CompletionStatus::EXCEPTION);
-            set_proto_exception_data(i, proto_i);
-            break;
-        case completion_status::machine_halted:
-            proto_i->set_status(CompletionStatus::MACHINE_HALTED);
-            break;
-        case completion_status::cycle_limit_exceeded:
-            proto_i->set_status(CompletionStatus::CYCLE_LIMIT_EXCEEDED);
-            break;
-        case completion_status::time_limit_exceeded:
-            proto_i->set_status(CompletionStatus::TIME_LIMIT_EXCEEDED);
-            break;
-        case completion_status::payload_length_limit_exceeded:
-            proto_i->set_status(CompletionStatus::PAYLOAD_LENGTH_LIMIT_EXCEEDED);
-            break;
-    }
+/// \brief Hands a serialized message over to a ByteBuffer, without copying it
+/// \param bytes Serialized message
+static grpc::ByteBuffer make_byte_buffer(std::string &&bytes) {
+    auto *owned = new std::string{std::move(bytes)};
+    grpc::Slice slice{owned->data(), owned->size(), [](void *p) { delete static_cast<std::string *>(p); }, owned};
+    return grpc::ByteBuffer{&slice, 1};
 }
 
 /// \brief Creates a new handler for the GetEpochStatus RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_GetEpochStatus_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::get_epoch_status);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
-        GetEpochStatusRequest request;
-        ServerAsyncResponseWriter<GetEpochStatusResponse> writer(&request_context);
+        ByteBuffer request_buffer;
+        ServerAsyncResponseWriter<ByteBuffer> writer(&request_context);
         auto *cq = hctx.completion_queue.get();
-        hctx.manager_async_service.RequestGetEpochStatus(&request_context, &request, &writer, cq, cq, self);
+        hctx.server->manager_async_service.RequestGetEpochStatus(&request_context, &request_buffer, &writer, cq, cq,
+            self);
         yield(side_effect::none);
-        new_GetEpochStatus_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        replace_handler(hctx, handler_kind::get_epoch_status, new_GetEpochStatus_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received GetEpochStatus RPC with handle_context ok set to false";
             return;
         }
+        // The method is raw, so the request must be parsed here
+        GetEpochStatusRequest request;
+        if (!SerializationTraits<GetEpochStatusRequest>::Deserialize(&request_buffer, &request).ok()) {
+            LOG_CONTEXT(error, request_context) << "Received GetEpochStatus RPC with malformed request";
+            writer.FinishWithError(grpc::Status{grpc::StatusCode::INVALID_ARGUMENT, "malformed request"}, self);
+            yield(side_effect::none);
+            return;
+        }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, request.session_id(), self, yield);
         try {
+            // Processed inputs are left out of the message and spliced into its serialization
             GetEpochStatusResponse response; // NOLINT: Unknown. Maybe linter bug?
-            auto &sessions = hctx.sessions;
+            auto &sessions = shard.sessions;
             const auto &id = request.session_id();
             auto epoch_index = request.epoch_index();
             LOG_CONTEXT(info, request_context)
@@ -1278,19 +2974,8 @@ static handler_type::pull_type *new_GetEpochStatus_handler(handler_context &hctx
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found"}),
                     request_context);
             }
-            // Otherwise, get session and lock until we exit handler
+            // Otherwise, get session. The epoch is read from its snapshot, so there is no need to lock the session.
             auto &session = sessions[id];
-            // If session is already locked, bail out
-            auto new_lock_reason = get_session_lock_reason("GetEpochStatus", request_context.peer());
-            if (session.session_lock) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
-                                  "concurrent call in session (already locked by " + session.session_lock_reason +
-                                      " when attempted lock by " + new_lock_reason + ")"}),
-                    request_context);
-            }
-            // Lock session so other rpcs to the same session are rejected
-            auto_lock session_lock(session.session_lock, "GetEpochStatus session lock", request_context);
-            session.session_lock_reason = new_lock_reason;
             auto &epochs = session.epochs;
             // If a session is unknown, a bail out
             if (epochs.find(epoch_index) == epochs.end()) {
@@ -1298,9 +2983,10 @@ static handler_type::pull_type *new_GetEpochStatus_handler(handler_context &hctx
                     request_context);
             }
             auto &e = epochs[epoch_index];
+            const auto snapshot = get_epoch_snapshot(e);
             response.set_session_id(id);
             response.set_epoch_index(epoch_index);
-            switch (e.state) {
+            switch (snapshot->state) {
                 case epoch_state::active:
                     response.set_state(EpochState::ACTIVE);
                     break;
@@ -1308,15 +2994,40 @@ static handler_type::pull_type *new_GetEpochStatus_handler(handler_context &hctx
                     response.set_state(EpochState::FINISHED);
                     break;
             }
-            for (const auto &i : e.processed_inputs) {
-                set_proto_processed_input(i, response.add_processed_inputs());
-            }
+            // Everything else is read now, so the response is consistent with the snapshot even if the session
+            // changes, or goes away, while the processed inputs are filled out
             response.set_pending_input_count(e.pending_inputs.size());
             if (session.tainted) {
                 response.mutable_taint_status()->set_error_code(session.taint_status.error_code());
                 response.mutable_taint_status()->set_error_message(session.taint_status.error_message());
             }
-            writer.Finish(response, grpc::Status::OK, self);
+            // Only return the requested range of processed inputs, and tell the caller where the next one starts
+            const uint64_t input_count = get_processed_input_count(*snapshot);
+            const uint64_t first = std::min<uint64_t>(request.processed_input_index(), input_count);
+            uint64_t last = input_count;
+            if (request.processed_input_limit() != 0 && request.processed_input_limit() < last - first) {
+                last = first + request.processed_input_limit();
+            }
+            response.set_next_processed_input_index(last);
+            processed_input_omissions_type omit;
+            omit.payloads = request.omit_payloads();
+            omit.reports = request.omit_reports();
+            omit.exception_data = request.omit_exception_data();
+            std::string serialized_response;
+            auto append_processed_inputs = [&snapshot, &response, &serialized_response, first, last, omit]() {
+                response.SerializeToString(&serialized_response);
+                for (uint64_t i = first; i < last; ++i) {
+                    append_serialized_processed_input(*snapshot, i, omit, serialized_response);
+                }
+            };
+            // The snapshot never changes, so large responses can be built in the worker pool while inputs are
+            // processed
+            if (last - first >= MIN_POOL_WORK_ITEMS) {
+                await_on_pool(shard, self, yield, append_processed_inputs);
+            } else {
+                append_processed_inputs();
+            }
+            writer.Finish(make_byte_buffer(std::move(serialized_response)), grpc::Status::OK, self);
             yield(side_effect::none);
         } catch (finish_error_yield_none &e) {
             LOG_CONTEXT(error, request_context) << "Caught finish_error_yield_none " << e.status().error_message();
@@ -1370,6 +3081,27 @@ static auto get_proto_cycles_config(const CyclesConfig &proto_p) {
     return c;
 }
 
+/// \brief Initializes new inspect schedule structure from request
+/// \param proto_p Corresponding InspectSchedule
+static auto get_proto_inspect_schedule(const InspectSchedule &proto_p) {
+    inspect_schedule_type s{};
+    switch (proto_p.policy()) {
+        case InspectSchedulePolicy::INPUT_PRIORITY:
+            s.policy = inspect_schedule_policy::input_priority;
+            break;
+        case InspectSchedulePolicy::WEIGHTED:
+            s.policy = inspect_schedule_policy::weighted;
+            break;
+        default:
+            s.policy = inspect_schedule_policy::inspect_priority;
+            break;
+    }
+    s.max_input_latency = std::chrono::milliseconds{proto_p.max_input_latency_ms()};
+    s.input_weight = proto_p.input_weight();
+    s.inspect_weight = proto_p.inspect_weight();
+    return s;
+}
+
 /// \brief Initializes new session structure from request
 /// \param request Corresponding StartSessionRequest
 static auto get_proto_session(const StartSessionRequest &request) {
@@ -1382,6 +3114,9 @@ static auto get_proto_session(const StartSessionRequest &request) {
     session.processed_input_count = request.processed_input_count();
     session.server_deadline = get_proto_deadline_config(request.server_deadline());
     session.server_cycles = get_proto_cycles_config(request.server_cycles());
+    if (request.has_inspect_schedule()) {
+        session.inspect_schedule = get_proto_inspect_schedule(request.inspect_schedule());
+    }
     return session;
 }
 
@@ -1533,8 +3268,9 @@ static void check_server_stub(const grpc::ServerContext &request_context, sessio
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_CheckinDeadline_handler(handler_context &hctx, const id_type &id,
     uint64_t deadline) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx, id, deadline](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::checkin_deadline);
+    new (self) handler_type::pull_type{stack, [self, &hctx, id, deadline](handler_type::push_type &yield) {
         using namespace grpc;
         auto it_before = hctx.sessions_waiting_checkin.find(id);
         // If there isn't a session with id waiting for check-in, it's a bug on the implementation
@@ -1580,7 +3316,7 @@ void trigger_and_wait_checkin(handler_context &hctx, async_context &actx, T trig
     trigger_checkin(hctx, actx); // NOLINT: avoid boost warnings?
     // Wait for CheckIn
     LOG_CONTEXT(debug, actx.request_context) << "  Waiting check-in";
-    hctx.sessions_waiting_checkin[actx.session.id] = {actx.self, std::make_unique<grpc::Alarm>(), std::nullopt};
+    hctx.sessions_waiting_checkin[actx.session.id] = {actx.self, std::make_unique<grpc::Alarm>(), std::nullopt, {}};
     // NOLINTNEXTLINE: cannot leak (pointer is in completion queue)
     new_CheckinDeadline_handler(hctx, actx.session.id, actx.session.server_deadline.checkin);
     actx.yield(side_effect::none); // NOLINT: avoid boost warnings
@@ -1603,6 +3339,7 @@ void trigger_and_wait_checkin(handler_context &hctx, async_context &actx, T trig
             actx.request_context);
     }
     // Check-in was successful
+    actx.session.server_address = std::move(it->second.address);
     hctx.sessions_waiting_checkin.erase(it);
     LOG_CONTEXT(debug, actx.request_context)
         << "  Check-in for session " << actx.session.id << " passed with address " << actx.session.server_address;
@@ -1743,29 +3480,54 @@ static void start_first_epoch(async_context &actx, session_type &session) {
     session.epochs[e.epoch_index] = std::move(e);
 }
 
+/// \brief Spawns a new machine server and asks it to check-in
+/// \param shard Handler context of the session's shard
+/// \param actx Context for async operations
+static void spawn_server(handler_context &shard, async_context &actx) {
+    auto cmdline = shard.remote_cartesi_machine_path + " --session-id=" + actx.session.id +
+        " --checkin-address=" + shard.manager_address + " --server-address=" + shard.server_address;
+    LOG_CONTEXT(debug, actx.request_context) << "  Spawning " << cmdline;
+    try {
+        // NOLINTNEXTLINE: boost generated warnings
+        auto server_process = boost::process::child(cmdline, actx.session.server_process_group);
+        server_process.detach();
+    } catch (boost::process::process_error &e) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INTERNAL,
+                          "failed spawning remote machine server with command-line '" + cmdline + "' (" + e.what() +
+                              ")"}),
+            actx.request_context);
+    }
+}
+
+static void start_inspect_replicas(handler_context &shard, session_type &session, uint64_t count,
+    const std::string &machine_directory);
+
 /// \brief Creates a new handler for the StartSession RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_StartSession_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::start_session);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         StartSessionRequest start_session_request;
         ServerAsyncResponseWriter<StartSessionResponse> start_session_writer(&request_context);
         auto *cq = hctx.completion_queue.get();
         // Wait for a StartSession RPC
-        hctx.manager_async_service.RequestStartSession(&request_context, &start_session_request, &start_session_writer,
-            cq, cq, self);
+        hctx.server->manager_async_service.RequestStartSession(&request_context, &start_session_request,
+            &start_session_writer, cq, cq, self);
         yield(side_effect::none);
-        new_StartSession_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        replace_handler(hctx, handler_kind::start_session, new_StartSession_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received StartSession RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, start_session_request.session_id(), self, yield);
         try {
             // We now received a StartSession RPC
-            auto &sessions = hctx.sessions; // NOLINT: Unknown. Maybe linter bug?
+            auto &sessions = shard.sessions; // NOLINT: Unknown. Maybe linter bug?
             const auto &id = start_session_request.session_id();
             LOG_CONTEXT(info, request_context) << "Received StartSession request for session " << id;
             // Empty id is invalid, so a bail out
@@ -1775,15 +3537,15 @@ static handler_type::pull_type *new_StartSession_handler(handler_context &hctx)
                 yield(side_effect::none);
                 return;
             }
-            // If a session with this id already exists, a bail out
-            if (sessions.find(id) != sessions.end()) {
+            // If a session or an inspect replica with this id already exists, a bail out
+            if (sessions.find(id) != sessions.end() || find_replica_shard(*shard.server, id) != nullptr) {
                 start_session_writer.FinishWithError(grpc::Status{StatusCode::ALREADY_EXISTS, "session id is taken"},
                     self);
                 yield(side_effect::none);
                 return;
             }
             // Allocate a new session with data from request
-            auto &session = (sessions[id] = get_proto_session(start_session_request));
+            auto &session = insert_session(shard, id, get_proto_session(start_session_request));
             // Lock session so other rpcs to the same session are rejected
             auto new_lock_reason = get_session_lock_reason("StartSession", request_context.peer());
             auto_lock lock(session.session_lock, "StartSession session lock", request_context);
@@ -1846,24 +3608,24 @@ static handler_type::pull_type *new_StartSession_handler(handler_context &hctx)
                                   "max cycles per inspect state is less than cycles per inspect state increment"}),
                     request_context);
             }
+            // If too many inspect replicas were requested, bail out
+            if (start_session_request.inspect_replica_count() > MAX_INSPECT_REPLICAS) {
+                THROW_CONTEXT((finish_error_yield_none{StatusCode::INVALID_ARGUMENT,
+                                  "too many inspect replicas (expected at most " +
+                                      std::to_string(MAX_INSPECT_REPLICAS) + ", got " +
+                                      std::to_string(start_session_request.inspect_replica_count()) + ")"}),
+                    request_context);
+            }
+            // If the weighted inspect schedule would never run inputs or queries, bail out
+            if (session.inspect_schedule.policy == inspect_schedule_policy::weighted &&
+                (session.inspect_schedule.input_weight == 0 || session.inspect_schedule.inspect_weight == 0)) {
+                THROW_CONTEXT((finish_error_yield_none{StatusCode::INVALID_ARGUMENT,
+                                  "input weight or inspect weight of weighted inspect schedule is zero"}),
+                    request_context);
+            }
             // Wait for machine server to checkin after spawned
-            async_context actx{session, request_context, cq, self, yield};
-            trigger_and_wait_checkin(hctx, actx, [](handler_context &hctx, async_context &actx) {
-                // Spawn a new server and ask it to check-in
-                auto cmdline = hctx.remote_cartesi_machine_path + " --session-id=" + actx.session.id +
-                    " --checkin-address=" + hctx.manager_address + " --server-address=" + hctx.server_address;
-                LOG_CONTEXT(debug, actx.request_context) << "  Spawning " << cmdline;
-                try {
-                    // NOLINTNEXTLINE: boost generated warnings
-                    auto server_process = boost::process::child(cmdline, actx.session.server_process_group);
-                    server_process.detach();
-                } catch (boost::process::process_error &e) {
-                    THROW_CONTEXT((finish_error_yield_none{StatusCode::INTERNAL,
-                                      "failed spawning remote machine server with command-line '" + cmdline + "' (" +
-                                          e.what() + ")"}),
-                        actx.request_context);
-                }
-            });
+            async_context actx{session, request_context, shard.completion_queue.get(), self, yield};
+            trigger_and_wait_checkin(shard, actx, spawn_server);
             try {
                 check_server_version(actx);
                 check_server_machine(actx, start_session_request.machine_directory());
@@ -1874,6 +3636,9 @@ static handler_type::pull_type *new_StartSession_handler(handler_context &hctx)
                 // when we need to run an input for at most max_cycles_per_input
                 session.current_mcycle = check_is_yielded(actx);
                 start_first_epoch(actx, session);
+                // Replicas start in the background, and serve queries once they are ready
+                start_inspect_replicas(shard, session, start_session_request.inspect_replica_count(),
+                    start_session_request.machine_directory());
                 // StartSession Passed!
                 StartSessionResponse start_session_response;
                 start_session_response.set_allocated_config(&config);
@@ -1891,12 +3656,12 @@ static handler_type::pull_type *new_StartSession_handler(handler_context &hctx)
             }
         } catch (finish_error_yield_none &e) {
             LOG_CONTEXT(error, request_context) << "Caught finish_error_yield_none " << e.status().error_message();
-            hctx.sessions.erase(start_session_request.session_id());
+            erase_session(shard, start_session_request.session_id());
             start_session_writer.FinishWithError(e.status(), self);
             yield(side_effect::none);
         } catch (std::exception &e) {
             LOG_CONTEXT(error, request_context) << "Caught unexpected exception " << e.what();
-            hctx.sessions.erase(start_session_request.session_id());
+            erase_session(shard, start_session_request.session_id());
             start_session_writer.FinishWithError(
                 grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + e.what()}, self);
             yield(side_effect::none);
@@ -2076,15 +3841,9 @@ static std::string read_memory_range(async_context &actx, const MemoryRangeConfi
 /// \param begin First element
 /// \param end One past last element
 /// \return True if all are null, false otherwie
-template <typename IT>
-static inline bool is_null(IT begin, IT end) {
-    while (begin != end) {
-        if (*begin) {
-            return false;
-        }
-        ++begin;
-    }
-    return true;
+static inline bool is_null(const char *begin, const char *end) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return cartesi::is_null(reinterpret_cast<const unsigned char *>(begin), static_cast<size_t>(end - begin));
 }
 
 /// \brief Counts number of entries until the first null entry
@@ -2092,16 +3851,41 @@ static inline bool is_null(IT begin, IT end) {
 /// \param entry_length Length of each entry
 /// \return Number of entries
 static uint64_t count_null_terminated_entries(const std::string &data, int entry_length) {
-    auto begin = data.begin();
-    uint64_t count = 0;
-    while (begin + entry_length <= data.end()) {
-        if (is_null(begin, begin + entry_length)) {
-            return count;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return cartesi::count_null_terminated_entries(reinterpret_cast<const unsigned char *>(data.data()), data.size(),
+        static_cast<size_t>(entry_length));
+}
+
+/// \brief Returns the number of heap bytes used by the hash of an output, i.e., the sibling hashes in its proof
+/// \param hash Optional hash
+static uint64_t get_heap_footprint(const std::optional<keccak_type> &hash) {
+    if (!hash.has_value()) {
+        return 0;
+    }
+    const auto &p = hash.value().keccak_in_hashes;
+    return (p.get_log2_root_size() - p.get_log2_target_size()) * sizeof(hash_type);
+}
+
+/// \brief Returns the approximate number of bytes used by a processed input, including its heap allocations
+/// \param i Processed input
+static uint64_t get_footprint(const processed_input_type &i) {
+    uint64_t footprint = sizeof(i) + i.reports.capacity() * sizeof(report_type) + i.serialized.capacity();
+    for (const auto &r : i.reports) {
+        footprint += r.payload.capacity();
+    }
+    if (std::holds_alternative<accepted_data_type>(i.processed)) {
+        const auto &data = std::get<accepted_data_type>(i.processed);
+        footprint += data.vouchers.capacity() * sizeof(voucher_type) + data.notices.capacity() * sizeof(notice_type);
+        for (const auto &v : data.vouchers) {
+            footprint += v.payload.capacity() + get_heap_footprint(v.hash);
+        }
+        for (const auto &n : data.notices) {
+            footprint += n.payload.capacity() + get_heap_footprint(n.hash);
         }
-        count++;
-        begin += entry_length;
+    } else {
+        footprint += std::get<exception_data_type>(i.processed).capacity();
     }
-    return count;
+    return footprint;
 }
 
 /// \brief Converts a string to a hash
@@ -2437,14 +4221,10 @@ static void check_htif_yield_ack_data(async_context &actx, uint64_t reqid) {
     }
 }
 
-/// \brief Processes a pending query
-/// \param actx Context for async operations
-/// \param e Associated epoch
-static void process_pending_query(handler_context &hctx, async_context &actx, epoch_type &e) {
-    if (!e.pending_query.has_value()) { // should never happen
-        return;
-    }
-    auto &q = e.pending_query.value();
+/// \brief Processes a query
+/// \param actx Context for async operations, on the session's machine or on one of its inspect replicas
+/// \param q Query
+static void process_query(handler_context &hctx, async_context &actx, query_type &q) {
     q.processed_input_count = actx.session.processed_input_count;
     LOG_CONTEXT(debug, actx.request_context) << "  Processing pending query";
     LOG_CONTEXT(debug, actx.request_context) << "    Current input index: " << q.processed_input_count;
@@ -2539,6 +4319,390 @@ static void process_pending_query(handler_context &hctx, async_context &actx, ep
     });
 }
 
+/// \brief Replays an input the session accepted on one of its inspect replicas
+/// \param actx Context for async operations, on the replica
+/// \param i Input
+/// \param mcycle Session mcycle after the session accepted the input
+/// \details The machine is deterministic, so the replica must accept the input exactly where the session did.
+/// Outputs are of no interest to the replica, so automatic yields are simply skipped.
+static void replay_input(async_context &actx, const input_type &i, uint64_t mcycle) {
+    LOG_CONTEXT(debug, actx.request_context) << "  Replaying input " << actx.session.processed_input_count;
+    clear_memory_ranges(actx);
+    write_evm_abi_string(actx, i.payload.begin(), i.payload.end(), actx.session.memory_range.rx_buffer.config);
+    auto metadata = evm_abi_encoded_input_metadata(i.metadata);
+    write_memory_range(actx, metadata.begin(), metadata.end(), actx.session.memory_range.input_metadata.config);
+    reset_iflags_y(actx);
+    check_htif_yield_ack_data(actx, ROLLUP_ADVANCE_STATE);
+    auto start_time = std::chrono::system_clock::now();
+    auto current_mcycle = actx.session.current_mcycle;
+    auto mcycle_increment = actx.session.server_cycles.advance_state_increment;
+    auto deadline_increment = actx.session.server_deadline.advance_state_increment;
+    auto max_deadline = actx.session.server_deadline.advance_state;
+    for (;;) {
+        auto run_response =
+            run_machine(actx, current_mcycle, mcycle_increment, mcycle, start_time, deadline_increment, max_deadline);
+        if (!run_response.has_value()) {
+            THROW_CONTEXT((taint_session{actx.session, grpc::StatusCode::DEADLINE_EXCEEDED,
+                              "replica exceeded time limit replaying input"}),
+                actx.request_context);
+        }
+        uint64_t yield_reason = run_response.value().tohost() << 16 >> 48;
+        if (run_response.value().iflags_y() && yield_reason == HTIF_YIELD_REASON_RX_ACCEPTED &&
+            run_response.value().mcycle() == mcycle) {
+            break;
+        }
+        if (run_response.value().iflags_y() || run_response.value().iflags_h() || !run_response.value().iflags_x() ||
+            run_response.value().mcycle() >= mcycle) {
+            THROW_CONTEXT((taint_session{actx.session, grpc::StatusCode::INTERNAL,
+                              "replica diverged from session at mcycle " +
+                                  std::to_string(run_response.value().mcycle())}),
+                actx.request_context);
+        }
+        // Skip automatic yield
+        current_mcycle = run_response.value().mcycle();
+    }
+    actx.session.current_mcycle = mcycle;
+}
+
+/// \brief Returns the session an inspect replica belongs to
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \param replica Replica
+/// \returns Pointer to session, or nullptr if the session ended or dropped the replica
+static session_type *find_replica_session(handler_context &shard, const id_type &id,
+    const std::shared_ptr<replica_type> &replica) {
+    auto it = shard.sessions.find(id);
+    if (it == shard.sessions.end()) {
+        return nullptr;
+    }
+    auto &replicas = it->second.replicas;
+    if (std::find(replicas.begin(), replicas.end(), replica) == replicas.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+/// \brief Removes the inputs that all inspect replicas of a session have replayed from its replica log
+/// \param session Session
+static void trim_replica_log(session_type &session) {
+    auto oldest = session.processed_input_count;
+    for (const auto &replica : session.replicas) {
+        oldest = std::min(oldest, replica->machine.processed_input_count);
+    }
+    while (session.replica_log_start < oldest) {
+        session.replica_log.pop_front();
+        ++session.replica_log_start;
+    }
+}
+
+/// \brief Lends an inspect replica to the oldest query accepting a stale read that waits for one, if any
+/// \param shard Handler context of the session's shard
+/// \param session Session
+/// \param replica Replica, busy and not in the middle of replaying an input
+/// \returns True if replica was lent, in which case it stays busy until the query releases it
+static bool lend_inspect_replica(handler_context &shard, session_type &session,
+    const std::shared_ptr<replica_type> &replica) {
+    if (session.stale_waiters.empty()) {
+        return false;
+    }
+    auto *waiter = session.stale_waiters.front();
+    session.stale_waiters.pop_front();
+    waiter->replica = replica;
+    enqueue_completion_queue(shard.completion_queue.get(), waiter->coroutine);
+    return true;
+}
+
+/// \brief Removes a failed inspect replica from its session
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \param replica Replica
+/// \param reason Why replica failed
+/// \details The session itself is not affected. It goes on with the remaining replicas, if any.
+static void drop_inspect_replica(handler_context &shard, const id_type &id,
+    const std::shared_ptr<replica_type> &replica, const std::string &reason) {
+    BOOST_LOG_TRIVIAL(error) << "Dropping inspect replica " << replica->machine.id << " (" << reason << ")";
+    auto *session = find_replica_session(shard, id, replica);
+    if (session != nullptr) {
+        auto &replicas = session->replicas;
+        replicas.erase(std::remove(replicas.begin(), replicas.end(), replica), replicas.end());
+        trim_replica_log(*session);
+        // Without replicas, queries waiting for one would wait forever
+        if (replicas.empty()) {
+            for (auto *waiter : session->stale_waiters) {
+                enqueue_completion_queue(shard.completion_queue.get(), waiter->coroutine);
+            }
+            session->stale_waiters.clear();
+        }
+    }
+}
+
+/// \brief Starts the machine server of an inspect replica
+/// \param shard Handler context of the session's shard
+/// \param actx Context for async operations, on the replica
+/// \param machine_directory Directory the session's machine was loaded from
+static void start_inspect_replica(handler_context &shard, async_context &actx, const std::string &machine_directory) {
+    trigger_and_wait_checkin(shard, actx, spawn_server);
+    check_server_version(actx);
+    check_server_machine(actx, machine_directory);
+    actx.session.current_mcycle = check_is_yielded(actx);
+}
+
+/// \brief Replays inputs on an inspect replica until it reflects all inputs its session processed
+/// \param actx Context for async operations, on the replica
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \param replica Replica
+/// \details Once done, the replica is marked as idle
+static void refresh_inspect_replica(async_context &actx, handler_context &shard, const id_type &id,
+    const std::shared_ptr<replica_type> &replica) {
+    for (;;) {
+        // The session may have ended, or dropped the replica, while we yielded
+        auto *session = find_replica_session(shard, id, replica);
+        if (session == nullptr) {
+            return;
+        }
+        trim_replica_log(*session);
+        // Queries accepting stale reads go before the remaining inputs. Whoever releases the replica resumes replay.
+        if (lend_inspect_replica(shard, *session, replica)) {
+            return;
+        }
+        auto &machine = replica->machine;
+        if (machine.processed_input_count == session->processed_input_count) {
+            replica->busy = false;
+            return;
+        }
+        // Hold on to the input, because the log may be trimmed while we yield
+        auto replayed = session->replica_log[machine.processed_input_count - session->replica_log_start];
+        if (replayed.input) {
+            replay_input(actx, *replayed.input, replayed.mcycle);
+        }
+        ++machine.processed_input_count;
+    }
+}
+
+/// \brief Creates a new handler that brings an inspect replica up to date with its session
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \param replica Replica, marked as busy by the caller
+/// \param machine_directory Directory the session's machine was loaded from, used if the replica was not started
+/// \details If anything goes wrong, the replica is dropped from its session
+static handler_type::pull_type *new_InspectReplica_handler(handler_context &shard, const id_type &id,
+    std::shared_ptr<replica_type> replica, const std::string &machine_directory) {
+    auto *self = allocate_handler(shard);
+    auto stack = get_stack_allocator(shard, handler_kind::inspect_replica);
+    new (self) handler_type::pull_type{stack,
+        [self, &shard, id, replica = std::move(replica), machine_directory](handler_type::push_type &yield) {
+            // There is no RPC behind this handler, so the context is only used for logging
+            grpc::ServerContext request_context;
+            async_context actx{replica->machine, request_context, shard.completion_queue.get(), self, yield};
+            try {
+                if (!replica->machine.server_stub) {
+                    start_inspect_replica(shard, actx, machine_directory);
+                }
+                refresh_inspect_replica(actx, shard, id, replica);
+            } catch (taint_session &e) {
+                drop_inspect_replica(shard, id, replica, e.status().error_message());
+            } catch (handler_exception &e) {
+                drop_inspect_replica(shard, id, replica, e.status().error_message());
+            } catch (std::exception &e) {
+                drop_inspect_replica(shard, id, replica, std::string{"unexpected exception "} + e.what());
+            }
+            // Finish from the completion queue, so the dispatch thread deletes the handler
+            enqueue_completion_queue(shard.completion_queue.get(), self);
+            yield(side_effect::none);
+        }};
+    return self;
+}
+
+/// \brief Creates the inspect replicas of a session and starts their machine servers in the background
+/// \param shard Handler context of the session's shard
+/// \param session Session that was just started
+/// \param count Number of replicas
+/// \param machine_directory Directory the session's machine was loaded from
+static void start_inspect_replicas(handler_context &shard, session_type &session, uint64_t count,
+    const std::string &machine_directory) {
+    session.replica_log_start = session.processed_input_count;
+    for (uint64_t i = 0; i < count; ++i) {
+        session.replicas.push_back(std::make_shared<replica_type>(shard, session));
+    }
+    // A replica that fails to spawn drops itself while we iterate
+    auto replicas = session.replicas;
+    for (const auto &replica : replicas) {
+        // NOLINTNEXTLINE: cannot leak (pointer is in completion queue)
+        new_InspectReplica_handler(shard, session.id, replica, machine_directory);
+    }
+}
+
+/// \brief Lets the inspect replicas of a session catch up with an input it just processed
+/// \param shard Handler context of the session's shard
+/// \param session Session
+/// \param input Input, if the session accepted it, or nullptr if the session skipped it
+static void advance_inspect_replicas(handler_context &shard, session_type &session,
+    std::shared_ptr<const input_type> input) {
+    if (session.replicas.empty()) {
+        session.replica_log_start = session.processed_input_count;
+        return;
+    }
+    session.replica_log.push_back(replayed_input_type{std::move(input), session.current_mcycle});
+    // A failing replica may drop itself while we iterate
+    auto replicas = session.replicas;
+    for (const auto &replica : replicas) {
+        if (!replica->busy) {
+            replica->busy = true;
+            // NOLINTNEXTLINE: cannot leak (pointer is in completion queue)
+            new_InspectReplica_handler(shard, session.id, replica, {});
+        }
+    }
+}
+
+/// \brief Takes an idle inspect replica that reflects all inputs its session processed
+/// \param session Session
+/// \returns Replica, now marked as busy, or nullptr if there is none
+static std::shared_ptr<replica_type> acquire_inspect_replica(session_type &session) {
+    for (const auto &replica : session.replicas) {
+        if (!replica->busy && replica->machine.processed_input_count == session.processed_input_count) {
+            replica->busy = true;
+            return replica;
+        }
+    }
+    return nullptr;
+}
+
+/// \brief Takes the idle inspect replica of a session that reflects the most inputs, even if it lags behind
+/// \param session Session
+/// \returns Replica, now marked as busy, or nullptr if there is none
+static std::shared_ptr<replica_type> acquire_stale_inspect_replica(session_type &session) {
+    std::shared_ptr<replica_type> best;
+    for (const auto &replica : session.replicas) {
+        if (!replica->busy && (!best || replica->machine.processed_input_count > best->machine.processed_input_count)) {
+            best = replica;
+        }
+    }
+    if (best) {
+        best->busy = true;
+    }
+    return best;
+}
+
+/// \brief Returns an inspect replica taken by acquire_inspect_replica, bringing it up to date if needed, or lending
+/// it to a query waiting for a stale read
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \param replica Replica
+static void release_inspect_replica(handler_context &shard, const id_type &id,
+    const std::shared_ptr<replica_type> &replica) {
+    auto *session = find_replica_session(shard, id, replica);
+    if (session == nullptr) {
+        return;
+    }
+    if (replica->machine.processed_input_count < session->processed_input_count) {
+        // NOLINTNEXTLINE: cannot leak (pointer is in completion queue)
+        new_InspectReplica_handler(shard, id, replica, {});
+    } else if (!lend_inspect_replica(shard, *session, replica)) {
+        replica->busy = false;
+    }
+}
+
+/// \brief Hands the machine of a session over once a query or input processing is done with it
+/// \param hctx Handler context of the session's shard
+/// \param session Session
+/// \details A handler waiting to process inputs goes first, so a stream of queries cannot starve inputs.
+/// Otherwise, the query lock passes to the oldest waiting query, if any.
+static void pass_query_lock(handler_context &hctx, session_type &session) {
+    if (session.processing_waiter) {
+        session.query_lock = false;
+        enqueue_completion_queue(hctx.completion_queue.get(), session.processing_waiter);
+        session.processing_waiter = nullptr;
+        return;
+    }
+    if (!session.pending_queries.empty()) {
+        auto *q = session.pending_queries.front();
+        session.pending_queries.pop_front();
+        session.query_lock = true;
+        // A query resumed without a coroutine to resume in turn knows it holds the query lock
+        enqueue_completion_queue(hctx.completion_queue.get(), q->coroutine);
+        q->coroutine = nullptr;
+        return;
+    }
+    session.query_lock = false;
+}
+
+/// \brief Returns how long something waited for the machine of a session
+/// \param since When it started waiting
+static std::chrono::microseconds get_wait_time(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since);
+}
+
+/// \brief Records how long a query waited for the machine of a session
+/// \param session Session
+/// \param q Query about to be processed
+static void record_inspect_wait(session_type &session, const query_type &q) {
+    auto &stats = session.inspect_schedule_stats;
+    const auto wait = get_wait_time(q.arrived_at);
+    ++stats.inspect_count;
+    stats.total_inspect_wait += wait;
+    stats.max_inspect_wait = std::max(stats.max_inspect_wait, wait);
+}
+
+/// \brief Records how long an input waited before it started processing
+/// \param session Session
+/// \param i Input about to be processed
+static void record_input_lag(session_type &session, const input_type &i) {
+    auto &stats = session.inspect_schedule_stats;
+    const auto lag = get_wait_time(i.enqueued_at);
+    ++stats.input_count;
+    stats.total_input_lag += lag;
+    stats.max_input_lag = std::max(stats.max_input_lag, lag);
+}
+
+/// \brief Returns how many of the queries waiting for the machine of a session run before its next input
+/// \param session Session
+/// \param next Next input
+/// \details Only queries that are already waiting can run, so a stream of queries cannot starve inputs
+static size_t get_query_burst(session_type &session, const input_type &next) {
+    const auto &schedule = session.inspect_schedule;
+    const auto &queries = session.pending_queries;
+    switch (schedule.policy) {
+        case inspect_schedule_policy::inspect_priority:
+            // An input that waited past the latency bound goes first, and the queries run after it
+            if (schedule.max_input_latency.count() != 0 &&
+                get_wait_time(next.enqueued_at) >= schedule.max_input_latency) {
+                return 0;
+            }
+            return queries.size();
+        case inspect_schedule_policy::input_priority:
+            // Queries go on by themselves once process_pending_inputs is done
+            return 0;
+        case inspect_schedule_policy::weighted:
+            // Called once before each input, so the first call is before the first input of a run
+            if (session.inputs_since_queries < schedule.input_weight || queries.empty()) {
+                return 0;
+            }
+            session.inputs_since_queries = 0;
+            return std::min<size_t>(queries.size(), schedule.inspect_weight);
+    }
+    return 0;
+}
+
+/// \brief Lets the queries waiting for the machine of a session run, in order, before its next input
+/// \param hctx Handler context of the session's shard
+/// \param actx Context for async operations, on the handler processing inputs
+/// \param next Next input
+/// \details How many queries run, if any, depends on the session's inspect schedule
+static void process_pending_queries(handler_context &hctx, async_context &actx, const input_type &next) {
+    auto &queries = actx.session.pending_queries;
+    for (auto n = get_query_burst(actx.session, next); n > 0 && !queries.empty(); --n) {
+        auto *q = queries.front();
+        queries.pop_front();
+        // Resume its coroutine so it can process the query and complete the InspectState rpc
+        // To do so, we use an alarm to add the coroutine to the completion queue, then we yield
+        // Once the coroutine is done, it will use the same process to add us back to the completion queue
+        enqueue_completion_queue(hctx.completion_queue.get(), q->coroutine);
+        q->coroutine = actx.self;
+        actx.yield(side_effect::none);
+    }
+}
+
 /// \brief Loops processing all pending inputs
 /// \param actx Context for async operations
 /// \param e Associated epoch
@@ -2552,13 +4716,21 @@ static void process_pending_inputs(handler_context &hctx, async_context &actx, e
     }
     auto_lock processing_lock(actx.session.processing_lock, "process_pending_inputs processing lock",
         actx.request_context);
+    // If a query is using the machine, wait until it is done. Queries arriving meanwhile wait for us.
+    if (actx.session.query_lock) {
+        actx.session.processing_waiter = actx.self;
+        actx.yield(side_effect::none);
+    }
     while (!e.pending_inputs.empty()) {
+        // Let queries waiting for the machine run before the next input, as the inspect schedule says
+        process_pending_queries(hctx, actx, e.pending_inputs.front());
         auto global_input_index = actx.session.processed_input_count;
         auto epoch_input_index = e.processed_inputs.size();
         LOG_CONTEXT(debug, actx.request_context) << "  Processing input " << global_input_index;
         LOG_CONTEXT(debug, actx.request_context) << "    Epoch input index " << epoch_input_index;
         // Check size of input payload
         const auto &i = e.pending_inputs.front();
+        record_input_lag(actx.session, i);
         LOG_CONTEXT(debug, actx.request_context) << "    Creating Snapshot";
         // Wait machine server to checkin after spawned
         trigger_and_wait_checkin(hctx, actx, [](handler_context &hctx, async_context &actx) {
@@ -2651,12 +4823,12 @@ static void process_pending_inputs(handler_context &hctx, async_context &actx, e
                 // advance current mcycle and continue
                 current_mcycle = run_response.value().mcycle();
             }
-            if (e.vouchers_tree.size() != epoch_input_index) {
+            if (get_leaf_count(e.vouchers_tree) != epoch_input_index) {
                 THROW_CONTEXT((taint_session{actx.session, grpc::StatusCode::INTERNAL,
                                   "inconsistent number of entries in epoch's session vouchers Merkle tree"}),
                     actx.request_context);
             }
-            if (e.notices_tree.size() != epoch_input_index) {
+            if (get_leaf_count(e.notices_tree) != epoch_input_index) {
                 THROW_CONTEXT((taint_session{actx.session, grpc::StatusCode::INTERNAL,
                                   "inconsistent number of entries in epoch's session notices Merkle tree"}),
                     actx.request_context);
@@ -2667,14 +4839,11 @@ static void process_pending_inputs(handler_context &hctx, async_context &actx, e
         }
         // If the machine accepted the input
         if (skip_reason == completion_status::accepted) {
-            // Read proof of voucher hashes memory range in machine
+            // Add hash of voucher hashes memory range in machine to epoch
             LOG_CONTEXT(debug, actx.request_context) << "    Getting voucher hashes memory range proof";
             auto voucher_hashes_in_machine = get_proof(actx, actx.session.memory_range.voucher_hashes.start,
                 actx.session.memory_range.voucher_hashes.log2_size);
-            // Get proof of voucher hashes memory range in epoch
-            e.vouchers_tree.push_back(voucher_hashes_in_machine.get_target_hash());
-            auto voucher_hashes_in_epoch =
-                e.vouchers_tree.get_proof(epoch_input_index << LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE);
+            push_back(e.vouchers_tree, voucher_hashes_in_machine.get_target_hash());
             // Read voucher hashes memory range and count the number of non-zero hashes
             LOG_CONTEXT(debug, actx.request_context) << "    Reading voucher hashes memory range";
             auto voucher_hashes = read_memory_range(actx, actx.session.memory_range.voucher_hashes.config);
@@ -2695,17 +4864,14 @@ static void process_pending_inputs(handler_context &hctx, async_context &actx, e
                     get_proof(actx, actx.session.memory_range.voucher_hashes.start + entry_index * KECCAK_SIZE,
                         LOG2_KECCAK_SIZE)
                         .slice(hasher_type{}, static_cast<int>(actx.session.memory_range.voucher_hashes.log2_size),
-                            LOG2_KECCAK_SIZE);
+                            LOG2_KECCAK_SIZE, false);
                 vouchers[entry_index].hash = keccak_type{std::move(keccak), std::move(keccak_in_voucher_hashes)};
             }
-            // Read proof of notice hashes memory range in machine
+            // Add hash of notice hashes memory range in machine to epoch
             LOG_CONTEXT(debug, actx.request_context) << "    Getting notice hashes memory range proof";
             auto notice_hashes_in_machine = get_proof(actx, actx.session.memory_range.notice_hashes.start,
                 actx.session.memory_range.notice_hashes.log2_size);
-            // Get proof of notice hashes memory range in epoch
-            e.notices_tree.push_back(notice_hashes_in_machine.get_target_hash());
-            auto notice_hashes_in_epoch =
-                e.notices_tree.get_proof(epoch_input_index << LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE);
+            push_back(e.notices_tree, notice_hashes_in_machine.get_target_hash());
             // Read notice hashes memory range count the number of non-zero hashes
             LOG_CONTEXT(debug, actx.request_context) << "    Reading notice hashes memory range";
             auto notice_hashes = read_memory_range(actx, actx.session.memory_range.notice_hashes.config);
@@ -2726,22 +4892,47 @@ static void process_pending_inputs(handler_context &hctx, async_context &actx, e
                     get_proof(actx, actx.session.memory_range.notice_hashes.start + entry_index * KECCAK_SIZE,
                         LOG2_KECCAK_SIZE)
                         .slice(hasher_type{}, static_cast<int>(actx.session.memory_range.notice_hashes.log2_size),
-                            LOG2_KECCAK_SIZE);
+                            LOG2_KECCAK_SIZE, false);
                 notices[entry_index].hash = keccak_type{std::move(keccak), std::move(keccak_in_notice_hashes)};
             }
+            // Check all sliced proofs of the input at once
+            if (hctx.proof_self_check) {
+                cartesi::batch_proof_verifier<hash_type> verifier;
+                for (const auto &v : vouchers) {
+                    verifier.add(v.hash.value().keccak_in_hashes);
+                }
+                for (const auto &n : notices) {
+                    verifier.add(n.hash.value().keccak_in_hashes);
+                }
+                bool valid = false;
+                // The proofs are local to this handler, so many of them can be verified in the worker pool
+                if (verifier.size() >= MIN_POOL_WORK_ITEMS) {
+                    await_on_pool(hctx, actx.self, actx.yield, [&]() { valid = verifier.verify(hasher_type{}); });
+                } else {
+                    valid = verifier.verify(hasher_type{});
+                }
+                if (!valid) {
+                    THROW_CONTEXT((taint_session{actx.session, grpc::StatusCode::INTERNAL,
+                                      "produced invalid sliced proof"}),
+                        actx.request_context);
+                }
+                LOG_CONTEXT(debug, actx.request_context)
+                    << "    Verified " << verifier.size() << " sliced proofs with " << verifier.get_hash_count()
+                    << " hashes (" << verifier.get_shared_hash_count() << " shared)";
+            }
             // Update most recent machine hash in epoch
             e.most_recent_machine_hash = get_root_hash(actx);
-            // Add input results to list of processed inputs
-            e.processed_inputs.push_back(
-                processed_input_type{global_input_index, epoch_input_index, e.most_recent_machine_hash,
-                    std::move(voucher_hashes_in_epoch), std::move(notice_hashes_in_epoch), skip_reason,
+            // Add input results to list of processed inputs, without spare capacity
+            vouchers.shrink_to_fit();
+            notices.shrink_to_fit();
+            reports.shrink_to_fit();
+            e.processed_inputs.push_back(seal_processed_input(
+                processed_input_type{global_input_index, epoch_input_index, e.most_recent_machine_hash, skip_reason,
                     accepted_data_type{
-                        std::move(voucher_hashes_in_machine),
                         std::move(vouchers),
-                        std::move(notice_hashes_in_machine),
                         std::move(notices),
                     },
-                    std::move(reports)});
+                    std::move(reports), {}}));
             // Advance session.current_mcycle
             actx.session.current_mcycle = current_mcycle;
             LOG_CONTEXT(debug, actx.request_context) << "  Done processing input " << global_input_index;
@@ -2756,14 +4947,8 @@ static void process_pending_inputs(handler_context &hctx, async_context &actx, e
             // Add null hashes to the epoch Merkle trees
             hash_type zero;
             std::fill_n(zero.begin(), zero.size(), 0);
-            // Get proof of null hash in epoch's vouchers metadata memory range Merkle tree
-            e.vouchers_tree.push_back(zero);
-            auto voucher_hashes_in_epoch =
-                e.vouchers_tree.get_proof(epoch_input_index << LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE);
-            // Get proof of null hash in epoch's notices metadata memory range Merkle tree
-            e.notices_tree.push_back(zero);
-            auto notice_hashes_in_epoch =
-                e.notices_tree.get_proof(epoch_input_index << LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE);
+            push_back(e.vouchers_tree, zero);
+            push_back(e.notices_tree, zero);
             // Check the machine hash has not changed
             if (e.most_recent_machine_hash != get_root_hash(actx)) {
                 THROW_CONTEXT(
@@ -2771,55 +4956,291 @@ static void process_pending_inputs(handler_context &hctx, async_context &actx, e
                     actx.request_context);
             }
             // Add skipped input to list of processed inputs
-            e.processed_inputs.push_back(processed_input_type{global_input_index, epoch_input_index,
-                e.most_recent_machine_hash, std::move(voucher_hashes_in_epoch), std::move(notice_hashes_in_epoch),
-                skip_reason, std::move(exception_data), std::move(reports)});
+            reports.shrink_to_fit();
+            e.processed_inputs.push_back(seal_processed_input(processed_input_type{global_input_index,
+                epoch_input_index, e.most_recent_machine_hash, skip_reason, std::move(exception_data),
+                std::move(reports), {}}));
             // Leave session.current_mcycle alone
         }
+        LOG_CONTEXT(debug, actx.request_context)
+            << "    Processed input footprint " << get_footprint(*e.processed_inputs.back()) << " bytes";
         // Increment session's processed input count
         actx.session.processed_input_count++;
+        // Let inspect replicas replay the input, if it was accepted
+        advance_inspect_replicas(hctx, actx.session,
+            !actx.session.replicas.empty() && skip_reason == completion_status::accepted ?
+                std::make_shared<const input_type>(std::move(e.pending_inputs.front())) :
+                nullptr);
         // Finally remove pending
         e.pending_inputs.pop_front();
-        // Check if there is a pending query
-        if (e.pending_query.has_value()) {
-            // Resume its coroutine so it can process the query and complete the InspectState rpc
-            // To do so, we use an alarm to add the coroutine to the completion queue, then we yield
-            // Once the coroutine is done, it will use the same process to add us back to the completion queue
-            enqueue_completion_queue(hctx.completion_queue.get(), e.pending_query.value().coroutine);
-            e.pending_query.value().coroutine = actx.self;
-            actx.yield(side_effect::none);
-        }
+        // Read RPCs will take a new snapshot that includes the input
+        e.snapshot.reset();
+        wake_epoch_watchers(hctx, e);
+        ++actx.session.inputs_since_queries;
+    }
+    // Queries still waiting go on by themselves
+    pass_query_lock(hctx, actx.session);
+}
+
+/// \brief Returns the active epoch of a session that is about to receive inputs
+/// \param session Locked session
+/// \param active_epoch_index Active epoch index expected by the caller
+/// \param request_context Context of the RPC carrying the inputs
+/// \returns Active epoch
+static epoch_type &get_advance_state_epoch(session_type &session, uint64_t active_epoch_index,
+    const grpc::ServerContext &request_context) {
+    // If active epoch does not match expected, bail out
+    if (session.active_epoch_index != active_epoch_index) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                          "incorrect active epoch index (expected " + std::to_string(session.active_epoch_index) +
+                              ", got " + std::to_string(active_epoch_index) + ")"}),
+            request_context);
+    }
+    // We should be able to find the active epoch, otherwise bail
+    auto &epochs = session.epochs;
+    if (epochs.find(session.active_epoch_index) == epochs.end()) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INTERNAL, "active epoch not found"}),
+            request_context);
+    }
+    auto &e = epochs[session.active_epoch_index];
+    // If epoch is finished, bail out
+    if (e.state != epoch_state::active) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch is finished"}),
+            request_context);
+    }
+    return e;
+}
+
+/// \brief Checks the input in an AdvanceStateRequest
+/// \param session Locked session
+/// \param request AdvanceStateRequest
+/// \param current_input_index Index the input must have
+/// \param request_context Context of the RPC carrying the request
+/// \returns Metadata of input
+static input_metadata_type check_advance_state_request(const session_type &session,
+    const AdvanceStateRequest &request, uint64_t current_input_index, const grpc::ServerContext &request_context) {
+    // If current input does not match expected, bail out
+    if (current_input_index != request.current_input_index()) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                          "incorrect current input index (expected " + std::to_string(session.processed_input_count) +
+                              ", got " + std::to_string(request.current_input_index()) + ")"}),
+            request_context);
+    }
+    // Check input metadata
+    if (!request.has_input_metadata()) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "missing input metadata"}),
+            request_context);
+    }
+    if (!request.input_metadata().has_msg_sender()) {
+        THROW_CONTEXT(
+            (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "missing input metadata msg_sender"}),
+            request_context);
+    }
+    if (request.input_metadata().msg_sender().data().size() != EVM_ADDRESS_LENGTH) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                          "invalid input metadata msg_sender length (expected " + std::to_string(EVM_ADDRESS_LENGTH) +
+                              " bytes, got " + std::to_string(request.input_metadata().msg_sender().data().size()) +
+                              " bytes)"}),
+            request_context);
     }
+    auto input_metadata = get_proto_input_metadata(request.input_metadata());
+    // Double-check that epoch index and input index are correct
+    if (input_metadata.epoch_index != 0) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                          "input metadata epoch index is deprecated. Should always be 0 received (" +
+                              std::to_string(input_metadata.epoch_index) + ")"}),
+            request_context);
+    }
+    if (input_metadata.input_index != current_input_index) {
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                          "input metadata input index (" + std::to_string(input_metadata.input_index) +
+                              ") is inconsistent with current input index (" + std::to_string(current_input_index) +
+                              ")"}),
+            request_context);
+    }
+    return input_metadata;
 }
 
 /// \brief Creates a new handler for the AdvanceState RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_AdvanceState_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::advance_state);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         AdvanceStateRequest advance_state_request;
         ServerAsyncResponseWriter<Void> advance_state_writer(&request_context);
         auto *cq = hctx.completion_queue.get();
         // Wait for a AdvanceState RPC
-        hctx.manager_async_service.RequestAdvanceState(&request_context, &advance_state_request, &advance_state_writer,
-            cq, cq, self);
+        hctx.server->manager_async_service.RequestAdvanceState(&request_context, &advance_state_request,
+            &advance_state_writer, cq, cq, self);
         yield(side_effect::none);
         // We now received a AdvanceState
         // We will handle other AdvanceState rpcs if we yield, but not in the same session, due to the session lock
-        new_AdvanceState_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        replace_handler(hctx, handler_kind::advance_state, new_AdvanceState_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received AdvanceState RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, advance_state_request.session_id(), self, yield);
+        try {
+            // Check if session id exists
+            auto &sessions = shard.sessions; // NOLINT: Unknown. Maybe linter bug?
+            const auto &id = advance_state_request.session_id();
+            LOG_CONTEXT(info, request_context) << "Received AdvanceState for session " << id << " epoch "
+                                               << advance_state_request.active_epoch_index();
+            // If a session is unknown, a bail out
+            if (sessions.find(id) == sessions.end()) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found!"}),
+                    request_context);
+            }
+            // Otherwise, get session and lock until we exit handler
+            auto &session = sessions[id];
+            // If active_epoch_index is too large, bail
+            if (session.active_epoch_index == UINT64_MAX) {
+                THROW_CONTEXT(
+                    (finish_error_yield_none{grpc::StatusCode::OUT_OF_RANGE, "active epoch index will overflow"}),
+                    request_context);
+            }
+            // If session is already locked, bail out
+            auto new_lock_reason = get_session_lock_reason("AdvanceState", request_context.peer());
+            if (session.session_lock) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
+                                  "concurrent call in session (already locked by " + session.session_lock_reason +
+                                      " when attempted lock by " + new_lock_reason + ")"}),
+                    request_context);
+            }
+            // Lock session so other rpcs to the same session are rejected
+            auto_lock session_lock(session.session_lock, "AdvanceState session lock", request_context);
+            session.session_lock_reason = new_lock_reason;
+            // If session is tainted, report potential data loss
+            if (session.tainted) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::DATA_LOSS,
+                                  "session was previously tainted ("s + session.taint_status.error_message() + ")"}),
+                    request_context);
+            }
+            auto &e = get_advance_state_epoch(session, advance_state_request.active_epoch_index(), request_context);
+            // Check input against the current input index
+            auto current_input_index = e.pending_inputs.size() + session.processed_input_count;
+            auto input_metadata =
+                check_advance_state_request(session, advance_state_request, current_input_index, request_context);
+            // Enqueue input
+            e.pending_inputs.emplace_back(input_metadata, advance_state_request.input_payload());
+            // Tell caller RPC succeeded
+            Void advance_state_response;
+            advance_state_writer.Finish(advance_state_response, grpc::Status::OK, self);
+            yield(side_effect::none); // Here the session is still locked, so no concurrent calls are possible
+            // Release the lock so other RPCs can enqueue additional inputs to the same session/epoch or call inspect
+            // state
+            session_lock.release();
+            // Between unlocking the session and the check here, there is no
+            // yield, and so no other AdvanceState RPC can be in flight for
+            // the same session. This means that the handler entering the
+            // branch will be exactly the handler that enqueued the input that
+            // caused the pending_inputs queue to not be empty anymore. While
+            // working on this single input, the handler can yield (because
+            // it talks to the machine server asynchronously) and allow
+            // other AdvanceState RPCs to grow the pending_inputs queue further.
+            // However, those other RPCs will not enter the branch, because
+            // process_pending_inputs only removes an item from the queue when
+            // it is completely done with it. Between removing the pending
+            // input and checking if there are other pending inputs, the
+            // handler does not yield. Therefore, it will process all
+            // pending inputs that have been enqueue while it is working.
+            //??D Victor and Diego both think this logic is sound but is too complicated.
+            //??D Any better ideas?
+            if (e.pending_inputs.size() == 1) {
+                async_context actx{session, request_context, shard.completion_queue.get(), self, yield};
+                // While inputs are processed, a query might have arrived. If everything works, its coroutine will be
+                // waiting to be resumed between inputs, so the query can be processed. However, if
+                // process_pending_inputs exits via an exception, that coroutine might never be called. It would
+                // eventually timeout. So we resume it in the exception handlers below.
+                //??D Looks Ugly to repeat the code in each handler, but I couldn't find a more elegant solution
+                process_pending_inputs(shard, actx, e);
+            }
+        } catch (finish_error_yield_none &e) {
+            LOG_CONTEXT(error, request_context)
+                << "Caught finish_error_yield_none '" << e.status().error_message() << '\'';
+            advance_state_writer.FinishWithError(e.status(), self);
+            yield(side_effect::none);
+        } catch (taint_session &x) {
+            LOG_CONTEXT(error, request_context) << "Caught taint_status " << x.status().error_message();
+            auto &session = x.session();
+            set_session_taint(shard, session, x.status());
+            // Let waiting queries fail with the taint, unless some other handler is still using the machine
+            if (!session.processing_lock && !session.query_lock) {
+                pass_query_lock(shard, session);
+            }
+            // No need to return rpc results because we already have if we reach here
+        } catch (std::exception &x) {
+            LOG_CONTEXT(error, request_context) << "Caught unexpected exception " << x.what();
+            const auto &id = advance_state_request.session_id();
+            if (shard.sessions.find(id) != shard.sessions.end()) {
+                auto &session = shard.sessions[id];
+                set_session_taint(shard, session,
+                    grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + x.what()});
+                // Let waiting queries fail with the taint, unless some other handler is still using the machine
+                if (!session.processing_lock && !session.query_lock) {
+                    pass_query_lock(shard, session);
+                }
+            }
+            // No need to return rpc results because we already have if we reach here
+        }
+    }};
+    return self;
+}
+
+/// \brief Creates a new handler for the AdvanceStateBatch RPC and starts accepting requests
+/// \param hctx Handler context shared between all handlers
+/// \details Inputs streamed by the client are checked and enqueued together, under a single session lock, once the
+/// client closes the stream. If any input is rejected, none is enqueued.
+static handler_type::pull_type *new_AdvanceStateBatch_handler(handler_context &hctx) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::advance_state_batch);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
+        using namespace grpc;
+        ServerContext request_context;
+        ServerAsyncReader<Void, AdvanceStateRequest> reader(&request_context);
+        auto *cq = hctx.completion_queue.get();
+        // Wait for a AdvanceStateBatch RPC
+        hctx.server->manager_async_service.RequestAdvanceStateBatch(&request_context, &reader, cq, cq, self);
+        yield(side_effect::none);
+        replace_handler(hctx, handler_kind::advance_state_batch, new_AdvanceStateBatch_handler);
+        // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
+        if (!hctx.ok) {
+            LOG_CONTEXT(error, request_context)
+                << "Received AdvanceStateBatch RPC with handle_context ok set to false";
+            return;
+        }
+        // Read the whole stream before entering the session's shard. Here, the completion queue tells us when the
+        // client closes the stream. Completions forwarded to other shards do not carry that information.
+        std::vector<AdvanceStateRequest> requests;
+        for (;;) {
+            auto &request = requests.emplace_back();
+            reader.Read(&request, self);
+            yield(side_effect::none);
+            if (!hctx.ok) {
+                requests.pop_back();
+                break;
+            }
+        }
+        if (requests.empty()) {
+            LOG_CONTEXT(error, request_context) << "Received AdvanceStateBatch without inputs";
+            reader.FinishWithError(grpc::Status{grpc::StatusCode::INVALID_ARGUMENT, "no inputs in batch"}, self);
+            yield(side_effect::none);
+            return;
+        }
+        const auto id = requests.front().session_id();
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, id, self, yield);
         try {
-            // Check if session id exists
-            auto &sessions = hctx.sessions; // NOLINT: Unknown. Maybe linter bug?
-            const auto &id = advance_state_request.session_id();
-            LOG_CONTEXT(info, request_context) << "Received AdvanceState for session " << id << " epoch "
-                                               << advance_state_request.active_epoch_index();
+            auto &sessions = shard.sessions;
+            LOG_CONTEXT(info, request_context) << "Received AdvanceStateBatch with " << requests.size()
+                                               << " inputs for session " << id << " epoch "
+                                               << requests.front().active_epoch_index();
             // If a session is unknown, a bail out
             if (sessions.find(id) == sessions.end()) {
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found!"}),
@@ -2834,7 +5255,7 @@ static handler_type::pull_type *new_AdvanceState_handler(handler_context &hctx)
                     request_context);
             }
             // If session is already locked, bail out
-            auto new_lock_reason = get_session_lock_reason("AdvanceState", request_context.peer());
+            auto new_lock_reason = get_session_lock_reason("AdvanceStateBatch", request_context.peer());
             if (session.session_lock) {
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
                                   "concurrent call in session (already locked by " + session.session_lock_reason +
@@ -2842,7 +5263,7 @@ static handler_type::pull_type *new_AdvanceState_handler(handler_context &hctx)
                     request_context);
             }
             // Lock session so other rpcs to the same session are rejected
-            auto_lock session_lock(session.session_lock, "AdvanceState session lock", request_context);
+            auto_lock session_lock(session.session_lock, "AdvanceStateBatch session lock", request_context);
             session.session_lock_reason = new_lock_reason;
             // If session is tainted, report potential data loss
             if (session.tainted) {
@@ -2850,141 +5271,62 @@ static handler_type::pull_type *new_AdvanceState_handler(handler_context &hctx)
                                   "session was previously tainted ("s + session.taint_status.error_message() + ")"}),
                     request_context);
             }
-            // If active epoch does not match expected, bail out
-            if (session.active_epoch_index != advance_state_request.active_epoch_index()) {
-                THROW_CONTEXT(
-                    (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
-                        "incorrect active epoch index (expected " + std::to_string(session.active_epoch_index) +
-                            ", got " + std::to_string(advance_state_request.active_epoch_index()) + ")"}),
-                    request_context);
-            }
-            // We should be able to find the active epoch, otherwise bail
-            auto &epochs = session.epochs;
-            if (epochs.find(session.active_epoch_index) == epochs.end()) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INTERNAL, "active epoch not found"}),
-                    request_context);
-            }
-            auto &e = epochs[session.active_epoch_index];
-            // If epoch is finished, bail out
-            if (e.state != epoch_state::active) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "epoch is finished"}),
-                    request_context);
-            }
-            // If current input does not match expected, bail out
-            auto current_input_index = e.pending_inputs.size() + session.processed_input_count;
-            if (current_input_index != advance_state_request.current_input_index()) {
-                THROW_CONTEXT(
-                    (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
-                        "incorrect current input index (expected " + std::to_string(session.processed_input_count) +
-                            ", got " + std::to_string(advance_state_request.current_input_index()) + ")"}),
-                    request_context);
-            }
-            // Check input metadata
-            if (!advance_state_request.has_input_metadata()) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "missing input metadata"}),
-                    request_context);
-            }
-            if (!advance_state_request.input_metadata().has_msg_sender()) {
-                THROW_CONTEXT(
-                    (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "missing input metadata msg_sender"}),
-                    request_context);
-            }
-            if (advance_state_request.input_metadata().msg_sender().data().size() != EVM_ADDRESS_LENGTH) {
-                THROW_CONTEXT(
-                    (finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
-                        "invalid input metadata msg_sender length (expected " + std::to_string(EVM_ADDRESS_LENGTH) +
-                            " bytes, got " +
-                            std::to_string(advance_state_request.input_metadata().msg_sender().data().size()) +
-                            " bytes)"}),
-                    request_context);
-            }
-            auto input_metadata = get_proto_input_metadata(advance_state_request.input_metadata());
-            // Double-check that epoch index and input index are correct
-            if (input_metadata.epoch_index != 0) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
-                                  "input metadata epoch index is deprecated. Should always be 0 received (" +
-                                      std::to_string(input_metadata.epoch_index) + ")"}),
-                    request_context);
-            }
-            if (input_metadata.input_index != current_input_index) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
-                                  "input metadata input index (" + std::to_string(input_metadata.input_index) +
-                                      ") is inconsistent with current input index (" +
-                                      std::to_string(current_input_index) + ")"}),
+            // Check each input as AdvanceState would, as if all previous inputs in the batch had been enqueued
+            std::vector<input_type> inputs;
+            inputs.reserve(requests.size());
+            for (const auto &request : requests) {
+                if (request.session_id() != id) {
+                    THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
+                                      "inconsistent session id in batch"}),
+                        request_context);
+                }
+                auto &e = get_advance_state_epoch(session, request.active_epoch_index(), request_context);
+                auto current_input_index = e.pending_inputs.size() + session.processed_input_count + inputs.size();
+                auto input_metadata = check_advance_state_request(session, request, current_input_index,
                     request_context);
+                inputs.emplace_back(input_metadata, request.input_payload());
             }
-            // Enqueue input
-            e.pending_inputs.emplace_back(input_metadata, advance_state_request.input_payload());
+            requests = std::vector<AdvanceStateRequest>{};
+            // Enqueue inputs
+            auto &e = session.epochs[session.active_epoch_index];
+            const bool processing = !e.pending_inputs.empty();
+            e.pending_inputs.insert(e.pending_inputs.end(), std::make_move_iterator(inputs.begin()),
+                std::make_move_iterator(inputs.end()));
+            inputs = std::vector<input_type>{};
             // Tell caller RPC succeeded
-            Void advance_state_response;
-            advance_state_writer.Finish(advance_state_response, grpc::Status::OK, self);
+            Void response;
+            reader.Finish(response, grpc::Status::OK, self);
             yield(side_effect::none); // Here the session is still locked, so no concurrent calls are possible
-            // Release the lock so other RPCs can enqueue additional inputs to the same session/epoch or call inspect
-            // state
             session_lock.release();
-            // Between unlocking the session and the check here, there is no
-            // yield, and so no other AdvanceState RPC can be in flight for
-            // the same session. This means that the handler entering the
-            // branch will be exactly the handler that enqueued the input that
-            // caused the pending_inputs queue to not be empty anymore. While
-            // working on this single input, the handler can yield (because
-            // it talks to the machine server asynchronously) and allow
-            // other AdvanceState RPCs to grow the pending_inputs queue further.
-            // However, those other RPCs will not enter the branch, because
-            // process_pending_inputs only removes an item from the queue when
-            // it is completely done with it. Between removing the pending
-            // input and checking if there are other pending inputs, the
-            // handler does not yield. Therefore, it will process all
-            // pending inputs that have been enqueue while it is working.
-            //??D Victor and Diego both think this logic is sound but is too complicated.
-            //??D Any better ideas?
-            if (e.pending_inputs.size() == 1) {
-                async_context actx{session, request_context, hctx.completion_queue.get(), self, yield};
-                // While inputs are processed, a query might have arrived. If everything works, its coroutine will be
-                // waiting to be resumed between inputs, so the query can be processed. However, if
-                // process_pending_inputs exits via an exception, that coroutine might never be called. It would
-                // eventually timeout. So we resume it in the exception handlers below.
-                //??D Looks Ugly to repeat the code in each handler, but I couldn't find a more elegant solution
-                process_pending_inputs(hctx, actx, e);
+            // As in AdvanceState, whoever enqueues into an empty queue processes it. Inputs may have been processed
+            // while we yielded, so the queue length cannot tell if that was us.
+            if (!processing) {
+                async_context actx{session, request_context, shard.completion_queue.get(), self, yield};
+                process_pending_inputs(shard, actx, e);
             }
         } catch (finish_error_yield_none &e) {
             LOG_CONTEXT(error, request_context)
                 << "Caught finish_error_yield_none '" << e.status().error_message() << '\'';
-            advance_state_writer.FinishWithError(e.status(), self);
+            reader.FinishWithError(e.status(), self);
             yield(side_effect::none);
         } catch (taint_session &x) {
             LOG_CONTEXT(error, request_context) << "Caught taint_status " << x.status().error_message();
             auto &session = x.session();
-            session.tainted = true;
-            session.taint_status = x.status();
-            auto &e = session.epochs[session.active_epoch_index];
-            // Check if there is a pending query
-            if (e.pending_query.has_value()) {
-                // Resume its coroutine so it can process the query and complete the InspectState rpc
-                // To do so, we use an alarm to add the coroutine to the completion queue, then we yield
-                // Once the coroutine is done, it will use the same process to add us back to the completion queue
-                enqueue_completion_queue(hctx.completion_queue.get(), e.pending_query.value().coroutine);
-                e.pending_query.value().coroutine = self;
-                yield(side_effect::none);
+            set_session_taint(shard, session, x.status());
+            // Let waiting queries fail with the taint, unless some other handler is still using the machine
+            if (!session.processing_lock && !session.query_lock) {
+                pass_query_lock(shard, session);
             }
             // No need to return rpc results because we already have if we reach here
         } catch (std::exception &x) {
             LOG_CONTEXT(error, request_context) << "Caught unexpected exception " << x.what();
-            const auto &id = advance_state_request.session_id();
-            if (hctx.sessions.find(id) != hctx.sessions.end()) {
-                auto &session = hctx.sessions[id];
-                session.tainted = true;
-                session.taint_status =
-                    grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + x.what()};
-                auto &e = session.epochs[session.active_epoch_index];
-                // Check if there is a pending query
-                if (e.pending_query.has_value()) {
-                    // Resume its coroutine so it can process the query and complete the InspectState rpc
-                    // To do so, we use an alarm to add the coroutine to the completion queue, then we yield
-                    // Once the coroutine is done, it will use the same process to add us back to the completion queue
-                    enqueue_completion_queue(hctx.completion_queue.get(), e.pending_query.value().coroutine);
-                    e.pending_query.value().coroutine = self;
-                    yield(side_effect::none);
+            if (shard.sessions.find(id) != shard.sessions.end()) {
+                auto &session = shard.sessions[id];
+                set_session_taint(shard, session,
+                    grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + x.what()});
+                // Let waiting queries fail with the taint, unless some other handler is still using the machine
+                if (!session.processing_lock && !session.query_lock) {
+                    pass_query_lock(shard, session);
                 }
             }
             // No need to return rpc results because we already have if we reach here
@@ -2993,54 +5335,169 @@ static handler_type::pull_type *new_AdvanceState_handler(handler_context &hctx)
     return self;
 }
 
-class auto_resume final {
+/// \brief Hands the machine back when a query is done with it
+class query_turn final {
 public:
-    explicit auto_resume(grpc::ServerCompletionQueue *cq) : m_cq(cq), m_coroutine(nullptr) {}
-    void reset(handler_type::pull_type *coroutine = nullptr) {
-        m_coroutine = coroutine;
-    }
-
-    auto_resume(const auto_resume &other) = delete;
-    auto_resume(auto_resume &&other) = delete;
-    auto_resume &operator=(const auto_resume &other) = delete;
-    auto_resume &operator=(auto_resume &&other) = delete;
-
-    ~auto_resume() {
+    /// \brief Constructor
+    /// \param hctx Handler context of the session's shard
+    /// \param session Session
+    /// \param coroutine Handler processing inputs that let the query run, or nullptr if the query holds query_lock
+    query_turn(handler_context &hctx, session_type &session, handler_type::pull_type *coroutine) :
+        m_hctx(hctx),
+        m_session(session),
+        m_coroutine(coroutine) {}
+
+    query_turn(const query_turn &other) = delete;
+    query_turn(query_turn &&other) = delete;
+    query_turn &operator=(const query_turn &other) = delete;
+    query_turn &operator=(query_turn &&other) = delete;
+
+    /// \brief Destructor resumes the handler processing inputs, or passes query_lock on
+    ~query_turn() {
         if (m_coroutine) {
-            enqueue_completion_queue(m_cq, m_coroutine);
+            enqueue_completion_queue(m_hctx.completion_queue.get(), m_coroutine);
+        } else {
+            pass_query_lock(m_hctx, m_session);
         }
     }
 
 private:
-    grpc::ServerCompletionQueue *m_cq;
+    handler_context &m_hctx;
+    session_type &m_session;
     handler_type::pull_type *m_coroutine;
 };
 
+/// \brief Copies the results of a processed query to an InspectStateResponse
+/// \param q Processed query
+/// \param response Response receiving processed input count, reports, status, and exception data
+static void set_proto_inspect_state_response(const query_type &q, InspectStateResponse &response) {
+    response.set_processed_input_count(q.processed_input_count);
+    for (const auto &r : q.reports) {
+        response.add_reports()->set_payload(r.payload);
+    }
+    switch (q.status) {
+        case completion_status::accepted:
+            response.set_status(CompletionStatus::ACCEPTED);
+            break;
+        case completion_status::rejected:
+            response.set_status(CompletionStatus::REJECTED);
+            break;
+        case completion_status::exception:
+            response.set_status(CompletionStatus::EXCEPTION);
+            if (q.exception_data.has_value()) {
+                response.set_exception_data(q.exception_data.value());
+            }
+            break;
+        case completion_status::machine_halted:
+            response.set_status(CompletionStatus::MACHINE_HALTED);
+            break;
+        case completion_status::cycle_limit_exceeded:
+            response.set_status(CompletionStatus::CYCLE_LIMIT_EXCEEDED);
+            break;
+        case completion_status::time_limit_exceeded:
+            response.set_status(CompletionStatus::TIME_LIMIT_EXCEEDED);
+            break;
+        case completion_status::payload_length_limit_exceeded:
+            response.set_status(CompletionStatus::PAYLOAD_LENGTH_LIMIT_EXCEEDED);
+            break;
+    }
+}
+
+/// \brief Returns the key of a query in the inspect cache
+/// \param session Session
+/// \param query_payload Query payload
+/// \returns Key for the current machine state of the session, or nothing if it has no active epoch
+static std::optional<inspect_cache_key_type> get_inspect_cache_key(const session_type &session,
+    const std::string &query_payload) {
+    auto it = session.epochs.find(session.active_epoch_index);
+    if (it == session.epochs.end()) {
+        return std::nullopt;
+    }
+    hasher_type h;
+    hash_type query_hash;
+    h.begin();
+    h.add_data(reinterpret_cast<const unsigned char *>(query_payload.data()), query_payload.size());
+    h.end(query_hash);
+    return inspect_cache_key_type{session.id, it->second.most_recent_machine_hash, query_hash};
+}
+
+/// \brief Caches the response to a query
+/// \param shard Handler context of the session's shard
+/// \param key Key of query, taken before the query was processed
+/// \param q Processed query
+/// \param response Response to query
+/// \details Queries that ran out of time are not cached, since they could complete if retried
+static void insert_inspect_cache(handler_context &shard, const std::optional<inspect_cache_key_type> &key,
+    const query_type &q, const InspectStateResponse &response) {
+    if (!key.has_value() || q.status == completion_status::time_limit_exceeded) {
+        return;
+    }
+    const size_t cost = response.ByteSizeLong() + sizeof(inspect_cache_key_type) + std::get<0>(key.value()).size();
+    shard.inspect_cache.insert(key.value(), response, cost);
+}
+
+/// \brief Processes a query on an inspect replica taken by acquire_inspect_replica, acquire_stale_inspect_replica, or
+/// lent by lend_inspect_replica, then releases the replica
+/// \param shard Handler context of the session's shard
+/// \param id Session id
+/// \param replica Replica
+/// \param q Query
+/// \param request_context Context of the InspectState RPC
+/// \param self Handler coroutine
+/// \param yield Handler yield object
+/// \details A replica that fails, for whatever reason, is dropped and the query fails with UNAVAILABLE. The session is
+/// not tainted.
+static void process_query_on_replica(handler_context &shard, const id_type &id,
+    const std::shared_ptr<replica_type> &replica, query_type &q, const grpc::ServerContext &request_context,
+    handler_type::pull_type *self, handler_type::push_type &yield) {
+    async_context actx{replica->machine, request_context, shard.completion_queue.get(), self, yield};
+    std::optional<std::string> failure;
+    try {
+        process_query(shard, actx, q);
+    } catch (taint_session &e) {
+        failure = e.status().error_message();
+    } catch (handler_exception &e) {
+        failure = e.status().error_message();
+    } catch (std::exception &e) {
+        failure = std::string{"unexpected exception "} + e.what();
+    }
+    if (failure.has_value()) {
+        drop_inspect_replica(shard, id, replica, failure.value());
+        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::UNAVAILABLE,
+                          "inspect replica failed (" + failure.value() + ")"}),
+            request_context);
+    }
+    release_inspect_replica(shard, id, replica);
+}
+
 /// \brief Creates a new handler for the InspectState RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_InspectState_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::inspect_state);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         ServerContext request_context;
         InspectStateRequest inspect_state_request;
         ServerAsyncResponseWriter<InspectStateResponse> inspect_state_writer(&request_context);
         auto *cq = hctx.completion_queue.get();
         // Wait for a InspectState RPC
-        hctx.manager_async_service.RequestInspectState(&request_context, &inspect_state_request, &inspect_state_writer,
-            cq, cq, self);
+        hctx.server->manager_async_service.RequestInspectState(&request_context, &inspect_state_request,
+            &inspect_state_writer, cq, cq, self);
         yield(side_effect::none);
         // We now received a InspectState
-        // We will handle other InspectState rpcs if we yield, but not in the same session, due to the session lock
-        new_InspectState_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        // We will handle other InspectState rpcs if we yield, and those in the same session wait for their turn
+        replace_handler(hctx, handler_kind::inspect_state, new_InspectState_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received InspectState RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session
+        auto &shard = enter_session_shard(hctx, inspect_state_request.session_id(), self, yield);
         try {
             // Check if session id exists
-            auto &sessions = hctx.sessions; // NOLINT: Unknown. Maybe linter bug?
+            auto &sessions = shard.sessions; // NOLINT: Unknown. Maybe linter bug?
             const auto &id = inspect_state_request.session_id();
             LOG_CONTEXT(info, request_context) << "Received InspectState for session " << id;
             // If a session is unknown, a bail out
@@ -3048,19 +5505,80 @@ static handler_type::pull_type *new_InspectState_handler(handler_context &hctx)
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT, "session id not found!"}),
                     request_context);
             }
-            // Otherwise, get session and lock until we exit handler
+            // Otherwise, get session
             auto &session = sessions[id];
-            // If session is already locked, bail out
-            auto new_lock_reason = get_session_lock_reason("InspectState", request_context.peer());
-            if (session.session_lock) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
-                                  "concurrent call in session (already locked by " + session.session_lock_reason +
-                                      " when attempted lock by " + new_lock_reason + ")"}),
-                    request_context);
+            // An idle inspect replica serves the query without locking the session, in parallel with other RPCs
+            // A query already answered in the current machine state is served from the cache, without the machine.
+            // Skipped inputs do not change the machine state, so only the processed input count needs updating.
+            std::optional<inspect_cache_key_type> cache_key;
+            if (!session.tainted && shard.inspect_cache.get_capacity() > 0) {
+                cache_key = get_inspect_cache_key(session, inspect_state_request.query_payload());
+                if (const auto *cached = cache_key ? shard.inspect_cache.find(cache_key.value()) : nullptr) {
+                    LOG_CONTEXT(debug, request_context) << "  Found result in cache";
+                    ++session.inspect_cache_hit_count;
+                    InspectStateResponse inspect_state_response = *cached;
+                    inspect_state_response.set_active_epoch_index(session.active_epoch_index);
+                    inspect_state_response.set_processed_input_count(session.processed_input_count);
+                    inspect_state_writer.Finish(inspect_state_response, grpc::Status::OK, self);
+                    yield(side_effect::none);
+                    return;
+                }
+            }
+            // A query accepting a stale read never waits for the input backlog. It runs on the idle inspect replica
+            // that reflects the most inputs, even if it lags behind, or on the first replica to finish replaying an
+            // input.
+            // Without replicas, it waits for the machine like any other query.
+            if (inspect_state_request.allow_stale_read() && !session.tainted && !session.replicas.empty()) {
+                InspectStateResponse inspect_state_response;
+                inspect_state_response.set_session_id(id);
+                inspect_state_response.set_active_epoch_index(session.active_epoch_index);
+                // Queries already waiting for a replica go first
+                auto replica = session.stale_waiters.empty() ? acquire_stale_inspect_replica(session) : nullptr;
+                const bool current =
+                    replica && replica->machine.processed_input_count == session.processed_input_count;
+                if (!replica) {
+                    if (session.stale_waiters.size() >= shard.inspect_queue_depth) {
+                        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                          "too many queries waiting for inspect replicas in session (" +
+                                              std::to_string(session.stale_waiters.size()) + ")"}),
+                            request_context);
+                    }
+                    stale_query_waiter_type waiter{self, nullptr};
+                    session.stale_waiters.push_back(&waiter);
+                    yield(side_effect::none);
+                    // From here on, the session may be gone, so we only use the replica we were lent
+                    replica = std::move(waiter.replica);
+                    if (!replica) {
+                        THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::UNAVAILABLE,
+                                          "no inspect replicas left in session"}),
+                            request_context);
+                    }
+                }
+                query_type q{inspect_state_request.query_payload()};
+                process_query_on_replica(shard, id, replica, q, request_context, self, yield);
+                set_proto_inspect_state_response(q, inspect_state_response);
+                // Only results reflecting the current machine state can be cached
+                if (current) {
+                    insert_inspect_cache(shard, cache_key, q, inspect_state_response);
+                }
+                // Tell caller RPC succeeded
+                inspect_state_writer.Finish(inspect_state_response, grpc::Status::OK, self);
+                yield(side_effect::none);
+                return;
+            }
+            if (auto replica = session.tainted ? nullptr : acquire_inspect_replica(session)) {
+                InspectStateResponse inspect_state_response;
+                inspect_state_response.set_session_id(id);
+                inspect_state_response.set_active_epoch_index(session.active_epoch_index);
+                query_type q{inspect_state_request.query_payload()};
+                process_query_on_replica(shard, id, replica, q, request_context, self, yield);
+                set_proto_inspect_state_response(q, inspect_state_response);
+                insert_inspect_cache(shard, cache_key, q, inspect_state_response);
+                // Tell caller RPC succeeded
+                inspect_state_writer.Finish(inspect_state_response, grpc::Status::OK, self);
+                yield(side_effect::none);
+                return;
             }
-            // Lock session so other rpcs to the same session are rejected
-            auto_lock session_lock(session.session_lock, "InspectState session lock", request_context);
-            session.session_lock_reason = new_lock_reason;
             // If session is tainted, report potential data loss
             if (session.tainted) {
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::DATA_LOSS,
@@ -3074,74 +5592,58 @@ static handler_type::pull_type *new_InspectState_handler(handler_context &hctx)
                     request_context);
             }
             auto &e = epochs[session.active_epoch_index];
-            // Make sure there isn't already another pending query
-            if (e.pending_query.has_value()) {
-                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INTERNAL, "another query is already pending"}),
+            // Queries do not lock the session. They only wait for the machine, so they can run alongside AdvanceState
+            // rpcs and each other. If the session is locked by an rpc that may use the machine, bail out.
+            if (session.session_lock && !session.processing_lock && !session.query_lock && e.pending_inputs.empty()) {
+                THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::ABORTED,
+                                  "concurrent call in session (already locked by " + session.session_lock_reason +
+                                      " when attempted by " +
+                                      get_session_lock_reason("InspectState", request_context.peer()) + ")"}),
                     request_context);
             }
-            // Add pending query
-            e.pending_query.emplace(inspect_state_request.query_payload());
-            auto &q = e.pending_query.value();
-            // Now, either there are pending AdvanceState inputs being processed in this session, or there aren't.
-            // If there aren't, we can immediately process the InspectState query and return results.
-            // The session is locked, and therefore no other rpcs can interfere (including AdvanceState rpcs).
-            // Otherwise, we will have to yield because AdvanceState may be in the middle of an input.
-            // The function process_pending_inputs checks for a pending query between every input it processes.
-            // If it finds a pending query, it knows we are yielded and waiting. So it schedules us in the completion
-            // queue and yield.
-            // We process the query, then, when we are about to leave, we schedule process_pending_input's coroutine
-            // back in the completion queue, so it can go on processing its input queue.
-            auto_resume resume_on_exit(hctx.completion_queue.get());
-            if (!e.pending_inputs.empty()) {
-                // Set our coroutine in the pending_query so process_pending_inputs can find us
+            query_type q{inspect_state_request.query_payload()};
+            // Now, either the machine is in use in this session, or it isn't.
+            // If it isn't, we take the query lock and immediately process the InspectState query.
+            // Otherwise, we wait in the session's queue of pending queries. Either AdvanceState is processing inputs,
+            // and process_pending_inputs lets the waiting queries run in order between inputs, or a query is using the
+            // machine, and it passes the query lock to the next waiting query once it is done.
+            // An AdvanceState rpc still holding the session lock has just enqueued inputs, and will process them.
+            if (session.processing_lock || session.query_lock || session.session_lock) {
+                if (session.pending_queries.size() >= shard.inspect_queue_depth) {
+                    THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                      "too many pending queries in session (" +
+                                          std::to_string(session.pending_queries.size()) + ")"}),
+                        request_context);
+                }
+                // Set our coroutine in the query so whoever takes it from the queue can resume us
                 q.coroutine = self;
+                session.pending_queries.push_back(&q);
                 yield(side_effect::none);
-                // Here we have been resumed and process_pending_input has set its coroutine for us to find it
-                resume_on_exit.reset(q.coroutine);
+                // Here we have been resumed. If by process_pending_inputs, it has set its coroutine for us to resume
+                // it once we are done. Otherwise, we now hold the query lock.
+            } else {
+                session.query_lock = true;
             }
+            query_turn turn(shard, session, q.coroutine);
+            record_inspect_wait(session, q);
             // There is a chance the session was tainted between our yielding and being resumed
             if (session.tainted) {
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::DATA_LOSS,
                                   "session is tainted ("s + session.taint_status.error_message() + ")"}),
                     request_context);
             }
-            async_context actx{session, request_context, hctx.completion_queue.get(), self, yield};
-            process_pending_query(hctx, actx, e);
+            // Inputs may have been processed while we waited, so take the key for the state the query runs in
+            if (shard.inspect_cache.get_capacity() > 0) {
+                cache_key = get_inspect_cache_key(session, inspect_state_request.query_payload());
+            }
+            async_context actx{session, request_context, shard.completion_queue.get(), self, yield};
+            process_query(shard, actx, q);
             // Copy response
             InspectStateResponse inspect_state_response;
             inspect_state_response.set_session_id(session.id);
             inspect_state_response.set_active_epoch_index(session.active_epoch_index);
-            inspect_state_response.set_processed_input_count(q.processed_input_count);
-            for (const auto &r : q.reports) {
-                inspect_state_response.add_reports()->set_payload(r.payload);
-            }
-            switch (q.status) {
-                case completion_status::accepted:
-                    inspect_state_response.set_status(CompletionStatus::ACCEPTED);
-                    break;
-                case completion_status::rejected:
-                    inspect_state_response.set_status(CompletionStatus::REJECTED);
-                    break;
-                case completion_status::exception:
-                    inspect_state_response.set_status(CompletionStatus::EXCEPTION);
-                    if (q.exception_data.has_value()) {
-                        inspect_state_response.set_exception_data(q.exception_data.value());
-                    }
-                    break;
-                case completion_status::machine_halted:
-                    inspect_state_response.set_status(CompletionStatus::MACHINE_HALTED);
-                    break;
-                case completion_status::cycle_limit_exceeded:
-                    inspect_state_response.set_status(CompletionStatus::CYCLE_LIMIT_EXCEEDED);
-                    break;
-                case completion_status::time_limit_exceeded:
-                    inspect_state_response.set_status(CompletionStatus::TIME_LIMIT_EXCEEDED);
-                    break;
-                case completion_status::payload_length_limit_exceeded:
-                    inspect_state_response.set_status(CompletionStatus::PAYLOAD_LENGTH_LIMIT_EXCEEDED);
-                    break;
-            }
-            e.pending_query.reset();
+            set_proto_inspect_state_response(q, inspect_state_response);
+            insert_inspect_cache(shard, cache_key, q, inspect_state_response);
             // Tell caller RPC succeeded
             inspect_state_writer.Finish(inspect_state_response, grpc::Status::OK, self);
             yield(side_effect::none);
@@ -3153,8 +5655,7 @@ static handler_type::pull_type *new_InspectState_handler(handler_context &hctx)
         } catch (taint_session &e) {
             LOG_CONTEXT(error, request_context) << "Caught taint_status " << e.status().error_message();
             auto &session = e.session();
-            session.tainted = true;
-            session.taint_status = e.status();
+            set_session_taint(shard, session, e.status());
             inspect_state_writer.FinishWithError(session.taint_status, self);
             yield(side_effect::none);
         } catch (std::exception &e) {
@@ -3162,10 +5663,9 @@ static handler_type::pull_type *new_InspectState_handler(handler_context &hctx)
             const auto &id = inspect_state_request.session_id();
             auto taint_status =
                 grpc::Status{grpc::StatusCode::INTERNAL, std::string{"unexpected exception "} + e.what()};
-            if (hctx.sessions.find(id) != hctx.sessions.end()) {
-                auto &session = hctx.sessions[id];
-                session.tainted = true;
-                session.taint_status = taint_status;
+            if (shard.sessions.find(id) != shard.sessions.end()) {
+                auto &session = shard.sessions[id];
+                set_session_taint(shard, session, taint_status);
             }
             inspect_state_writer.FinishWithError(taint_status, self);
             yield(side_effect::none);
@@ -3177,8 +5677,9 @@ static handler_type::pull_type *new_InspectState_handler(handler_context &hctx)
 /// \brief Creates a new handler for the Checkin RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_Checkin_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::checkin);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         // Start accepting CheckIn rpcs.
         ServerContext request_context;
@@ -3186,34 +5687,38 @@ static handler_type::pull_type *new_Checkin_handler(handler_context &hctx) {
         ServerAsyncResponseWriter<Void> checkin_writer(&request_context);
         auto *cq = hctx.completion_queue.get();
         // Start expecting check-in rpcs
-        hctx.checkin_async_service.RequestCheckIn(&request_context, &checkin_request, &checkin_writer, cq, cq, self);
+        hctx.server->checkin_async_service.RequestCheckIn(&request_context, &checkin_request, &checkin_writer, cq, cq,
+            self);
         yield(side_effect::none);
-        new_Checkin_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        replace_handler(hctx, handler_kind::checkin, new_Checkin_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received CheckIn RPC with handle_context ok set to false";
             return;
         }
+        // From here on, run in the shard of the session, or of the session the inspect replica belongs to
+        auto *replica_shard = find_replica_shard(*hctx.server, checkin_request.session_id());
+        auto &shard = enter_shard(hctx,
+            replica_shard != nullptr ? *replica_shard : get_session_shard(hctx, checkin_request.session_id()), self,
+            yield);
         try {
             const auto &id = checkin_request.session_id(); // NOLINT: Unknown. Maybe linter bug?
             LOG_CONTEXT(info, request_context) << "Received CheckIn for session " << id;
             // If check-in is for the wrong session, bail out
-            if (hctx.sessions_waiting_checkin.find(id) == hctx.sessions_waiting_checkin.end()) {
+            if (shard.sessions_waiting_checkin.find(id) == shard.sessions_waiting_checkin.end()) {
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
                                   "check-in with wrong session id " + id}),
                     request_context);
             }
             // If the actual session is unknown, a bail out
-            if (hctx.sessions.find(id) == hctx.sessions.end()) {
+            if (replica_shard == nullptr && shard.sessions.find(id) == shard.sessions.end()) {
                 THROW_CONTEXT((finish_error_yield_none{grpc::StatusCode::INVALID_ARGUMENT,
                                   "could not find an actual session with id " + id}),
                     request_context);
             }
-            // Get session and register remote machine address
-            auto &session = hctx.sessions[id];
-            session.server_address = checkin_request.address();
-            // Session is not waiting for check-in anymore. Cancel it's deadline
-            auto &cctx = hctx.sessions_waiting_checkin[id];
+            // Session is not waiting for check-in anymore. Register remote machine address and cancel it's deadline
+            auto &cctx = shard.sessions_waiting_checkin[id];
+            cctx.address = checkin_request.address();
             cctx.status = true;
             cctx.alarm->Cancel();
             auto *coroutine = cctx.coroutine;
@@ -3241,8 +5746,9 @@ static handler_type::pull_type *new_Checkin_handler(handler_context &hctx) {
 /// \brief Creates a new handler for the Health RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_Health_Check_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::health_check);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         using namespace grpc::health::v1;
         // Start accepting Health rpcs.
@@ -3251,9 +5757,9 @@ static handler_type::pull_type *new_Health_Check_handler(handler_context &hctx)
         ServerAsyncResponseWriter<HealthCheckResponse> health_writer(&request_context);
         auto *cq = hctx.completion_queue.get();
         // Start expecting check-in rpcs
-        hctx.health_async_service.RequestCheck(&request_context, &health_request, &health_writer, cq, cq, self);
+        hctx.server->health_async_service.RequestCheck(&request_context, &health_request, &health_writer, cq, cq, self);
         yield(side_effect::none);
-        new_Health_Check_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        replace_handler(hctx, handler_kind::health_check, new_Health_Check_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received Health Check RPC with handle_context ok set to false";
@@ -3261,8 +5767,8 @@ static handler_type::pull_type *new_Health_Check_handler(handler_context &hctx)
         }
         const auto &service = health_request.service(); // NOLINT: grpc warnings
         LOG_CONTEXT(info, request_context) << "Received Health Check for service " << service;
-        auto iter = hctx.service_health.find(service);
-        if (iter == hctx.service_health.end()) {
+        auto iter = hctx.server->service_health.find(service);
+        if (iter == hctx.server->service_health.end()) {
             health_writer.FinishWithError(grpc::Status(StatusCode::NOT_FOUND, "Service not found"), self);
         } else {
             HealthCheckResponse health_response;
@@ -3277,8 +5783,9 @@ static handler_type::pull_type *new_Health_Check_handler(handler_context &hctx)
 /// \brief Creates a new handler for the Health RPC and starts accepting requests
 /// \param hctx Handler context shared between all handlers
 static handler_type::pull_type *new_Health_Watch_handler(handler_context &hctx) {
-    auto *self = static_cast<handler_type::pull_type *>(operator new(sizeof(handler_type::pull_type)));
-    new (self) handler_type::pull_type{[self, &hctx](handler_type::push_type &yield) {
+    auto *self = allocate_handler(hctx);
+    auto stack = get_stack_allocator(hctx, handler_kind::health_watch);
+    new (self) handler_type::pull_type{stack, [self, &hctx](handler_type::push_type &yield) {
         using namespace grpc;
         using namespace grpc::health::v1;
         // Start accepting Health rpcs.
@@ -3287,9 +5794,9 @@ static handler_type::pull_type *new_Health_Watch_handler(handler_context &hctx)
         ServerAsyncWriter<HealthCheckResponse> health_writer(&request_context);
         auto *cq = hctx.completion_queue.get();
         // Start expecting check-in rpcs
-        hctx.health_async_service.RequestWatch(&request_context, &health_request, &health_writer, cq, cq, self);
+        hctx.server->health_async_service.RequestWatch(&request_context, &health_request, &health_writer, cq, cq, self);
         yield(side_effect::none);
-        new_Health_Watch_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
+        replace_handler(hctx, handler_kind::health_watch, new_Health_Watch_handler);
         // Not sure if we can receive an RPC with ok set to false. To be safe, we will ignore those.
         if (!hctx.ok) {
             LOG_CONTEXT(error, request_context) << "Received Health Watch RPC with handle_context ok set to false";
@@ -3324,36 +5831,29 @@ static std::string replace_port(const std::string &address, int port) {
 
 /// \brief Builds the manager server object and returns it
 /// \param manage_address Address where manager will bind
-/// \param hctx Handler context to be shared among all handlers
-static auto build_manager(const char *manager_address, handler_context &hctx) {
+/// \param server Server context shared among all shards
+static auto build_manager(const char *manager_address, server_context &server) {
     grpc::ServerBuilder builder;
     int manager_port = 0;
     builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 0);
     builder.AddListeningPort(manager_address, grpc::InsecureServerCredentials(), &manager_port);
-    builder.RegisterService(&hctx.manager_async_service);
-    builder.RegisterService(&hctx.checkin_async_service);
-    builder.RegisterService(&hctx.health_async_service);
-    hctx.completion_queue = builder.AddCompletionQueue();
-    hctx.service_health.insert({
+    builder.RegisterService(&server.manager_async_service);
+    builder.RegisterService(&server.checkin_async_service);
+    builder.RegisterService(&server.health_async_service);
+    for (auto &shard : server.shards) {
+        shard->completion_queue = builder.AddCompletionQueue();
+    }
+    server.service_health.insert({
         {"", health_status_type::HealthCheckResponse_ServingStatus_SERVING},
         {ServerManager::service_full_name(), health_status_type::HealthCheckResponse_ServingStatus_SERVING},
         {MachineCheckIn::service_full_name(), health_status_type::HealthCheckResponse_ServingStatus_SERVING},
         {grpc::health::v1::Health::service_full_name(), health_status_type::HealthCheckResponse_ServingStatus_SERVING},
     });
     auto manager = builder.BuildAndStart();
-    hctx.manager_address = replace_port(manager_address, manager_port);
-    return manager;
-}
-
-/// \brief Drains a completion queue of all pending handlers and deletes them
-/// \param cq Completion queue
-static void drain_completion_queue(grpc::ServerCompletionQueue *cq) {
-    cq->Shutdown();
-    bool ok = false;
-    handler_type::pull_type *h = nullptr;
-    while (cq->Next(reinterpret_cast<void **>(&h), &ok)) { // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
-        delete h;
+    for (auto &shard : server.shards) {
+        shard->manager_address = replace_port(manager_address, manager_port);
     }
+    return manager;
 }
 
 /// \brief Checks if a handler is finished
@@ -3363,13 +5863,177 @@ static bool finished(handler_type::pull_type *c) {
     return !(*c);
 }
 
+/// \brief Asks main thread to shutdown the server
+/// \param server Server context
+static void request_shutdown(server_context &server) {
+    std::lock_guard<std::mutex> lock(server.shutdown_mutex);
+    server.shutdown_requested = true;
+    server.shutdown_cv.notify_all();
+}
+
+/// \brief Deletes a handler that finished or must be abandoned
+/// \param hctx Handler context of shard running the handler
+/// \param h Handler
+/// \details Handlers adopted from another shard are sent back so the shard that accepted them deletes them.
+/// Otherwise, the same address could be allocated to a new handler before that shard stops forwarding it.
+static void retire_handler(handler_context &hctx, handler_type::pull_type *h) {
+    auto it = hctx.adopted.find(h);
+    if (it != hctx.adopted.end()) {
+        auto *home = it->second;
+        hctx.adopted.erase(it);
+        {
+            std::lock_guard<std::mutex> lock(home->retired_mutex);
+            home->retired.push_back(h);
+        }
+        // Wake up its dispatch thread
+        enqueue_completion_queue(home->completion_queue.get(), nullptr);
+    } else {
+        delete_handler(hctx, h);
+    }
+}
+
+/// \brief Deletes the migrated handlers that other shards sent back
+/// \param hctx Handler context of shard that accepted the handlers
+static void delete_retired_handlers(handler_context &hctx) {
+    std::vector<handler_type::pull_type *> retired;
+    {
+        std::lock_guard<std::mutex> lock(hctx.retired_mutex);
+        retired.swap(hctx.retired);
+    }
+    for (auto *h : retired) {
+        hctx.migrated.erase(h);
+        delete_handler(hctx, h);
+    }
+}
+
+/// \brief Resumes the handlers arriving in the completion queue of a shard until it is shut down
+/// \param hctx Handler context of shard
+static void dispatch_shard(handler_context &hctx) {
+    auto &server = *hctx.server;
+    bool stopped = false;
+    for (;;) {
+        // Replace the handlers taken by RPCs that arrived since the last time around
+        if (!server.stopping) {
+            refill_handlers(hctx);
+        }
+        // Obtain the next active handler
+        handler_type::pull_type *h = nullptr; // NOLINT: cannot leak (kept in drained during shutdown)
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        if (!hctx.completion_queue->Next(reinterpret_cast<void **>(&h), &hctx.ok)) {
+            return;
+        }
+        // Once shutting down, keep remaining handlers to be deleted after all dispatch threads are done
+        if (server.stopping) {
+            if (!stopped) {
+                stopped = true;
+                std::lock_guard<std::mutex> lock(server.shutdown_mutex);
+                ++server.stopped_shards;
+                server.shutdown_cv.notify_all();
+            }
+            if (h != nullptr) {
+                hctx.drained.push_back(h);
+            }
+            continue;
+        }
+        // A null handler wakes us up to delete handlers that finished in other shards
+        if (h == nullptr) {
+            delete_retired_handlers(hctx);
+            continue;
+        }
+        // If the handler migrated to another shard, forward it there without touching it.
+        // It may be running in that shard's dispatch thread right now.
+        auto it = hctx.migrated.find(h);
+        if (it != hctx.migrated.end()) {
+            auto &target = *it->second;
+            // The alarm forwarding the handler does not carry the status of the completion, so we pass it along
+            {
+                std::lock_guard<std::mutex> lock(target.forwarded_mutex);
+                target.forwarded[h] = hctx.ok;
+            }
+            enqueue_completion_queue(target.completion_queue.get(), h);
+            continue;
+        }
+        // If the completion was forwarded from the shard that accepted the handler, recover its status
+        if (hctx.adopted.find(h) != hctx.adopted.end()) {
+            std::lock_guard<std::mutex> lock(hctx.forwarded_mutex);
+            auto forwarded = hctx.forwarded.find(h);
+            if (forwarded != hctx.forwarded.end()) {
+                hctx.ok = forwarded->second;
+                hctx.forwarded.erase(forwarded);
+            }
+        }
+        // If the handler is finished, simply delete it
+        // This can't really happen here, because the handler ALWAYS yields
+        // after arranging for the completion queue to return it, rather than
+        // finishing.
+        if (finished(h)) {
+            retire_handler(hctx, h);
+            continue;
+        }
+        // Otherwise, resume it
+        (*h)();
+        // If it is now finished after being resumed, simply delete it
+        if (finished(h)) {
+            retire_handler(hctx, h);
+            continue;
+        }
+        switch (h->get()) {
+            case side_effect::none:
+                break;
+            case side_effect::migrate:
+                // Now that it yielded, the handler can safely resume in the other shard
+                hctx.migrated.emplace(h, hctx.migrate_to);
+                enqueue_completion_queue(hctx.migrate_to->completion_queue.get(), h);
+                break;
+            case side_effect::shutdown:
+                // Delete this handler and shutdown. The other pending handlers will be deleted when
+                // we drain the completion queues.
+                retire_handler(hctx, h);
+                request_shutdown(server);
+                break;
+        }
+    }
+}
+
+/// \brief Posts the handlers accepting each RPC in a shard
+/// \param hctx Handler context of shard
+static void start_shard(handler_context &hctx) {
+    const auto &depth = hctx.server->accept_depth;
+    auto post = [&hctx, &depth](handler_kind kind, new_handler_type new_handler) {
+        for (size_t i = 0; i < depth[static_cast<size_t>(kind)]; ++i) {
+            post_handler(hctx, kind, new_handler);
+        }
+    };
+    post(handler_kind::get_version, new_GetVersion_handler);
+    post(handler_kind::start_session, new_StartSession_handler);
+    post(handler_kind::advance_state, new_AdvanceState_handler);
+    post(handler_kind::advance_state_batch, new_AdvanceStateBatch_handler);
+    post(handler_kind::get_status, new_GetStatus_handler);
+    post(handler_kind::get_session_status, new_GetSessionStatus_handler);
+    post(handler_kind::get_epoch_status, new_GetEpochStatus_handler);
+    post(handler_kind::watch_epoch, new_WatchEpoch_handler);
+    post(handler_kind::inspect_state, new_InspectState_handler);
+    post(handler_kind::finish_epoch, new_FinishEpoch_handler);
+    post(handler_kind::finish_epoch_stream, new_FinishEpochStream_handler);
+    post(handler_kind::get_output_proof, new_GetOutputProof_handler);
+    post(handler_kind::delete_epoch, new_DeleteEpoch_handler);
+    post(handler_kind::end_session, new_EndSession_handler);
+    post(handler_kind::checkin, new_Checkin_handler);
+    post(handler_kind::health_check, new_Health_Check_handler);
+    post(handler_kind::health_watch, new_Health_Watch_handler);
+}
+
 /// \brief Prints help
 /// \param name Program name vrom argv[0]
 static void help(const char *name) {
     (void) fprintf(stderr,
         R"(Usage:
 
-    %s --manager-address=<address> --server-address=<address> [--help]
+    %s --manager-address=<address> --server-address=<address>
+        [--epoch-storage-directory=<directory>] [--disable-proof-self-check]
+        [--dispatch-threads=<n>] [--worker-threads=<n>] [--stack-size=[<rpc>:]<kib>]...
+        [--accept-depth=[<rpc>:]<n>]... [--inspect-cache-size=<kib>]
+        [--inspect-queue-depth=<n>] [--help]
 
 where
 
@@ -3383,6 +6047,55 @@ where
       passed to the spawned remote cartesi machine
       default: localhost:0
 
+    --epoch-storage-directory=<directory>
+      moves finished epochs to files in <directory>, created if missing,
+      and serves them from memory-mapped views of these files
+      default: finished epochs are kept in memory
+
+    --disable-proof-self-check
+      skips verifying the output proofs sliced from machine proofs,
+      for deployments that trust the remote cartesi machine
+
+    --dispatch-threads=<n>
+      serves sessions from <n> shards, each with its own completion queue
+      and dispatch thread; sessions are assigned to shards by id
+      default: number of hardware threads
+
+    --worker-threads=<n>
+      runs CPU-heavy work, such as building FinishEpoch responses, in a
+      pool of <n> threads, so dispatch threads keep serving other rpcs
+      default: number of hardware threads
+
+    --stack-size=[<rpc>:]<kib>
+      sets the coroutine stack size, in KiB, of handlers for <rpc>, or of
+      all handlers if <rpc> is omitted; may be repeated, applied in order
+      <rpc> is one of GetVersion, GetStatus, StartSession, AdvanceState,
+        AdvanceStateBatch, InspectState, FinishEpoch, FinishEpochStream,
+        GetOutputProof, DeleteEpoch, EndSession, GetSessionStatus,
+        GetEpochStatus, WatchEpoch, CheckIn, CheckInDeadline, InspectReplica,
+        HealthCheck, HealthWatch
+      default: Boost.Context default stack size
+
+    --accept-depth=[<rpc>:]<n>
+      keeps <n> handlers waiting for <rpc>, or for each rpc if <rpc> is
+      omitted, in each shard; a handler taken by an arriving rpc is
+      replaced once that rpc first yields, and GetStatus reports how long
+      each rpc had no handler waiting; may be repeated, applied in order
+      <rpc> is as in --stack-size
+      default: 1
+
+    --inspect-cache-size=<kib>
+      keeps up to <kib> KiB of InspectState responses in each shard, served
+      again without running the query while the machine state and query
+      payload are the same; 0 disables the cache
+      default: 16384
+
+    --inspect-queue-depth=<n>
+      lets up to <n> InspectState queries wait, in order, for the machine of
+      each session; queries arriving when <n> are waiting fail with
+      RESOURCE_EXHAUSTED
+      default: 64
+
     --version
       prints the server version number
 
@@ -3412,6 +6125,63 @@ static bool stringval(const char *pre, const char *str, const char **val) {
     return false;
 }
 
+/// \brief Parses an option setting a number of threads
+/// \param value Option value
+/// \param count Receives number of threads
+/// \returns True if option value is a positive integer, false otherwise
+static bool parse_thread_count(const char *value, size_t &count) {
+    char *end = nullptr;
+    const unsigned long n = strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || n == 0) {
+        return false;
+    }
+    count = n;
+    return true;
+}
+
+/// \brief Parses an option setting a size
+/// \param value Option value
+/// \param unit Multiplier applied to value
+/// \param size Receives size
+/// \returns True if option value is a non-negative integer, false otherwise
+static bool parse_size(const char *value, size_t unit, size_t &size) {
+    char *end = nullptr;
+    const unsigned long n = strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || n > SIZE_MAX / unit) {
+        return false;
+    }
+    size = n * unit;
+    return true;
+}
+
+/// \brief Parses an option setting a value for each kind of handler
+/// \param value Option value, either <n> or <rpc>:<n>, with positive integer <n>
+/// \param unit Multiplier applied to <n>
+/// \param values Receives value for the given kind of handler, or for all kinds if no kind is given
+/// \returns True if option value is valid, false otherwise
+static bool parse_handler_option(const char *value, size_t unit,
+    std::array<size_t, static_cast<size_t>(handler_kind::count)> &values) {
+    const char *colon = strchr(value, ':');
+    const char *n_value = colon ? colon + 1 : value;
+    char *end = nullptr;
+    const unsigned long n = strtoul(n_value, &end, 10);
+    if (*n_value == '\0' || *end != '\0' || n == 0 || n > SIZE_MAX / unit) {
+        return false;
+    }
+    if (!colon) {
+        values.fill(n * unit);
+        return true;
+    }
+    const std::string name(value, colon);
+    for (size_t i = 0; i < handler_kind_names.size(); ++i) {
+        if (name == handler_kind_names[i]) {
+            values[i] = n * unit;
+            return true;
+        }
+    }
+    return false;
+}
+
 static void cleanup_child_handler(int signal) {
     (void) signal;
     while (waitpid(static_cast<pid_t>(-1), nullptr, WNOHANG) > 0) {
@@ -3443,6 +6213,14 @@ int main(int argc, char *argv[]) try {
 
     const char *manager_address = nullptr;
     const char *server_address = "localhost:0";
+    const char *epoch_storage_directory = "";
+    bool proof_self_check = true;
+    const char *dispatch_threads_value = nullptr;
+    const char *worker_threads_value = nullptr;
+    std::vector<const char *> stack_size_values;
+    std::vector<const char *> accept_depth_values;
+    const char *inspect_cache_size_value = nullptr;
+    const char *inspect_queue_depth_value = nullptr;
 
     if (argc < 1) { // NOLINT: of course it could be < 1...
         std::cerr << "missing argv[0]\n";
@@ -3454,6 +6232,22 @@ int main(int argc, char *argv[]) try {
             ;
         } else if (stringval("--server-address=", argv[i], &server_address)) {
             ;
+        } else if (stringval("--epoch-storage-directory=", argv[i], &epoch_storage_directory)) {
+            ;
+        } else if (strcmp(argv[i], "--disable-proof-self-check") == 0) {
+            proof_self_check = false;
+        } else if (stringval("--dispatch-threads=", argv[i], &dispatch_threads_value)) {
+            ;
+        } else if (stringval("--worker-threads=", argv[i], &worker_threads_value)) {
+            ;
+        } else if (const char *value = nullptr; stringval("--stack-size=", argv[i], &value)) {
+            stack_size_values.push_back(value);
+        } else if (const char *value = nullptr; stringval("--accept-depth=", argv[i], &value)) {
+            accept_depth_values.push_back(value);
+        } else if (stringval("--inspect-cache-size=", argv[i], &inspect_cache_size_value)) {
+            ;
+        } else if (stringval("--inspect-queue-depth=", argv[i], &inspect_queue_depth_value)) {
+            ;
         } else if (strcmp(argv[i], "--version") == 0) {
             print_version();
             exit(0);
@@ -3470,8 +6264,44 @@ int main(int argc, char *argv[]) try {
         exit(1);
     }
 
+    size_t dispatch_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    if (dispatch_threads_value && !parse_thread_count(dispatch_threads_value, dispatch_threads)) {
+        std::cerr << "invalid dispatch-threads\n";
+        exit(1);
+    }
+    size_t worker_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    if (worker_threads_value && !parse_thread_count(worker_threads_value, worker_threads)) {
+        std::cerr << "invalid worker-threads\n";
+        exit(1);
+    }
+    size_t inspect_cache_size = DEFAULT_INSPECT_CACHE_SIZE;
+    if (inspect_cache_size_value && !parse_size(inspect_cache_size_value, 1024, inspect_cache_size)) {
+        std::cerr << "invalid inspect-cache-size\n";
+        exit(1);
+    }
+    size_t inspect_queue_depth = DEFAULT_INSPECT_QUEUE_DEPTH;
+    if (inspect_queue_depth_value &&
+        (!parse_size(inspect_queue_depth_value, 1, inspect_queue_depth) || inspect_queue_depth == 0)) {
+        std::cerr << "invalid inspect-queue-depth\n";
+        exit(1);
+    }
+
     init_logger();
-    handler_context hctx{};
+    server_context server{};
+    server.stack_size.fill(boost::context::stack_traits::default_size());
+    for (const char *value : stack_size_values) {
+        if (!parse_handler_option(value, 1024, server.stack_size)) {
+            std::cerr << "invalid stack-size '" << value << "'\n";
+            exit(1);
+        }
+    }
+    server.accept_depth.fill(1);
+    for (const char *value : accept_depth_values) {
+        if (!parse_handler_option(value, 1, server.accept_depth)) {
+            std::cerr << "invalid accept-depth '" << value << "'\n";
+            exit(1);
+        }
+    }
 
     std::filesystem::path remote_cartesi_machine_path = boost::process::search_path("remote-cartesi-machine").string();
     if (!std::filesystem::exists(remote_cartesi_machine_path)) {
@@ -3482,14 +6312,29 @@ int main(int argc, char *argv[]) try {
         }
     }
 
-    hctx.remote_cartesi_machine_path = remote_cartesi_machine_path;
-    hctx.manager_address = manager_address;
-    hctx.server_address = server_address;
+    for (size_t i = 0; i < dispatch_threads; ++i) {
+        auto &hctx = *server.shards.emplace_back(std::make_unique<handler_context>());
+        hctx.server = &server;
+        hctx.remote_cartesi_machine_path = remote_cartesi_machine_path;
+        hctx.manager_address = manager_address;
+        hctx.server_address = server_address;
+        hctx.epoch_storage_directory = epoch_storage_directory;
+        hctx.proof_self_check = proof_self_check;
+        hctx.inspect_cache = cartesi::lru_cache<inspect_cache_key_type, InspectStateResponse>{inspect_cache_size};
+        hctx.inspect_queue_depth = inspect_queue_depth;
+    }
+    if (strlen(epoch_storage_directory) > 0) {
+        std::filesystem::create_directories(epoch_storage_directory);
+    }
 
     BOOST_LOG_TRIVIAL(info) << "manager version is " << manager_version_major << "." << manager_version_minor << "."
                             << manager_version_patch;
+    BOOST_LOG_TRIVIAL(info) << "using " << cartesi::get_cpu_dispatch_isa() << " kernels";
+    BOOST_LOG_TRIVIAL(info) << "using " << dispatch_threads << " dispatch threads";
+    BOOST_LOG_TRIVIAL(info) << "using " << worker_threads << " worker threads";
+    server.worker_pool = std::make_unique<cartesi::thread_pool>(worker_threads);
 
-    auto manager = build_manager(manager_address, hctx);
+    auto manager = build_manager(manager_address, server);
     if (!manager) {
         BOOST_LOG_TRIVIAL(fatal) << "manager server creation failed";
         exit(1);
@@ -3500,60 +6345,53 @@ int main(int argc, char *argv[]) try {
     sa.sa_flags = 0;
     sigaction(SIGCHLD, &sa, nullptr);
 
-    // Start accepting requests for all RPCs
-    new_GetVersion_handler(hctx);       // NOLINT: cannot leak (pointer is in completion queue)
-    new_StartSession_handler(hctx);     // NOLINT: cannot leak (pointer is in completion queue)
-    new_AdvanceState_handler(hctx);     // NOLINT: cannot leak (pointer is in completion queue)
-    new_GetStatus_handler(hctx);        // NOLINT: cannot leak (pointer is in completion queue)
-    new_GetSessionStatus_handler(hctx); // NOLINT: cannot leak (pointer is in completion queue)
-    new_GetEpochStatus_handler(hctx);   // NOLINT: cannot leak (pointer is in completion queue)
-    new_InspectState_handler(hctx);     // NOLINT: cannot leak (pointer is in completion queue)
-    new_FinishEpoch_handler(hctx);      // NOLINT: cannot leak (pointer is in completion queue)
-    new_DeleteEpoch_handler(hctx);      // NOLINT: cannot leak (pointer is in completion queue)
-    new_EndSession_handler(hctx);       // NOLINT: cannot leak (pointer is in completion queue)
-    new_Checkin_handler(hctx);          // NOLINT: cannot leak (pointer is in completion queue)
-    new_Health_Check_handler(hctx);     // NOLINT: cannot leak (pointer is in completion queue)
-    new_Health_Watch_handler(hctx);     // NOLINT: cannot leak (pointer is in completion queue)
-
-    // Dispatch loop
-    for (;;) {
-        // Obtain the next active handler
-        handler_type::pull_type *h = nullptr; // NOLINT: cannot leak (drain_completion_queue kills remaining)
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-        if (!hctx.completion_queue->Next(reinterpret_cast<void **>(&h), &hctx.ok)) {
-            goto shutdown; // NOLINT(cppcoreguidelines-avoid-goto)
+    // Start accepting requests for all RPCs in all shards, each served by its own dispatch thread
+    std::vector<std::thread> threads;
+    for (auto &hctx : server.shards) {
+        start_shard(*hctx);
+        threads.emplace_back(dispatch_shard, std::ref(*hctx));
+    }
+
+    // Wait until a handler requests a shutdown
+    {
+        std::unique_lock<std::mutex> lock(server.shutdown_mutex);
+        server.shutdown_cv.wait(lock, [&server] { return server.shutdown_requested; });
+    }
+    // Make sure no dispatch thread is resuming handlers before shutting down the server
+    server.stopping = true;
+    for (auto &hctx : server.shards) {
+        enqueue_completion_queue(hctx->completion_queue.get(), nullptr);
+    }
+    {
+        std::unique_lock<std::mutex> lock(server.shutdown_mutex);
+        server.shutdown_cv.wait(lock, [&server] { return server.stopped_shards == server.shards.size(); });
+    }
+    // Let the worker pool finish, while the completion queues can still receive the handlers it resumes
+    server.worker_pool.reset();
+    // Shutdown server before completion queues. Handlers are no longer resumed, so there is no point in waiting for
+    // rpcs still in flight, such as WatchEpoch streams. They are cancelled right away.
+    manager->Shutdown(std::chrono::system_clock::now());
+    for (auto &hctx : server.shards) {
+        hctx->completion_queue->Shutdown();
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    // Delete all pending handlers
+    for (auto &hctx : server.shards) {
+        delete_retired_handlers(*hctx);
+        for (auto *h : hctx->drained) {
+            delete_handler(*hctx, h);
         }
-        // If the handler is finished, simply delete it
-        // This can't really happen here, because the handler ALWAYS yields
-        // after arranging for the completion queue to return it, rather than
-        // finishing.
-        if (finished(h)) {
-            delete h;
-        } else {
-            // Otherwise, resume it
-            (*h)();
-            // If it is now finished after being resumed, simply delete it
-            if (finished(h)) {
-                delete h;
-            } else {
-                // Otherwise, if requested a shutdown, delete this handler and
-                // shutdown. The other pending handlers will be deleted when
-                // we drain the completion queue.
-                if (h->get() == side_effect::shutdown) {
-                    delete h;
-                    goto shutdown; // NOLINT(cppcoreguidelines-avoid-goto)
-                }
-            }
+        for (auto *h : hctx->free_handlers) {
+            operator delete(h);
         }
     }
-
-shutdown:
-    // Shutdown server before completion queue
-    manager->Shutdown();
-    drain_completion_queue(hctx.completion_queue.get());
     // Kill all machine servers
-    for (auto &session_pair : hctx.sessions) {
-        session_pair.second.server_process_group.terminate();
+    for (auto &hctx : server.shards) {
+        for (auto &session_pair : hctx->sessions) {
+            session_pair.second.server_process_group.terminate();
+        }
     }
     return 0;
 } catch (std::exception &e) {
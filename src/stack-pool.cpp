@@ -0,0 +1,100 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <new>
+
+#include <sys/mman.h>
+
+#include <boost/context/stack_traits.hpp>
+
+#include "stack-pool.h"
+
+namespace cartesi {
+
+stack_pool::stack_pool(size_t max_pooled_bytes) : m_max_pooled_bytes{max_pooled_bytes} {}
+
+stack_pool::~stack_pool() {
+    for (auto &[size, stacks] : m_free) {
+        for (auto *bottom : stacks) {
+            munmap(bottom, size);
+        }
+    }
+}
+
+boost::context::stack_context stack_pool::allocate(size_t size) {
+    const size_t page_size = boost::context::stack_traits::page_size();
+    // Round up to whole pages and add guard page at the bottom
+    const size_t mapped_size = ((size + page_size - 1) / page_size + 1) * page_size;
+    void *bottom = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_free.find(mapped_size);
+        if (it != m_free.end() && !it->second.empty()) {
+            bottom = it->second.back();
+            it->second.pop_back();
+            m_stats.stacks_pooled--;
+            m_stats.bytes_pooled -= mapped_size;
+            m_stats.reused++;
+        }
+    }
+    if (bottom == nullptr) {
+        bottom = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if (bottom == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (mprotect(bottom, page_size, PROT_NONE) != 0) {
+            munmap(bottom, mapped_size);
+            throw std::bad_alloc();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.stacks_in_use++;
+        m_stats.bytes_in_use += mapped_size;
+        m_stats.allocations++;
+    }
+    boost::context::stack_context sctx;
+    sctx.size = mapped_size;
+    sctx.sp = static_cast<char *>(bottom) + mapped_size;
+    return sctx;
+}
+
+void stack_pool::deallocate(boost::context::stack_context &sctx) noexcept {
+    void *bottom = static_cast<char *>(sctx.sp) - sctx.size;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.stacks_in_use--;
+        m_stats.bytes_in_use -= sctx.size;
+        if (m_stats.bytes_pooled + sctx.size <= m_max_pooled_bytes) {
+            try {
+                m_free[sctx.size].push_back(bottom);
+                m_stats.stacks_pooled++;
+                m_stats.bytes_pooled += sctx.size;
+                return;
+            } catch (...) { // NOLINT(bugprone-empty-catch)
+                // Could not keep the stack, so unmap it below
+            }
+        }
+    }
+    munmap(bottom, sctx.size);
+}
+
+stack_pool::stats_type stack_pool::get_stats(void) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+} // namespace cartesi
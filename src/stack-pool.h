@@ -0,0 +1,113 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef STACK_POOL_H
+#define STACK_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <boost/context/stack_context.hpp>
+
+/// \file
+/// \brief Pool of coroutine stacks protected by guard pages.
+
+namespace cartesi {
+
+/// \brief Pool of coroutine stacks protected by guard pages
+/// \details Stacks are mapped with a guard page below them, so an overflow faults instead of corrupting
+/// memory. Released stacks are kept for reuse, up to a limit, instead of being unmapped. The pool can be
+/// shared by multiple threads.
+class stack_pool final {
+public:
+    /// \brief Boost.Context stack allocator drawing stacks of a given size from a pool
+    class allocator {
+    public:
+        /// \brief Constructor
+        /// \param pool Pool to draw stacks from. Must outlive all stacks allocated.
+        /// \param size Usable stack size, rounded up to a whole number of pages
+        allocator(stack_pool &pool, size_t size) : m_pool{&pool}, m_size{size} {}
+
+        /// \brief Allocates a stack
+        boost::context::stack_context allocate(void) {
+            return m_pool->allocate(m_size);
+        }
+
+        /// \brief Returns a stack to the pool
+        void deallocate(boost::context::stack_context &sctx) noexcept {
+            m_pool->deallocate(sctx);
+        }
+
+    private:
+        stack_pool *m_pool; ///< Pool to draw stacks from
+        size_t m_size;      ///< Usable stack size
+    };
+
+    /// \brief Pool statistics
+    struct stats_type {
+        uint64_t stacks_in_use; ///< Number of stacks currently allocated
+        uint64_t bytes_in_use;  ///< Bytes mapped for stacks currently allocated, including guard pages
+        uint64_t stacks_pooled; ///< Number of released stacks kept for reuse
+        uint64_t bytes_pooled;  ///< Bytes mapped for released stacks kept for reuse, including guard pages
+        uint64_t allocations;   ///< Number of stacks allocated so far
+        uint64_t reused;        ///< Number of stacks allocated so far that were taken from the pool
+    };
+
+    /// \brief Constructor
+    /// \param max_pooled_bytes Maximum number of bytes kept mapped for released stacks
+    explicit stack_pool(size_t max_pooled_bytes);
+
+    /// \brief Unmaps all pooled stacks
+    /// \details Stacks still in use are not unmapped
+    ~stack_pool();
+
+    stack_pool(const stack_pool &other) = delete;
+    stack_pool(stack_pool &&other) = delete;
+    stack_pool &operator=(const stack_pool &other) = delete;
+    stack_pool &operator=(stack_pool &&other) = delete;
+
+    /// \brief Returns an allocator for stacks of a given size
+    /// \param size Usable stack size
+    allocator get_allocator(size_t size) {
+        return allocator{*this, size};
+    }
+
+    /// \brief Allocates a stack, reusing a released stack of the same size if possible
+    /// \param size Usable stack size, rounded up to a whole number of pages
+    /// \returns Stack context, with sp pointing to the top of the stack
+    /// \details Throws std::bad_alloc if the stack cannot be mapped
+    boost::context::stack_context allocate(size_t size);
+
+    /// \brief Releases a stack
+    /// \param sctx Stack context returned by allocate
+    void deallocate(boost::context::stack_context &sctx) noexcept;
+
+    /// \brief Returns pool statistics
+    stats_type get_stats(void) const;
+
+private:
+    mutable std::mutex m_mutex;                   ///< Guards all other members
+    std::map<size_t, std::vector<void *>> m_free; ///< Bottom of released stacks, by mapped size
+    size_t m_max_pooled_bytes;                    ///< Maximum number of bytes kept for released stacks
+    stats_type m_stats{};                         ///< Pool statistics
+};
+
+} // namespace cartesi
+
+#endif
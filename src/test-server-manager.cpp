@@ -14,12 +14,15 @@
 // limitations under the License.
 //
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <cryptopp/filters.h>
 #include <cryptopp/hex.h>
@@ -47,6 +50,7 @@
 #pragma clang diagnostic pop
 #endif
 
+#include "batch-proof-verifier.h"
 #include "complete-merkle-tree.h"
 
 using CartesiMachine::Void;
@@ -56,6 +60,8 @@ using grpc::StatusCode;
 
 // NOLINTNEXTLINE(misc-unused-using-decls)
 using std::chrono_literals::operator""s;
+// NOLINTNEXTLINE(misc-unused-using-decls)
+using std::chrono_literals::operator""ms;
 
 using namespace std::filesystem;
 using namespace CartesiServerManager;
@@ -67,6 +73,7 @@ constexpr static const int LOG2_KECCAK_SIZE = 5;
 constexpr static const int LOG2_WORD_SIZE = 3;
 constexpr static const uint64_t MEMORY_REGION_LENGTH = 2 << 20;
 constexpr static const int WAITING_PENDING_INPUT_MAX_RETRIES = 20;
+constexpr static const int WAITING_INSPECT_REPLICAS_MAX_RETRIES = 300;
 static const path MANAGER_ROOT_DIR = "/tmp/server-manager-root"; // NOLINT: ignore static initialization warning
 
 class ServerManagerClient {
@@ -97,6 +104,20 @@ public:
         return m_stub->AdvanceState(&context, request, &response);
     }
 
+    Status advance_state_batch(const std::vector<AdvanceStateRequest> &requests) {
+        ClientContext context;
+        Void response;
+        init_client_context(context);
+        auto writer = m_stub->AdvanceStateBatch(&context, &response);
+        for (const auto &request : requests) {
+            if (!writer->Write(request)) {
+                break;
+            }
+        }
+        writer->WritesDone();
+        return writer->Finish();
+    }
+
     Status get_status(GetStatusResponse &response) {
         ClientContext context;
         Void request;
@@ -116,6 +137,17 @@ public:
         return m_stub->GetEpochStatus(&context, request, &response);
     }
 
+    Status watch_epoch(const WatchEpochRequest &request, std::vector<WatchEpochResponse> &responses) {
+        ClientContext context;
+        init_client_context(context);
+        auto reader = m_stub->WatchEpoch(&context, request);
+        WatchEpochResponse response;
+        while (reader->Read(&response)) {
+            responses.push_back(response);
+        }
+        return reader->Finish();
+    }
+
     Status inspect_state(const InspectStateRequest &request, InspectStateResponse &response) {
         ClientContext context;
         init_client_context(context);
@@ -128,6 +160,26 @@ public:
         return m_stub->FinishEpoch(&context, request, &response);
     }
 
+    Status finish_epoch_stream(const FinishEpochRequest &request, FinishEpochResponse &response,
+        uint64_t &message_count) {
+        ClientContext context;
+        init_client_context(context);
+        auto reader = m_stub->FinishEpochStream(&context, request);
+        FinishEpochResponse message;
+        message_count = 0;
+        while (reader->Read(&message)) {
+            response.MergeFrom(message);
+            ++message_count;
+        }
+        return reader->Finish();
+    }
+
+    Status get_output_proof(const GetOutputProofRequest &request, GetOutputProofResponse &response) {
+        ClientContext context;
+        init_client_context(context);
+        return m_stub->GetOutputProof(&context, request, &response);
+    }
+
     Status delete_epoch(const DeleteEpochRequest &request) {
         ClientContext context;
         Void response;
@@ -563,6 +615,36 @@ void assert_bool(bool value, const std::string &msg, const std::string &file, in
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define ASSERT_STATUS_CODE(s, f, v) assert_status_code(s, f, v, __FILE__, __LINE__)
 
+static void test_proof_verification(const std::function<void(const std::string &title, test_function f)> &test) {
+    test("Should reject a batch with a proof with one corrupted sibling", [](ServerManagerClient &) {
+        cryptopp_keccak_256_hasher h;
+        cartesi::complete_merkle_tree tree{LOG2_ROOT_SIZE, LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE};
+        for (uint64_t i = 0; i < 16; ++i) {
+            tree.push_back(get_voucher_keccak_hash(h, i));
+        }
+        std::vector<cartesi::complete_merkle_tree::proof_type> proofs;
+        for (uint64_t i = 0; i < tree.size(); ++i) {
+            proofs.push_back(tree.get_proof(i << LOG2_KECCAK_SIZE, LOG2_KECCAK_SIZE));
+        }
+        cartesi::batch_proof_verifier<cartesi::complete_merkle_tree::hash_type> verifier;
+        for (const auto &p : proofs) {
+            verifier.add(p);
+        }
+        ASSERT(verifier.verify(cryptopp_keccak_256_hasher{}), "batch of valid proofs should verify");
+
+        // corrupt a single sibling of one proof, in a level shared with its neighbours
+        auto &corrupted = proofs[5];
+        auto sibling = corrupted.get_sibling_hash(LOG2_KECCAK_SIZE + 2);
+        sibling[0] ^= 1;
+        corrupted.set_sibling_hash(sibling, LOG2_KECCAK_SIZE + 2);
+        ASSERT(!corrupted.verify(h), "proof with a corrupted sibling should not verify on its own");
+        size_t invalid = 0;
+        ASSERT(!verifier.verify(cryptopp_keccak_256_hasher{}, &invalid),
+            "batch with a corrupted proof should not verify");
+        ASSERT(invalid == 5, "batch should report the corrupted proof (got " + std::to_string(invalid) + ")");
+    });
+}
+
 static void test_get_version(const std::function<void(const std::string &title, test_function f)> &test) {
     test("The server-manager server version should be 0.9.x", [](ServerManagerClient &manager) {
         Versioning::GetVersionResponse response;
@@ -832,6 +914,28 @@ static void test_start_session(const std::function<void(const std::string &title
         ASSERT_STATUS(status, "StartSession", false);
         ASSERT_STATUS_CODE(status, "StartSession", StatusCode::INTERNAL);
     });
+
+    test("Should fail to complete a request if inspect_replica_count is too large", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        session_request.set_inspect_replica_count(1000);
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", false);
+        ASSERT_STATUS_CODE(status, "StartSession", StatusCode::INVALID_ARGUMENT);
+    });
+
+    test("Should fail to complete a request if a weighted inspect schedule has zero weight",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request();
+            StartSessionResponse session_response;
+            auto *schedule = session_request.mutable_inspect_schedule();
+            schedule->set_policy(InspectSchedulePolicy::WEIGHTED);
+            schedule->set_input_weight(1);
+            schedule->set_inspect_weight(0);
+            Status status = manager.start_session(session_request, session_response);
+            ASSERT_STATUS(status, "StartSession", false);
+            ASSERT_STATUS_CODE(status, "StartSession", StatusCode::INVALID_ARGUMENT);
+        });
 }
 
 static void wait_pending_inputs_to_be_processed(ServerManagerClient &manager, GetEpochStatusRequest &status_request,
@@ -856,6 +960,40 @@ static void wait_pending_inputs_to_be_processed(ServerManagerClient &manager, Ge
     }
 }
 
+static void wait_inspect_replicas_ready(ServerManagerClient &manager, const std::string &session_id,
+    uint64_t replica_count, int retries) {
+    GetSessionStatusRequest status_request;
+    status_request.set_session_id(session_id);
+    for (;;) {
+        GetSessionStatusResponse status_response;
+        Status status = manager.get_session_status(status_request, status_response);
+        ASSERT_STATUS(status, "GetSessionStatus", true);
+        ASSERT(status_response.inspect_replica_count() == replica_count, "inspect replicas should not be dropped");
+        if (status_response.ready_inspect_replica_count() == replica_count) {
+            break;
+        }
+        ASSERT((retries > 0), "wait_inspect_replicas_ready max retries reached");
+        std::this_thread::sleep_for(100ms);
+        retries--;
+    }
+}
+
+static void wait_inspect_replicas_held(ServerManagerClient &manager, const std::string &session_id, int retries) {
+    GetSessionStatusRequest status_request;
+    status_request.set_session_id(session_id);
+    for (;;) {
+        GetSessionStatusResponse status_response;
+        Status status = manager.get_session_status(status_request, status_response);
+        ASSERT_STATUS(status, "GetSessionStatus", true);
+        if (status_response.ready_inspect_replica_count() == 0) {
+            break;
+        }
+        ASSERT((retries > 0), "wait_inspect_replicas_held max retries reached");
+        std::this_thread::sleep_for(100ms);
+        retries--;
+    }
+}
+
 static machine_merkle_tree::proof_type assemble_merkle_proof(int log2_root_size,
     const machine_merkle_tree::hash_type &target_hash, const machine_merkle_tree::hash_type &root_hash,
     const google::protobuf::RepeatedPtrField<::CartesiMachine::Hash> &siblings, uint64_t input_index) {
@@ -919,7 +1057,8 @@ static uint64_t get_abi_encoded_context(const std::string &context) {
 }
 
 static void verify_proof(FinishEpochResponse &response, const Proof &proof, uint64_t epoch_index,
-    const cartesi::complete_merkle_tree &vouchers_tree, const cartesi::complete_merkle_tree &notices_tree) {
+    const cartesi::complete_merkle_tree &vouchers_tree, const cartesi::complete_merkle_tree &notices_tree,
+    std::vector<machine_merkle_tree::proof_type> &merkle_proofs) {
     ASSERT(!proof.context().empty(), "Proof should have a valid context");
     ASSERT(get_abi_encoded_context(proof.context()) == epoch_index,
         "Proof context should match ABI encoded epoch index");
@@ -967,6 +1106,7 @@ static void verify_proof(FinishEpochResponse &response, const Proof &proof, uint
         ASSERT(p1.verify(h),
             "OutputValidityProof output_hashes_root_hash and output_hash_in_output_hashes_siblings verification "
             "failed");
+        merkle_proofs.push_back(std::move(p1));
 
         const auto &output_epoch_root_hash = get_proto_hash(validity.vouchers_epoch_root_hash());
         ASSERT(output_epoch_root_hash == vouchers_tree.get_root_hash(),
@@ -976,6 +1116,7 @@ static void verify_proof(FinishEpochResponse &response, const Proof &proof, uint
             output_hashes_in_epoch_siblings, validity.input_index_within_epoch());
         ASSERT(p2.verify(h),
             "OutputValidityProof vouchers_epoch_root_hash and output_hashes_in_epoch_siblings verification failed");
+        merkle_proofs.push_back(std::move(p2));
 
     } else {
         ASSERT(output_hashes_root_hash ==
@@ -988,6 +1129,7 @@ static void verify_proof(FinishEpochResponse &response, const Proof &proof, uint
         ASSERT(p1.verify(h),
             "OutputValidityProof output_hashes_root_hash and output_hash_in_output_hashes_siblings verification "
             "failed");
+        merkle_proofs.push_back(std::move(p1));
 
         const auto &output_epoch_root_hash = get_proto_hash(validity.notices_epoch_root_hash());
         ASSERT(output_epoch_root_hash == notices_tree.get_root_hash(),
@@ -997,6 +1139,7 @@ static void verify_proof(FinishEpochResponse &response, const Proof &proof, uint
             output_hashes_in_epoch_siblings, validity.input_index_within_epoch());
         ASSERT(p2.verify(h),
             "OutputValidityProof notices_epoch_root_hash and output_hashes_in_epoch_siblings verification failed");
+        merkle_proofs.push_back(std::move(p2));
     }
 }
 
@@ -1019,9 +1162,72 @@ static void validate_finish_epoch_response(FinishEpochResponse &response, uint64
     ASSERT(get_proto_hash(response.notices_epoch_root_hash()) == notices_tree.get_root_hash(),
         "Received notices epoch root hash should match the calculated one");
 
-    // Verify proofs
+    // Verify proofs one by one, then check all Merkle proofs again in one batch
+    std::vector<machine_merkle_tree::proof_type> merkle_proofs;
+    merkle_proofs.reserve(2 * response.proofs_size());
     for (const auto &proof : response.proofs()) {
-        verify_proof(response, proof, epoch_index, vouchers_tree, notices_tree);
+        verify_proof(response, proof, epoch_index, vouchers_tree, notices_tree, merkle_proofs);
+    }
+    cartesi::batch_proof_verifier<machine_merkle_tree::hash_type> verifier;
+    for (const auto &p : merkle_proofs) {
+        verifier.add(p);
+    }
+    size_t invalid = 0;
+    ASSERT(verifier.verify(cryptopp_keccak_256_hasher{}, &invalid),
+        "OutputValidityProof verification failed for proof " + std::to_string(invalid / 2) +
+            (invalid % 2 == 0 ? " (output hash in output hashes)" : " (output hashes in epoch)"));
+}
+
+static void add_expanded_compact_proofs(FinishEpochResponse &response, const CompactInputProofs &input,
+    OutputEnum output_enum, uint64_t count, const std::string &root_hash, const std::string &in_epoch_siblings,
+    const std::string &in_hashes_siblings) {
+    const size_t hash_size = sizeof(machine_merkle_tree::hash_type);
+    if (count == 0) {
+        ASSERT(root_hash.empty() && in_epoch_siblings.empty() && in_hashes_siblings.empty(),
+            "Compact proofs of an input without outputs should be empty");
+        return;
+    }
+    ASSERT(root_hash.size() == hash_size, "Compact proofs should have a valid output hashes root hash");
+    ASSERT(in_epoch_siblings.size() == (LOG2_ROOT_SIZE - LOG2_KECCAK_SIZE) * hash_size,
+        "Compact proofs should have one output hashes in epoch path per input");
+    ASSERT(!in_hashes_siblings.empty() && in_hashes_siblings.size() % (count * hash_size) == 0,
+        "Compact proofs should have one output hash in output hashes path per output");
+    const auto path_size = in_hashes_siblings.size() / count;
+    for (uint64_t output_index = 0; output_index < count; ++output_index) {
+        auto *proof = response.add_proofs();
+        proof->set_input_index(input.input_index());
+        proof->set_output_index(output_index);
+        proof->set_output_enum(output_enum);
+        proof->set_context(response.compact_proofs().context());
+        auto *validity = proof->mutable_validity();
+        validity->set_input_index_within_epoch(input.input_index_within_epoch());
+        validity->set_output_index_within_input(output_index);
+        validity->mutable_output_hashes_root_hash()->set_data(root_hash);
+        *validity->mutable_vouchers_epoch_root_hash() = response.vouchers_epoch_root_hash();
+        *validity->mutable_notices_epoch_root_hash() = response.notices_epoch_root_hash();
+        *validity->mutable_machine_state_hash() = response.machine_hash();
+        for (size_t offset = 0; offset < path_size; offset += hash_size) {
+            validity->add_output_hash_in_output_hashes_siblings()->set_data(
+                in_hashes_siblings.substr(output_index * path_size + offset, hash_size));
+        }
+        for (size_t offset = 0; offset < in_epoch_siblings.size(); offset += hash_size) {
+            validity->add_output_hashes_in_epoch_siblings()->set_data(in_epoch_siblings.substr(offset, hash_size));
+        }
+    }
+}
+
+// Expands the compact proofs of a FinishEpochResponse into the Proof messages a regular response would have
+static void expand_compact_proofs(FinishEpochResponse &response) {
+    ASSERT(response.has_compact_proofs(), "Finish epoch response should have compact proofs");
+    ASSERT(response.proofs_size() == 0, "Finish epoch response with compact proofs should have no Proof messages");
+    for (const auto &input : response.compact_proofs().inputs()) {
+        ASSERT(input.voucher_count() + input.notice_count() > 0, "Compact proofs should only list inputs with outputs");
+        add_expanded_compact_proofs(response, input, OutputEnum::VOUCHER, input.voucher_count(),
+            input.voucher_hashes_root_hash(), input.voucher_hashes_in_epoch_siblings(),
+            input.voucher_hash_in_voucher_hashes_siblings());
+        add_expanded_compact_proofs(response, input, OutputEnum::NOTICE, input.notice_count(),
+            input.notice_hashes_root_hash(), input.notice_hashes_in_epoch_siblings(),
+            input.notice_hash_in_notice_hashes_siblings());
     }
 }
 
@@ -1428,6 +1634,107 @@ static void test_advance_state(const std::function<void(const std::string &title
         });
 }
 
+static void test_advance_state_batch(const std::function<void(const std::string &title, test_function f)> &test) {
+    test("Should complete a valid batch with success", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue batch
+        std::vector<AdvanceStateRequest> advance_requests(3);
+        for (uint64_t i = 0; i < advance_requests.size(); ++i) {
+            init_valid_advance_state_request(advance_requests[i], session_request.session_id(),
+                session_request.active_epoch_index(), i);
+        }
+        status = manager.advance_state_batch(advance_requests);
+        ASSERT_STATUS(status, "AdvanceStateBatch", true);
+
+        // the next input follows the batch
+        AdvanceStateRequest advance_request;
+        init_valid_advance_state_request(advance_request, session_request.session_id(),
+            session_request.active_epoch_index(), advance_requests.size());
+        status = manager.advance_state(advance_request);
+        ASSERT_STATUS(status, "AdvanceState", true);
+
+        // all inputs are processed
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+            WAITING_PENDING_INPUT_MAX_RETRIES);
+        ASSERT(status_response.processed_inputs_size() == 4, "all inputs in batch should be processed");
+
+        end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+            session_request.active_epoch_index());
+    });
+
+    test("Should fail to complete an empty batch", [](ServerManagerClient &manager) {
+        std::vector<AdvanceStateRequest> advance_requests;
+        Status status = manager.advance_state_batch(advance_requests);
+        ASSERT_STATUS(status, "AdvanceStateBatch", false);
+        ASSERT_STATUS_CODE(status, "AdvanceStateBatch", StatusCode::INVALID_ARGUMENT);
+    });
+
+    test("Should enqueue no input if any input index is not sequential", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue batch with a gap
+        std::vector<AdvanceStateRequest> advance_requests(3);
+        for (uint64_t i = 0; i < advance_requests.size(); ++i) {
+            init_valid_advance_state_request(advance_requests[i], session_request.session_id(),
+                session_request.active_epoch_index(), i);
+        }
+        advance_requests[2].set_current_input_index(advance_requests[2].current_input_index() + 10);
+        status = manager.advance_state_batch(advance_requests);
+        ASSERT_STATUS(status, "AdvanceStateBatch", false);
+        ASSERT_STATUS_CODE(status, "AdvanceStateBatch", StatusCode::INVALID_ARGUMENT);
+
+        // no input was enqueued
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        status = manager.get_epoch_status(status_request, status_response);
+        ASSERT_STATUS(status, "GetEpochStatus", true);
+        ASSERT(status_response.processed_inputs_size() == 0, "processed inputs should be empty");
+        ASSERT(status_response.pending_input_count() == 0, "pending input count should be zero");
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should fail to complete if session id is not the same for all inputs", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        std::vector<AdvanceStateRequest> advance_requests(2);
+        for (uint64_t i = 0; i < advance_requests.size(); ++i) {
+            init_valid_advance_state_request(advance_requests[i], session_request.session_id(),
+                session_request.active_epoch_index(), i);
+        }
+        advance_requests[1].set_session_id(session_request.session_id() + "-other");
+        status = manager.advance_state_batch(advance_requests);
+        ASSERT_STATUS(status, "AdvanceStateBatch", false);
+        ASSERT_STATUS_CODE(status, "AdvanceStateBatch", StatusCode::INVALID_ARGUMENT);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+}
+
 static void test_get_status(const std::function<void(const std::string &title, test_function f)> &test) {
     test("Should complete a valid request with success", [](ServerManagerClient &manager) {
         GetStatusResponse status_response;
@@ -1436,6 +1743,41 @@ static void test_get_status(const std::function<void(const std::string &title, t
         ASSERT(status_response.session_id_size() == 0, "status response should be empty");
     });
 
+    test("Should report handler and coroutine stack counters", [](ServerManagerClient &manager) {
+        GetStatusResponse status_response;
+        Status status = manager.get_status(status_response);
+        ASSERT_STATUS(status, "GetStatus", true);
+        ASSERT(status_response.has_handler_statistics(), "status response should have handler statistics");
+        const auto &stats = status_response.handler_statistics();
+        // at least one handler per RPC is waiting, plus the one serving this request
+        ASSERT(stats.live_handler_count() > 1, "status response should count live handlers");
+        ASSERT(stats.stacks_in_use() > 0 && stats.stack_bytes_in_use() > 0,
+            "status response should count coroutine stacks in use");
+        ASSERT(stats.stack_allocation_count() >= stats.stacks_in_use(),
+            "every stack in use should have been allocated");
+        ASSERT(stats.stack_reuse_count() <= stats.stack_allocation_count(),
+            "reused stacks should not outnumber allocated stacks");
+    });
+
+    test("Should report how RPCs found handlers waiting for them", [](ServerManagerClient &manager) {
+        GetStatusResponse status_response;
+        Status status = manager.get_status(status_response);
+        ASSERT_STATUS(status, "GetStatus", true);
+        status = manager.get_status(status_response);
+        ASSERT_STATUS(status, "GetStatus", true);
+        const auto &accept = status_response.handler_statistics().accept();
+        auto it = std::find_if(accept.begin(), accept.end(), [](const auto &a) { return a.rpc() == "GetStatus"; });
+        ASSERT(it != accept.end(), "status response should have accept statistics for GetStatus");
+        ASSERT(it->depth() >= 1, "GetStatus should have at least one handler waiting");
+        ASSERT(it->arrival_count() >= 2, "GetStatus arrivals should include both requests");
+        ASSERT(it->exhausted_count() <= it->arrival_count(),
+            "GetStatus cannot run out of handlers more often than RPCs arrive");
+        for (const auto &a : accept) {
+            ASSERT(a.rpc() != "InspectReplica" && a.rpc() != "CheckInDeadline",
+                "internal handlers should have no accept statistics");
+        }
+    });
+
     test("Should complete with success when there is one session", [](ServerManagerClient &manager) {
         StartSessionRequest session_request = create_valid_start_session_request();
         StartSessionResponse session_response;
@@ -1538,6 +1880,102 @@ static void test_get_session_status(const std::function<void(const std::string &
         ASSERT_STATUS(status, "EndSession", true);
     });
 
+    test("Should complete with inspect schedule statistics", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        auto *schedule = session_request.mutable_inspect_schedule();
+        schedule->set_policy(InspectSchedulePolicy::WEIGHTED);
+        schedule->set_input_weight(2);
+        schedule->set_inspect_weight(1);
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue
+        AdvanceStateRequest advance_request;
+        for (uint64_t i = 0; i < 2; ++i) {
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), i);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
+        }
+
+        // inspect while inputs are processed
+        InspectStateRequest inspect_request;
+        init_valid_inspect_state_request(inspect_request, session_request.session_id(), 0);
+        InspectStateResponse inspect_response;
+        status = manager.inspect_state(inspect_request, inspect_response);
+        ASSERT_STATUS(status, "InspectState", true);
+
+        GetEpochStatusRequest epoch_status_request;
+        epoch_status_request.set_session_id(session_request.session_id());
+        epoch_status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse epoch_status_response;
+        wait_pending_inputs_to_be_processed(manager, epoch_status_request, epoch_status_response, false, 10);
+
+        GetSessionStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        GetSessionStatusResponse status_response;
+        status = manager.get_session_status(status_request, status_response);
+        ASSERT_STATUS(status, "GetSessionStatus", true);
+        const auto &stats = status_response.inspect_schedule_statistics();
+        ASSERT(stats.input_count() == 2, "statistics should count processed inputs");
+        ASSERT(stats.inspect_count() == 1, "statistics should count processed queries");
+        ASSERT(stats.max_inspect_wait_us() <= stats.total_inspect_wait_us(),
+            "longest query wait should not exceed total query wait");
+        ASSERT(stats.max_input_lag_us() <= stats.total_input_lag_us(),
+            "longest input lag should not exceed total input lag");
+
+        end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+            session_request.active_epoch_index());
+    });
+
+    test("Should complete with inspect schedule statistics when queries go before inputs",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request();
+            auto *schedule = session_request.mutable_inspect_schedule();
+            schedule->set_policy(InspectSchedulePolicy::INSPECT_PRIORITY);
+            schedule->set_max_input_latency_ms(1000);
+            StartSessionResponse session_response;
+            Status status = manager.start_session(session_request, session_response);
+            ASSERT_STATUS(status, "StartSession", true);
+
+            // enqueue
+            AdvanceStateRequest advance_request;
+            for (uint64_t i = 0; i < 2; ++i) {
+                init_valid_advance_state_request(advance_request, session_request.session_id(),
+                    session_request.active_epoch_index(), i);
+                status = manager.advance_state(advance_request);
+                ASSERT_STATUS(status, "AdvanceState", true);
+            }
+
+            // inspect while inputs are processed
+            InspectStateRequest inspect_request;
+            init_valid_inspect_state_request(inspect_request, session_request.session_id(), 0);
+            InspectStateResponse inspect_response;
+            status = manager.inspect_state(inspect_request, inspect_response);
+            ASSERT_STATUS(status, "InspectState", true);
+            ASSERT(inspect_response.processed_input_count() <= 2,
+                "processed_input_count should not exceed number of inputs");
+
+            GetEpochStatusRequest epoch_status_request;
+            epoch_status_request.set_session_id(session_request.session_id());
+            epoch_status_request.set_epoch_index(session_request.active_epoch_index());
+            GetEpochStatusResponse epoch_status_response;
+            wait_pending_inputs_to_be_processed(manager, epoch_status_request, epoch_status_response, false, 10);
+
+            GetSessionStatusRequest status_request;
+            status_request.set_session_id(session_request.session_id());
+            GetSessionStatusResponse status_response;
+            status = manager.get_session_status(status_request, status_response);
+            ASSERT_STATUS(status, "GetSessionStatus", true);
+            const auto &stats = status_response.inspect_schedule_statistics();
+            ASSERT(stats.input_count() == 2, "statistics should count processed inputs");
+            ASSERT(stats.inspect_count() == 1, "statistics should count processed queries");
+
+            end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+                session_request.active_epoch_index());
+        });
+
     test("Should fail to complete with a invalid session id", [](ServerManagerClient &manager) {
         GetSessionStatusRequest status_request;
         status_request.set_session_id("NON-EXISTENT");
@@ -1847,7 +2285,50 @@ static void test_get_epoch_status(const std::function<void(const std::string &ti
             session_request.active_epoch_index());
     });
 
-    test("Should complete with processed input count equal 1 after processing enqueued input",
+    test("Should complete while inputs are being processed", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue
+        const uint64_t input_count = 3;
+        AdvanceStateRequest advance_request;
+        for (uint64_t i = 0; i < input_count; ++i) {
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), i);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
+        }
+
+        // read statuses until all inputs are processed, none of them should be rejected
+        GetSessionStatusRequest session_status_request;
+        session_status_request.set_session_id(session_request.session_id());
+        GetSessionStatusResponse session_status_response;
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        for (int retries = WAITING_PENDING_INPUT_MAX_RETRIES;; --retries) {
+            status = manager.get_session_status(session_status_request, session_status_response);
+            ASSERT_STATUS(status, "GetSessionStatus", true);
+            status = manager.get_epoch_status(status_request, status_response);
+            ASSERT_STATUS(status, "GetEpochStatus", true);
+            const auto processed_input_count = static_cast<uint64_t>(status_response.processed_inputs_size());
+            ASSERT(processed_input_count + status_response.pending_input_count() == input_count,
+                "processed and pending inputs should add up to enqueued inputs");
+            if (status_response.pending_input_count() == 0) {
+                break;
+            }
+            ASSERT((retries > 0), "max retries reached");
+            std::this_thread::sleep_for(1s);
+        }
+
+        end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+            session_request.active_epoch_index());
+    });
+
+    test("Should return the requested range of processed inputs and where the next one starts",
         [](ServerManagerClient &manager) {
             StartSessionRequest session_request = create_valid_start_session_request();
             StartSessionResponse session_response;
@@ -1856,40 +2337,135 @@ static void test_get_epoch_status(const std::function<void(const std::string &ti
 
             // enqueue
             AdvanceStateRequest advance_request;
-            init_valid_advance_state_request(advance_request, session_request.session_id(),
-                session_request.active_epoch_index(), 0);
-            status = manager.advance_state(advance_request);
-            ASSERT_STATUS(status, "AdvanceState", true);
+            for (uint64_t i = 0; i < 3; ++i) {
+                init_valid_advance_state_request(advance_request, session_request.session_id(),
+                    session_request.active_epoch_index(), i);
+                status = manager.advance_state(advance_request);
+                ASSERT_STATUS(status, "AdvanceState", true);
+            }
 
-            // get epoch status after pending input is processed
+            // wait for inputs to be processed
             GetEpochStatusRequest status_request;
             status_request.set_session_id(session_request.session_id());
             status_request.set_epoch_index(session_request.active_epoch_index());
             GetEpochStatusResponse status_response;
             wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
                 WAITING_PENDING_INPUT_MAX_RETRIES);
+            ASSERT(status_response.next_processed_input_index() == 3, "cursor should be after the last input");
 
-            // assert status_response content
-            ASSERT(status_response.session_id() == session_request.session_id(),
-                "status response session_id should be the same as the one created");
-            ASSERT(status_response.epoch_index() == session_request.active_epoch_index(),
-                "status response epoch_index should be 0");
-            ASSERT(status_response.state() == EpochState::ACTIVE, "status response state should be ACTIVE");
-            ASSERT(status_response.processed_inputs_size() == 1, "status response processed_inputs size should be 1");
-            ASSERT(status_response.pending_input_count() == 0, "status response pending_input_count should 0");
-            ASSERT(!status_response.has_taint_status(), "status response should not be tainted");
-
+            // get a page in the middle
+            status_request.set_processed_input_index(1);
+            status_request.set_processed_input_limit(1);
+            status = manager.get_epoch_status(status_request, status_response);
+            ASSERT_STATUS(status, "GetEpochStatus", true);
+            ASSERT(status_response.processed_inputs_size() == 1, "status response should be limited to 1 input");
             auto processed_input = (status_response.processed_inputs())[0];
-            check_processed_input(processed_input, 0, 2, 2, 2);
-
-            // Finish epoch
-            FinishEpochRequest epoch_request;
-            FinishEpochResponse epoch_response;
-            init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
-                session_request.active_epoch_index(), status_response.processed_inputs_size());
-            status = manager.finish_epoch(epoch_request, epoch_response);
-            ASSERT_STATUS(status, "FinishEpoch", true);
-            validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), 1);
+            check_processed_input(processed_input, 1, 2, 2, 2);
+            ASSERT(status_response.next_processed_input_index() == 2, "cursor should be after the returned input");
+
+            // get the rest
+            status_request.set_processed_input_index(status_response.next_processed_input_index());
+            status_request.set_processed_input_limit(10);
+            status = manager.get_epoch_status(status_request, status_response);
+            ASSERT_STATUS(status, "GetEpochStatus", true);
+            ASSERT(status_response.processed_inputs_size() == 1, "status response should have the last input");
+            ASSERT(status_response.next_processed_input_index() == 3, "cursor should be after the last input");
+
+            // nothing changed since the last call
+            status_request.set_processed_input_index(status_response.next_processed_input_index());
+            status = manager.get_epoch_status(status_request, status_response);
+            ASSERT_STATUS(status, "GetEpochStatus", true);
+            ASSERT(status_response.processed_inputs_size() == 0, "status response should have no inputs");
+            ASSERT(status_response.next_processed_input_index() == 3, "cursor should not move");
+
+            end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+                session_request.active_epoch_index());
+        });
+
+    test("Should omit payloads and reports when asked", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue
+        AdvanceStateRequest advance_request;
+        init_valid_advance_state_request(advance_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        status = manager.advance_state(advance_request);
+        ASSERT_STATUS(status, "AdvanceState", true);
+
+        // wait for input to be processed
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        status_request.set_omit_payloads(true);
+        status_request.set_omit_reports(true);
+        GetEpochStatusResponse status_response;
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+            WAITING_PENDING_INPUT_MAX_RETRIES);
+
+        ASSERT(status_response.processed_inputs_size() == 1, "status response processed_inputs size should be 1");
+        const auto &processed_input = status_response.processed_inputs(0);
+        ASSERT(processed_input.reports_size() == 0, "reports should be omitted");
+        const auto &result = processed_input.accepted_data();
+        ASSERT(result.vouchers_size() == 2, "vouchers should still be listed");
+        ASSERT(result.notices_size() == 2, "notices should still be listed");
+        for (const auto &voucher : result.vouchers()) {
+            ASSERT(voucher.destination().data() == get_voucher_address(0), "voucher address should match");
+            ASSERT(voucher.payload().empty(), "voucher payload should be omitted");
+        }
+        for (const auto &notice : result.notices()) {
+            ASSERT(notice.payload().empty(), "notice payload should be omitted");
+        }
+
+        end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+            session_request.active_epoch_index());
+    });
+
+    test("Should complete with processed input count equal 1 after processing enqueued input",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request();
+            StartSessionResponse session_response;
+            Status status = manager.start_session(session_request, session_response);
+            ASSERT_STATUS(status, "StartSession", true);
+
+            // enqueue
+            AdvanceStateRequest advance_request;
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), 0);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
+
+            // get epoch status after pending input is processed
+            GetEpochStatusRequest status_request;
+            status_request.set_session_id(session_request.session_id());
+            status_request.set_epoch_index(session_request.active_epoch_index());
+            GetEpochStatusResponse status_response;
+            wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+                WAITING_PENDING_INPUT_MAX_RETRIES);
+
+            // assert status_response content
+            ASSERT(status_response.session_id() == session_request.session_id(),
+                "status response session_id should be the same as the one created");
+            ASSERT(status_response.epoch_index() == session_request.active_epoch_index(),
+                "status response epoch_index should be 0");
+            ASSERT(status_response.state() == EpochState::ACTIVE, "status response state should be ACTIVE");
+            ASSERT(status_response.processed_inputs_size() == 1, "status response processed_inputs size should be 1");
+            ASSERT(status_response.pending_input_count() == 0, "status response pending_input_count should 0");
+            ASSERT(!status_response.has_taint_status(), "status response should not be tainted");
+
+            auto processed_input = (status_response.processed_inputs())[0];
+            check_processed_input(processed_input, 0, 2, 2, 2);
+
+            // Finish epoch
+            FinishEpochRequest epoch_request;
+            FinishEpochResponse epoch_response;
+            init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+                session_request.active_epoch_index(), status_response.processed_inputs_size());
+            status = manager.finish_epoch(epoch_request, epoch_response);
+            ASSERT_STATUS(status, "FinishEpoch", true);
+            validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), 1);
 
             // EndSession
             EndSessionRequest end_session_request;
@@ -2622,6 +3198,130 @@ static void check_inspect_state_response(InspectStateResponse &response, const s
     }
 }
 
+static void check_watch_epoch_responses(const std::vector<WatchEpochResponse> &responses,
+    uint64_t first_input_index, uint64_t input_count) {
+    ASSERT(responses.size() == input_count + 1, "watch should stream each processed input and the epoch state");
+    for (uint64_t i = 0; i < input_count; ++i) {
+        ASSERT(responses[i].has_processed_input(), "watch should stream processed inputs first");
+        ASSERT(responses[i].processed_input().input_index() == first_input_index + i,
+            "watch should stream processed inputs in order");
+    }
+    ASSERT(responses.back().WatchEpochOneOf_case() == WatchEpochResponse::kState &&
+            responses.back().state() == EpochState::FINISHED,
+        "watch should end with the epoch finished");
+}
+
+static void test_watch_epoch(const std::function<void(const std::string &title, test_function f)> &test) {
+    test("Should stream processed inputs as they are processed", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // watch before any input arrives
+        WatchEpochRequest watch_request;
+        watch_request.set_session_id(session_request.session_id());
+        watch_request.set_epoch_index(session_request.active_epoch_index());
+        std::vector<WatchEpochResponse> watch_responses;
+        Status watch_status;
+        std::thread watcher([&]() { watch_status = manager.watch_epoch(watch_request, watch_responses); });
+
+        // enqueue
+        AdvanceStateRequest advance_request;
+        for (uint64_t i = 0; i < 2; ++i) {
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), i);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
+        }
+
+        // wait for inputs to be processed
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+            WAITING_PENDING_INPUT_MAX_RETRIES);
+
+        // finish epoch
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), status_response.processed_inputs_size());
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+
+        // the watch ends once the epoch is finished
+        watcher.join();
+        ASSERT_STATUS(watch_status, "WatchEpoch", true);
+        check_watch_epoch_responses(watch_responses, 0, 2);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should stream from the requested processed input", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue
+        AdvanceStateRequest advance_request;
+        for (uint64_t i = 0; i < 2; ++i) {
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), i);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
+        }
+
+        // wait for inputs to be processed
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+            WAITING_PENDING_INPUT_MAX_RETRIES);
+
+        // finish epoch
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), status_response.processed_inputs_size());
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+
+        // watch the finished epoch, skipping the first input
+        WatchEpochRequest watch_request;
+        watch_request.set_session_id(session_request.session_id());
+        watch_request.set_epoch_index(session_request.active_epoch_index());
+        watch_request.set_processed_input_index(1);
+        std::vector<WatchEpochResponse> watch_responses;
+        status = manager.watch_epoch(watch_request, watch_responses);
+        ASSERT_STATUS(status, "WatchEpoch", true);
+        check_watch_epoch_responses(watch_responses, 1, 1);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should fail to complete if session id is not valid", [](ServerManagerClient &manager) {
+        WatchEpochRequest watch_request;
+        watch_request.set_session_id("NON-EXISTENT");
+        watch_request.set_epoch_index(0);
+        std::vector<WatchEpochResponse> watch_responses;
+        Status status = manager.watch_epoch(watch_request, watch_responses);
+        ASSERT_STATUS(status, "WatchEpoch", false);
+        ASSERT_STATUS_CODE(status, "WatchEpoch", StatusCode::INVALID_ARGUMENT);
+    });
+}
+
 static void test_inspect_state(const std::function<void(const std::string &title, test_function f)> &test) {
     test("Should complete a valid request with success", [](ServerManagerClient &manager) {
         StartSessionRequest session_request = create_valid_start_session_request("inspect-state-machine");
@@ -3105,66 +3805,70 @@ static void test_inspect_state(const std::function<void(const std::string &title
         status = manager.end_session(end_session_request);
         ASSERT_STATUS(status, "EndSession", true);
     });
-}
 
-static bool check_session_store(const std::string &machine_dir) {
-    static const std::vector<std::string> files = {
-        "hash", "config.json",
-        "0000000000020000-6000.bin",    // shadow tlb
-        "0000000000600000-200000.bin",  // uarch-ram
-        "0000000060000000-200000.bin",  // rollup rx buffer
-        "0000000060200000-200000.bin",  // rollup tx buffer
-        "0000000060400000-1000.bin",    // rollup input metadata
-        "0000000060600000-200000.bin",  // rollup voucher hashes
-        "0000000060800000-200000.bin",  // rollup notice hashes
-        "000000007ff00000-100000.bin",  // dtb
-        "0000000080000000-4000000.bin", // ram
-        "0080000000000000-6400000.bin"  // root drive
-    };
-    if (machine_dir.empty()) {
-        return false;
-    }
-    path full_path{machine_dir};
-    return std::all_of(files.begin(), files.end(),
-        [&full_path](const std::string &f) { return exists(full_path / f); });
-}
+    test("Should complete concurrent requests with success while an input is processed",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request("inspect-state-machine");
+            StartSessionResponse session_response;
+            Status status = manager.start_session(session_request, session_response);
+            ASSERT_STATUS(status, "StartSession", true);
 
-static void test_finish_epoch(const std::function<void(const std::string &title, test_function f)> &test) {
-    test("Should complete a valid request with success", [](ServerManagerClient &manager) {
-        StartSessionRequest session_request = create_valid_start_session_request();
-        StartSessionResponse session_response;
-        Status status = manager.start_session(session_request, session_response);
-        ASSERT_STATUS(status, "StartSession", true);
+            AdvanceStateRequest advance_request;
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), 0);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
 
-        FinishEpochRequest epoch_request;
-        FinishEpochResponse epoch_response;
-        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
-            session_request.active_epoch_index(), 0);
-        status = manager.finish_epoch(epoch_request, epoch_response);
-        ASSERT_STATUS(status, "FinishEpoch", true);
-        validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), 0);
+            // queries wait for their turn instead of failing
+            InspectStateRequest inspect_request;
+            init_valid_inspect_state_request(inspect_request, session_request.session_id(), 0);
+            std::array<InspectStateResponse, 4> inspect_responses;
+            std::array<Status, 4> inspect_statuses;
+            std::vector<std::thread> inspectors;
+            for (size_t i = 1; i < inspect_responses.size(); ++i) {
+                inspectors.emplace_back([&, i]() {
+                    inspect_statuses[i] = manager.inspect_state(inspect_request, inspect_responses[i]);
+                });
+            }
+            inspect_statuses[0] = manager.inspect_state(inspect_request, inspect_responses[0]);
+            for (auto &inspector : inspectors) {
+                inspector.join();
+            }
+            for (size_t i = 0; i < inspect_responses.size(); ++i) {
+                ASSERT_STATUS(inspect_statuses[i], "InspectState", true);
+                ASSERT(inspect_responses[i].processed_input_count() <= 1,
+                    "processed_input_count should not exceed number of inputs");
+            }
 
-        // end session
-        EndSessionRequest end_session_request;
-        end_session_request.set_session_id(session_request.session_id());
-        status = manager.end_session(end_session_request);
-        ASSERT_STATUS(status, "EndSession", true);
-    });
+            end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+                session_request.active_epoch_index());
+        });
 
-    test("Should fail to complete if session id is not valid", [](ServerManagerClient &manager) {
-        StartSessionRequest session_request = create_valid_start_session_request();
+    test("Should complete concurrent requests with success on inspect replicas", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request("inspect-state-machine");
+        session_request.set_inspect_replica_count(2);
         StartSessionResponse session_response;
         Status status = manager.start_session(session_request, session_response);
         ASSERT_STATUS(status, "StartSession", true);
 
-        FinishEpochRequest epoch_request;
-        FinishEpochResponse epoch_response;
-        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
-            session_request.active_epoch_index(), 0);
-        epoch_request.set_session_id("NON-EXISTENT");
-        status = manager.finish_epoch(epoch_request, epoch_response);
-        ASSERT_STATUS(status, "FinishEpoch", false);
-        ASSERT_STATUS_CODE(status, "FinishEpoch", StatusCode::INVALID_ARGUMENT);
+        // wait for replicas to start in the background
+        wait_inspect_replicas_ready(manager, session_request.session_id(), 2, WAITING_INSPECT_REPLICAS_MAX_RETRIES);
+
+        // inspect concurrently
+        InspectStateRequest inspect_request;
+        init_valid_inspect_state_request(inspect_request, session_request.session_id(), 0);
+        std::array<InspectStateResponse, 2> inspect_responses;
+        std::array<Status, 2> inspect_statuses;
+        std::thread inspector([&]() {
+            inspect_statuses[1] = manager.inspect_state(inspect_request, inspect_responses[1]);
+        });
+        inspect_statuses[0] = manager.inspect_state(inspect_request, inspect_responses[0]);
+        inspector.join();
+        for (size_t i = 0; i < inspect_responses.size(); ++i) {
+            ASSERT_STATUS(inspect_statuses[i], "InspectState", true);
+            check_inspect_state_response(inspect_responses[i], inspect_request.session_id(),
+                session_request.active_epoch_index(), 0, 2);
+        }
 
         // end session
         EndSessionRequest end_session_request;
@@ -3173,22 +3877,336 @@ static void test_finish_epoch(const std::function<void(const std::string &title,
         ASSERT_STATUS(status, "EndSession", true);
     });
 
-    test("Should fail to complete if session id was ended", [](ServerManagerClient &manager) {
-        StartSessionRequest session_request = create_valid_start_session_request();
-        StartSessionResponse session_response;
-        Status status = manager.start_session(session_request, session_response);
-        ASSERT_STATUS(status, "StartSession", true);
+    test("Should complete a valid request with success while inputs are processed on inspect replicas",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request();
+            session_request.set_inspect_replica_count(1);
+            StartSessionResponse session_response;
+            Status status = manager.start_session(session_request, session_response);
+            ASSERT_STATUS(status, "StartSession", true);
 
-        // end session
-        EndSessionRequest end_session_request;
-        end_session_request.set_session_id(session_request.session_id());
-        status = manager.end_session(end_session_request);
-        ASSERT_STATUS(status, "EndSession", true);
+            // enqueue
+            AdvanceStateRequest advance_request;
+            for (uint64_t i = 0; i < 4; ++i) {
+                init_valid_advance_state_request(advance_request, session_request.session_id(),
+                    session_request.active_epoch_index(), i);
+                status = manager.advance_state(advance_request);
+                ASSERT_STATUS(status, "AdvanceState", true);
+            }
 
-        FinishEpochRequest epoch_request;
-        FinishEpochResponse epoch_response;
-        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
-            session_request.active_epoch_index(), 0);
+            // inspect while inputs are processed
+            InspectStateRequest inspect_request;
+            init_valid_inspect_state_request(inspect_request, session_request.session_id(), 0);
+            InspectStateResponse inspect_response;
+            status = manager.inspect_state(inspect_request, inspect_response);
+            ASSERT_STATUS(status, "InspectState", true);
+            ASSERT(inspect_response.processed_input_count() <= 4,
+                "processed_input_count should not exceed number of inputs");
+
+            // wait for inputs to be processed, then inspect the replica that caught up
+            GetEpochStatusRequest status_request;
+            status_request.set_session_id(session_request.session_id());
+            status_request.set_epoch_index(session_request.active_epoch_index());
+            GetEpochStatusResponse status_response;
+            wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+                WAITING_PENDING_INPUT_MAX_RETRIES);
+            wait_inspect_replicas_ready(manager, session_request.session_id(), 1,
+                WAITING_INSPECT_REPLICAS_MAX_RETRIES);
+            status = manager.inspect_state(inspect_request, inspect_response);
+            ASSERT_STATUS(status, "InspectState", true);
+            ASSERT(inspect_response.processed_input_count() == 4,
+                "processed_input_count should reflect all processed inputs");
+
+            // finish epoch, so session can end
+            FinishEpochRequest epoch_request;
+            FinishEpochResponse epoch_response;
+            init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+                session_request.active_epoch_index(), status_response.processed_inputs_size());
+            status = manager.finish_epoch(epoch_request, epoch_response);
+            ASSERT_STATUS(status, "FinishEpoch", true);
+
+            // end session
+            EndSessionRequest end_session_request;
+            end_session_request.set_session_id(session_request.session_id());
+            status = manager.end_session(end_session_request);
+            ASSERT_STATUS(status, "EndSession", true);
+        });
+
+    test("Should complete a stale read request waiting for the only inspect replica held by another request",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request("inspect-state-machine");
+            session_request.set_inspect_replica_count(1);
+            // queries run slowly until they exceed the time limit, so the replica is held for a while
+            CyclesConfig *server_cycles = session_request.mutable_server_cycles();
+            server_cycles->set_inspect_state_increment(10);
+            auto *server_deadline = session_request.mutable_server_deadline();
+            server_deadline->set_inspect_state(1000);
+            server_deadline->set_inspect_state_increment(1000);
+            StartSessionResponse session_response;
+            Status status = manager.start_session(session_request, session_response);
+            ASSERT_STATUS(status, "StartSession", true);
+
+            // wait for replica to start in the background
+            wait_inspect_replicas_ready(manager, session_request.session_id(), 1,
+                WAITING_INSPECT_REPLICAS_MAX_RETRIES);
+
+            // hold the replica with a query, then send a stale read that must wait for it, with no inputs to replay
+            InspectStateRequest holding_request;
+            init_valid_inspect_state_request(holding_request, session_request.session_id(), 0);
+            InspectStateResponse holding_response;
+            Status holding_status;
+            std::thread holder([&]() { holding_status = manager.inspect_state(holding_request, holding_response); });
+            wait_inspect_replicas_held(manager, session_request.session_id(), WAITING_INSPECT_REPLICAS_MAX_RETRIES);
+            InspectStateRequest inspect_request;
+            init_valid_inspect_state_request(inspect_request, session_request.session_id(), 1);
+            inspect_request.set_allow_stale_read(true);
+            InspectStateResponse inspect_response;
+            status = manager.inspect_state(inspect_request, inspect_response);
+            holder.join();
+            ASSERT_STATUS(holding_status, "InspectState", true);
+            ASSERT_STATUS(status, "InspectState", true);
+            ASSERT(inspect_response.processed_input_count() == 0, "processed_input_count should be 0");
+
+            // no query is left waiting, so the session can end
+            EndSessionRequest end_session_request;
+            end_session_request.set_session_id(session_request.session_id());
+            status = manager.end_session(end_session_request);
+            ASSERT_STATUS(status, "EndSession", true);
+        });
+
+    test("Should complete a stale read request with success while inputs are processed on inspect replicas",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request();
+            session_request.set_inspect_replica_count(1);
+            StartSessionResponse session_response;
+            Status status = manager.start_session(session_request, session_response);
+            ASSERT_STATUS(status, "StartSession", true);
+
+            // wait for replica to start in the background
+            wait_inspect_replicas_ready(manager, session_request.session_id(), 1,
+                WAITING_INSPECT_REPLICAS_MAX_RETRIES);
+
+            // enqueue
+            AdvanceStateRequest advance_request;
+            for (uint64_t i = 0; i < 4; ++i) {
+                init_valid_advance_state_request(advance_request, session_request.session_id(),
+                    session_request.active_epoch_index(), i);
+                status = manager.advance_state(advance_request);
+                ASSERT_STATUS(status, "AdvanceState", true);
+            }
+
+            // inspect without waiting for the inputs
+            InspectStateRequest inspect_request;
+            init_valid_inspect_state_request(inspect_request, session_request.session_id(), 0);
+            inspect_request.set_allow_stale_read(true);
+            InspectStateResponse inspect_response;
+            status = manager.inspect_state(inspect_request, inspect_response);
+            ASSERT_STATUS(status, "InspectState", true);
+            ASSERT(inspect_response.processed_input_count() <= 4,
+                "processed_input_count should not exceed number of inputs");
+
+            // wait for inputs to be processed, so the epoch can be finished
+            GetEpochStatusRequest status_request;
+            status_request.set_session_id(session_request.session_id());
+            status_request.set_epoch_index(session_request.active_epoch_index());
+            GetEpochStatusResponse status_response;
+            wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+                WAITING_PENDING_INPUT_MAX_RETRIES);
+            FinishEpochRequest epoch_request;
+            FinishEpochResponse epoch_response;
+            init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+                session_request.active_epoch_index(), status_response.processed_inputs_size());
+            status = manager.finish_epoch(epoch_request, epoch_response);
+            ASSERT_STATUS(status, "FinishEpoch", true);
+
+            // end session
+            EndSessionRequest end_session_request;
+            end_session_request.set_session_id(session_request.session_id());
+            status = manager.end_session(end_session_request);
+            ASSERT_STATUS(status, "EndSession", true);
+        });
+
+    test("Should complete a repeated request with success after an advance state", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request("inspect-state-machine");
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // inspect, then repeat the same query, which is served from the cache
+        InspectStateRequest inspect_request;
+        init_valid_inspect_state_request(inspect_request, session_request.session_id(), 0);
+        InspectStateResponse first_response;
+        status = manager.inspect_state(inspect_request, first_response);
+        ASSERT_STATUS(status, "InspectState", true);
+        InspectStateResponse second_response;
+        status = manager.inspect_state(inspect_request, second_response);
+        ASSERT_STATUS(status, "InspectState", true);
+        check_inspect_state_response(second_response, inspect_request.session_id(),
+            session_request.active_epoch_index(), 0, 2);
+        ASSERT(first_response.reports(0).payload() == second_response.reports(0).payload(),
+            "repeated query should produce the same reports");
+        GetSessionStatusRequest session_status_request;
+        session_status_request.set_session_id(session_request.session_id());
+        GetSessionStatusResponse session_status_response;
+        status = manager.get_session_status(session_status_request, session_status_response);
+        ASSERT_STATUS(status, "GetSessionStatus", true);
+        ASSERT(session_status_response.inspect_cache_hit_count() == 1, "repeated query should be served from cache");
+
+        // advance, so the cached result no longer reflects the machine state
+        AdvanceStateRequest advance_request;
+        init_valid_advance_state_request(advance_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        status = manager.advance_state(advance_request);
+        ASSERT_STATUS(status, "AdvanceState", true);
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false, 10);
+
+        // repeat the query
+        InspectStateResponse third_response;
+        status = manager.inspect_state(inspect_request, third_response);
+        ASSERT_STATUS(status, "InspectState", true);
+        check_inspect_state_response(third_response, inspect_request.session_id(),
+            session_request.active_epoch_index(), 1, 2);
+        status = manager.get_session_status(session_status_request, session_status_response);
+        ASSERT_STATUS(status, "GetSessionStatus", true);
+        ASSERT(session_status_response.inspect_cache_hit_count() == 1,
+            "query after an advance state should not be served from cache");
+
+        end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+            session_request.active_epoch_index());
+    });
+}
+
+static bool check_session_store(const std::string &machine_dir) {
+    static const std::vector<std::string> files = {
+        "hash", "config.json",
+        "0000000000020000-6000.bin",    // shadow tlb
+        "0000000000600000-200000.bin",  // uarch-ram
+        "0000000060000000-200000.bin",  // rollup rx buffer
+        "0000000060200000-200000.bin",  // rollup tx buffer
+        "0000000060400000-1000.bin",    // rollup input metadata
+        "0000000060600000-200000.bin",  // rollup voucher hashes
+        "0000000060800000-200000.bin",  // rollup notice hashes
+        "000000007ff00000-100000.bin",  // dtb
+        "0000000080000000-4000000.bin", // ram
+        "0080000000000000-6400000.bin"  // root drive
+    };
+    if (machine_dir.empty()) {
+        return false;
+    }
+    path full_path{machine_dir};
+    return std::all_of(files.begin(), files.end(),
+        [&full_path](const std::string &f) { return exists(full_path / f); });
+}
+
+static void test_finish_epoch(const std::function<void(const std::string &title, test_function f)> &test) {
+    test("Should complete a valid request with success", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+        validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), 0);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should complete with compact proofs when requested", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue
+        AdvanceStateRequest advance_request;
+        for (uint64_t i = 0; i < 2; ++i) {
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), i);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
+        }
+
+        // wait for inputs to be processed
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+            WAITING_PENDING_INPUT_MAX_RETRIES);
+
+        // finish epoch with compact proofs
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), status_response.processed_inputs_size());
+        epoch_request.set_compact_proofs(true);
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+        ASSERT(epoch_response.compact_proofs().inputs_size() == 2, "compact proofs should list both inputs");
+
+        // the expanded proofs must be the regular ones
+        expand_compact_proofs(epoch_response);
+        ASSERT(epoch_response.proofs_size() == 8, "compact proofs should expand to 2 vouchers and 2 notices per input");
+        validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), 2);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should fail to complete if session id is not valid", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        epoch_request.set_session_id("NON-EXISTENT");
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", false);
+        ASSERT_STATUS_CODE(status, "FinishEpoch", StatusCode::INVALID_ARGUMENT);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should fail to complete if session id was ended", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
         status = manager.finish_epoch(epoch_request, epoch_response);
         ASSERT_STATUS(status, "FinishEpoch", false);
         ASSERT_STATUS_CODE(status, "FinishEpoch", StatusCode::INVALID_ARGUMENT);
@@ -3517,6 +4535,249 @@ static void test_finish_epoch(const std::function<void(const std::string &title,
     });
 }
 
+static void test_finish_epoch_stream(const std::function<void(const std::string &title, test_function f)> &test) {
+    test("Should complete a valid request with success", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        uint64_t message_count = 0;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        status = manager.finish_epoch_stream(epoch_request, epoch_response, message_count);
+        ASSERT_STATUS(status, "FinishEpochStream", true);
+        ASSERT(message_count == 1, "empty epoch should be streamed in a single message");
+        validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), 0);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should fail to complete if compact proofs are requested", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        uint64_t message_count = 0;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        epoch_request.set_compact_proofs(true);
+        status = manager.finish_epoch_stream(epoch_request, epoch_response, message_count);
+        ASSERT_STATUS(status, "FinishEpochStream", false);
+        ASSERT_STATUS_CODE(status, "FinishEpochStream", StatusCode::INVALID_ARGUMENT);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should stream proofs of a large epoch in several messages", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // each input produces 2 vouchers and 2 notices, so 65 inputs take more than one message of 256 proofs
+        std::vector<AdvanceStateRequest> advance_requests(65);
+        for (uint64_t i = 0; i < advance_requests.size(); ++i) {
+            init_valid_advance_state_request(advance_requests[i], session_request.session_id(),
+                session_request.active_epoch_index(), i);
+        }
+        status = manager.advance_state_batch(advance_requests);
+        ASSERT_STATUS(status, "AdvanceStateBatch", true);
+
+        GetEpochStatusRequest status_request;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        GetEpochStatusResponse status_response;
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+            WAITING_PENDING_INPUT_MAX_RETRIES);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        uint64_t message_count = 0;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), advance_requests.size());
+        status = manager.finish_epoch_stream(epoch_request, epoch_response, message_count);
+        ASSERT_STATUS(status, "FinishEpochStream", true);
+        ASSERT(message_count == 2, "proofs should be streamed in 2 messages");
+        ASSERT(epoch_response.proofs_size() == 4 * static_cast<int>(advance_requests.size()),
+            "merged messages should hold a proof for each output");
+        validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), advance_requests.size());
+
+        // the next epoch is active
+        AdvanceStateRequest advance_request;
+        init_valid_advance_state_request(advance_request, session_request.session_id(),
+            session_request.active_epoch_index() + 1, advance_requests.size());
+        status = manager.advance_state(advance_request);
+        ASSERT_STATUS(status, "AdvanceState", true);
+
+        end_session_after_processing_pending_inputs(manager, session_request.session_id(),
+            session_request.active_epoch_index() + 1);
+    });
+
+    test("Should fail to complete if epoch index is already finished", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+
+        FinishEpochResponse stream_response;
+        uint64_t message_count = 0;
+        status = manager.finish_epoch_stream(epoch_request, stream_response, message_count);
+        ASSERT_STATUS(status, "FinishEpochStream", false);
+        ASSERT_STATUS_CODE(status, "FinishEpochStream", StatusCode::INVALID_ARGUMENT);
+        ASSERT(message_count == 0, "failed stream should have no messages");
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+}
+
+static void init_valid_get_output_proof_request(GetOutputProofRequest &request, const std::string &session_id,
+    uint64_t epoch, const Proof &proof) {
+    request.set_session_id(session_id);
+    request.set_epoch_index(epoch);
+    request.set_input_index_within_epoch(proof.validity().input_index_within_epoch());
+    request.set_output_enum(proof.output_enum());
+    request.set_output_index(proof.output_index());
+}
+
+static void test_get_output_proof(const std::function<void(const std::string &title, test_function f)> &test) {
+    test("Should match the proofs returned by FinishEpoch", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        // enqueue
+        const uint64_t input_count = 2;
+        for (uint64_t i = 0; i < input_count; i++) {
+            AdvanceStateRequest advance_request;
+            init_valid_advance_state_request(advance_request, session_request.session_id(),
+                session_request.active_epoch_index(), i);
+            status = manager.advance_state(advance_request);
+            ASSERT_STATUS(status, "AdvanceState", true);
+        }
+
+        GetEpochStatusRequest status_request;
+        GetEpochStatusResponse status_response;
+        status_request.set_session_id(session_request.session_id());
+        status_request.set_epoch_index(session_request.active_epoch_index());
+        wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+            WAITING_PENDING_INPUT_MAX_RETRIES);
+
+        // finish epoch
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), input_count);
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+        validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), input_count);
+        ASSERT(epoch_response.proofs_size() > 0, "FinishEpoch should return proofs");
+
+        // each proof twice, so the second lookup is served from the cache
+        for (int round = 0; round < 2; round++) {
+            for (const auto &proof : epoch_response.proofs()) {
+                GetOutputProofRequest proof_request;
+                GetOutputProofResponse proof_response;
+                init_valid_get_output_proof_request(proof_request, session_request.session_id(),
+                    session_request.active_epoch_index(), proof);
+                status = manager.get_output_proof(proof_request, proof_response);
+                ASSERT_STATUS(status, "GetOutputProof", true);
+                ASSERT(proof_response.proof().SerializeAsString() == proof.SerializeAsString(),
+                    "GetOutputProof should return the same proof as FinishEpoch");
+            }
+        }
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should fail to complete if session id is not valid", [](ServerManagerClient &manager) {
+        GetOutputProofRequest proof_request;
+        GetOutputProofResponse proof_response;
+        init_valid_get_output_proof_request(proof_request, "NON-EXISTENT", 0, Proof{});
+        Status status = manager.get_output_proof(proof_request, proof_response);
+        ASSERT_STATUS(status, "GetOutputProof", false);
+        ASSERT_STATUS_CODE(status, "GetOutputProof", StatusCode::INVALID_ARGUMENT);
+    });
+
+    test("Should fail to complete if epoch is not finished", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        GetOutputProofRequest proof_request;
+        GetOutputProofResponse proof_response;
+        init_valid_get_output_proof_request(proof_request, session_request.session_id(),
+            session_request.active_epoch_index(), Proof{});
+        status = manager.get_output_proof(proof_request, proof_response);
+        ASSERT_STATUS(status, "GetOutputProof", false);
+        ASSERT_STATUS_CODE(status, "GetOutputProof", StatusCode::INVALID_ARGUMENT);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should fail to complete if output does not exist", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        StartSessionResponse session_response;
+        Status status = manager.start_session(session_request, session_response);
+        ASSERT_STATUS(status, "StartSession", true);
+
+        FinishEpochRequest epoch_request;
+        FinishEpochResponse epoch_response;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index(), 0);
+        status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+
+        GetOutputProofRequest proof_request;
+        GetOutputProofResponse proof_response;
+        init_valid_get_output_proof_request(proof_request, session_request.session_id(),
+            session_request.active_epoch_index(), Proof{});
+        status = manager.get_output_proof(proof_request, proof_response);
+        ASSERT_STATUS(status, "GetOutputProof", false);
+        ASSERT_STATUS_CODE(status, "GetOutputProof", StatusCode::INVALID_ARGUMENT);
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+}
+
 static void test_delete_epoch(const std::function<void(const std::string &title, test_function f)> &test) {
     test("Should complete a valid request with success", [](ServerManagerClient &manager) {
         StartSessionRequest session_request = create_valid_start_session_request();
@@ -3764,6 +5025,203 @@ static void test_end_session(const std::function<void(const std::string &title,
         });
 }
 
+// Directory the manager under test moves finished epochs to, empty if it keeps them in memory
+static std::string &get_epoch_storage_directory() {
+    static std::string directory;
+    return directory;
+}
+
+// Same file name the manager gives a finished epoch: hex-encoded session id, then epoch index
+static path get_epoch_file_path(const std::string &session_id, uint64_t epoch_index) {
+    static constexpr const char *digits = "0123456789abcdef";
+    std::string name;
+    for (auto c : session_id) {
+        const auto b = static_cast<unsigned char>(c);
+        name.push_back(digits[b >> 4]);
+        name.push_back(digits[b & 15]);
+    }
+    return path{get_epoch_storage_directory()} / (name + "-" + std::to_string(epoch_index) + ".epoch");
+}
+
+static void process_inputs_in_new_session(ServerManagerClient &manager, const StartSessionRequest &session_request,
+    uint64_t input_count, GetEpochStatusResponse &status_response) {
+    StartSessionResponse session_response;
+    Status status = manager.start_session(session_request, session_response);
+    ASSERT_STATUS(status, "StartSession", true);
+
+    // enqueue
+    for (uint64_t i = 0; i < input_count; i++) {
+        AdvanceStateRequest advance_request;
+        init_valid_advance_state_request(advance_request, session_request.session_id(),
+            session_request.active_epoch_index(), i);
+        status = manager.advance_state(advance_request);
+        ASSERT_STATUS(status, "AdvanceState", true);
+    }
+
+    GetEpochStatusRequest status_request;
+    status_request.set_session_id(session_request.session_id());
+    status_request.set_epoch_index(session_request.active_epoch_index());
+    wait_pending_inputs_to_be_processed(manager, status_request, status_response, false,
+        WAITING_PENDING_INPUT_MAX_RETRIES);
+}
+
+static void finish_epoch_with_inputs(ServerManagerClient &manager, const StartSessionRequest &session_request,
+    uint64_t input_count, FinishEpochResponse &epoch_response) {
+    FinishEpochRequest epoch_request;
+    init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+        session_request.active_epoch_index(), input_count);
+    Status status = manager.finish_epoch(epoch_request, epoch_response);
+    ASSERT_STATUS(status, "FinishEpoch", true);
+    validate_finish_epoch_response(epoch_response, session_request.active_epoch_index(), input_count);
+}
+
+// Checks that a finished epoch is served with the processed inputs it had before FinishEpoch and with the proofs
+// FinishEpoch returned, collecting the serialized answers
+static void check_finished_epoch_answers(ServerManagerClient &manager, const StartSessionRequest &session_request,
+    const GetEpochStatusResponse &active_status, const FinishEpochResponse &epoch_response,
+    std::vector<std::string> &answers) {
+    GetEpochStatusRequest status_request;
+    GetEpochStatusResponse status_response;
+    status_request.set_session_id(session_request.session_id());
+    status_request.set_epoch_index(session_request.active_epoch_index());
+    Status status = manager.get_epoch_status(status_request, status_response);
+    ASSERT_STATUS(status, "GetEpochStatus", true);
+    ASSERT(status_response.state() == EpochState::FINISHED, "status response state should be FINISHED");
+    ASSERT(status_response.processed_inputs_size() == active_status.processed_inputs_size(),
+        "finished epoch should have the same number of processed inputs");
+    for (int i = 0; i < status_response.processed_inputs_size(); i++) {
+        const auto answer = status_response.processed_inputs(i).SerializeAsString();
+        ASSERT(answer == active_status.processed_inputs(i).SerializeAsString(),
+            "finished epoch should have the same processed inputs as before FinishEpoch");
+        answers.push_back(answer);
+    }
+    ASSERT(epoch_response.proofs_size() > 0, "FinishEpoch should return proofs");
+    for (const auto &proof : epoch_response.proofs()) {
+        GetOutputProofRequest proof_request;
+        GetOutputProofResponse proof_response;
+        init_valid_get_output_proof_request(proof_request, session_request.session_id(),
+            session_request.active_epoch_index(), proof);
+        status = manager.get_output_proof(proof_request, proof_response);
+        ASSERT_STATUS(status, "GetOutputProof", true);
+        const auto answer = proof_response.proof().SerializeAsString();
+        ASSERT(answer == proof.SerializeAsString(), "GetOutputProof should return the same proof as FinishEpoch");
+        answers.push_back(answer);
+    }
+}
+
+static void test_epoch_storage(const std::function<void(const std::string &title, test_function f)> &test) {
+    test("Should serve GetEpochStatus and GetOutputProof from the epoch file after FinishEpoch",
+        [](ServerManagerClient &manager) {
+            StartSessionRequest session_request = create_valid_start_session_request();
+            GetEpochStatusResponse active_status;
+            process_inputs_in_new_session(manager, session_request, 2, active_status);
+            const auto epoch_file = get_epoch_file_path(session_request.session_id(), 0);
+            ASSERT(!exists(epoch_file), "active epoch should have no epoch file");
+
+            FinishEpochResponse epoch_response;
+            finish_epoch_with_inputs(manager, session_request, 2, epoch_response);
+            ASSERT(is_regular_file(epoch_file), "finished epoch should be moved to " + epoch_file.string());
+
+            std::vector<std::string> answers;
+            check_finished_epoch_answers(manager, session_request, active_status, epoch_response, answers);
+
+            // end session
+            EndSessionRequest end_session_request;
+            end_session_request.set_session_id(session_request.session_id());
+            Status status = manager.end_session(end_session_request);
+            ASSERT_STATUS(status, "EndSession", true);
+        });
+
+    test("Should remove the epoch file on DeleteEpoch", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        GetEpochStatusResponse active_status;
+        process_inputs_in_new_session(manager, session_request, 2, active_status);
+        FinishEpochResponse epoch_response;
+        finish_epoch_with_inputs(manager, session_request, 2, epoch_response);
+        const auto epoch_file = get_epoch_file_path(session_request.session_id(), 0);
+        ASSERT(is_regular_file(epoch_file), "finished epoch should be moved to " + epoch_file.string());
+
+        DeleteEpochRequest delete_request;
+        delete_request.set_session_id(session_request.session_id());
+        delete_request.set_epoch_index(0);
+        Status status = manager.delete_epoch(delete_request);
+        ASSERT_STATUS(status, "DeleteEpoch", true);
+        ASSERT(!exists(epoch_file), "DeleteEpoch should remove " + epoch_file.string());
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+    });
+
+    test("Should remove the epoch files on EndSession", [](ServerManagerClient &manager) {
+        StartSessionRequest session_request = create_valid_start_session_request();
+        GetEpochStatusResponse active_status;
+        process_inputs_in_new_session(manager, session_request, 2, active_status);
+        FinishEpochResponse epoch_response;
+        finish_epoch_with_inputs(manager, session_request, 2, epoch_response);
+
+        // finish a second, empty epoch
+        FinishEpochRequest epoch_request;
+        init_valid_finish_epoch_request(epoch_request, session_request.session_id(),
+            session_request.active_epoch_index() + 1, 0);
+        Status status = manager.finish_epoch(epoch_request, epoch_response);
+        ASSERT_STATUS(status, "FinishEpoch", true);
+
+        const auto first_epoch_file = get_epoch_file_path(session_request.session_id(), 0);
+        const auto second_epoch_file = get_epoch_file_path(session_request.session_id(), 1);
+        ASSERT(is_regular_file(first_epoch_file), "finished epoch should be moved to " + first_epoch_file.string());
+        ASSERT(is_regular_file(second_epoch_file), "finished epoch should be moved to " + second_epoch_file.string());
+
+        // end session
+        EndSessionRequest end_session_request;
+        end_session_request.set_session_id(session_request.session_id());
+        status = manager.end_session(end_session_request);
+        ASSERT_STATUS(status, "EndSession", true);
+        ASSERT(!exists(first_epoch_file), "EndSession should remove " + first_epoch_file.string());
+        ASSERT(!exists(second_epoch_file), "EndSession should remove " + second_epoch_file.string());
+    });
+
+    test("Should keep the epoch in memory with the same answers when the epoch file cannot be written",
+        [](ServerManagerClient &manager) {
+            // an epoch stored to file, for reference
+            StartSessionRequest stored_request = create_valid_start_session_request();
+            GetEpochStatusResponse stored_status;
+            process_inputs_in_new_session(manager, stored_request, 2, stored_status);
+            FinishEpochResponse stored_response;
+            finish_epoch_with_inputs(manager, stored_request, 2, stored_response);
+            ASSERT(is_regular_file(get_epoch_file_path(stored_request.session_id(), 0)),
+                "finished epoch should be moved to its epoch file");
+            std::vector<std::string> stored_answers;
+            check_finished_epoch_answers(manager, stored_request, stored_status, stored_response, stored_answers);
+
+            // the same inputs in another session, whose epoch file path is taken by a non-empty directory
+            StartSessionRequest memory_request = create_valid_start_session_request();
+            GetEpochStatusResponse memory_status;
+            process_inputs_in_new_session(manager, memory_request, 2, memory_status);
+            const auto blocked = get_epoch_file_path(memory_request.session_id(), 0);
+            create_directories(blocked / "blocked");
+            FinishEpochResponse memory_response;
+            finish_epoch_with_inputs(manager, memory_request, 2, memory_response);
+            ASSERT(is_directory(blocked), "failed epoch file should leave the directory in its path alone");
+            std::vector<std::string> memory_answers;
+            check_finished_epoch_answers(manager, memory_request, memory_status, memory_response, memory_answers);
+            ASSERT(memory_answers == stored_answers, "epoch kept in memory should give the same answers as the file");
+
+            // end sessions
+            EndSessionRequest end_session_request;
+            end_session_request.set_session_id(memory_request.session_id());
+            Status status = manager.end_session(end_session_request);
+            ASSERT_STATUS(status, "EndSession", true);
+            ASSERT(is_directory(blocked), "EndSession should not remove a directory it did not create");
+            remove_all(blocked);
+            end_session_request.set_session_id(stored_request.session_id());
+            status = manager.end_session(end_session_request);
+            ASSERT_STATUS(status, "EndSession", true);
+        });
+}
+
 static void test_session_simulations(const std::function<void(const std::string &title, test_function f)> &test) {
     test("Should EndSession with success after processing two inputs on one epoch", [](ServerManagerClient &manager) {
         StartSessionRequest session_request = create_valid_start_session_request();
@@ -3979,20 +5437,28 @@ static void test_health_check(const std::function<void(const std::string &title,
 static int run_tests(const char *address, const bool fast) {
     ServerManagerClient manager(address);
     test_suite suite(manager);
+    suite.add_test_set("Proof Verification", test_proof_verification);
     suite.add_test_set("GetVersion", test_get_version);
     suite.add_test_set("HealthCheck", test_health_check);
     suite.add_test_set("Session Simulations", test_session_simulations);
     if (!fast) {
         suite.add_test_set("StartSession", test_start_session);
         suite.add_test_set("AdvanceState", test_advance_state);
+        suite.add_test_set("AdvanceStateBatch", test_advance_state_batch);
         suite.add_test_set("GetStatus", test_get_status);
         suite.add_test_set("GetSessionStatus", test_get_session_status);
         suite.add_test_set("GetEpochStatus", test_get_epoch_status);
+        suite.add_test_set("WatchEpoch", test_watch_epoch);
         suite.add_test_set("InspectState", test_inspect_state);
         suite.add_test_set("FinishEpoch", test_finish_epoch);
+        suite.add_test_set("FinishEpochStream", test_finish_epoch_stream);
+        suite.add_test_set("GetOutputProof", test_get_output_proof);
         suite.add_test_set("DeleteEpoch", test_delete_epoch);
         suite.add_test_set("EndSession", test_end_session);
     }
+    if (!get_epoch_storage_directory().empty()) {
+        suite.add_test_set("Epoch Storage", test_epoch_storage);
+    }
     return suite.run();
 }
 
@@ -4002,7 +5468,7 @@ static void help(const char *name) {
     (void) fprintf(stderr,
         R"(Usage:
 
-    %s [-r] [--help] [--http] <manager-address>
+    %s [-r] [--help] [--http] [--epoch-storage-directory=<directory>] <manager-address>
 
 where
 
@@ -4015,6 +5481,10 @@ where
     --fast
       runs a minimal set of tests (default: false)
 
+    --epoch-storage-directory=<directory>
+      runs the epoch storage tests, for a server manager started with the same
+      --epoch-storage-directory option on the same file system
+
     --help
       prints this message and exits
 
@@ -4033,6 +5503,8 @@ int main(int argc, char *argv[]) try {
             exit(0);
         } else if (strcmp(argv[i], "--fast") == 0) {
             fast = true;
+        } else if (strncmp(argv[i], "--epoch-storage-directory=", strlen("--epoch-storage-directory=")) == 0) {
+            get_epoch_storage_directory() = argv[i] + strlen("--epoch-storage-directory=");
         } else {
             manager_address = argv[i];
         }
@@ -0,0 +1,65 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <utility>
+
+#include "thread-pool.h"
+
+namespace cartesi {
+
+thread_pool::thread_pool(size_t thread_count) {
+    m_threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        m_threads.emplace_back(&thread_pool::run, this);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void thread_pool::submit(work_type work) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_work.push_back(std::move(work));
+    }
+    m_cv.notify_one();
+}
+
+void thread_pool::run(void) {
+    for (;;) {
+        work_type work;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stopping || !m_work.empty(); });
+            if (m_work.empty()) {
+                return;
+            }
+            work = std::move(m_work.front());
+            m_work.pop_front();
+        }
+        work();
+    }
+}
+
+} // namespace cartesi
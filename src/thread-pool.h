@@ -0,0 +1,73 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// \file
+/// \brief Fixed-size pool of worker threads.
+
+namespace cartesi {
+
+/// \brief Fixed-size pool of worker threads running submitted work in order of submission
+class thread_pool final {
+public:
+    /// \brief Type of work run by the pool
+    using work_type = std::function<void()>;
+
+    /// \brief Constructor
+    /// \param thread_count Number of worker threads. Must be positive.
+    explicit thread_pool(size_t thread_count);
+
+    /// \brief Runs all work already submitted, then joins the worker threads
+    ~thread_pool();
+
+    thread_pool(const thread_pool &other) = delete;
+    thread_pool(thread_pool &&other) = delete;
+    thread_pool &operator=(const thread_pool &other) = delete;
+    thread_pool &operator=(thread_pool &&other) = delete;
+
+    /// \brief Submits work to be run by one of the worker threads
+    /// \param work Work to run. It must not throw.
+    void submit(work_type work);
+
+    /// \brief Returns number of worker threads
+    size_t get_thread_count(void) const {
+        return m_threads.size();
+    }
+
+private:
+    /// \brief Runs submitted work until the pool is destroyed
+    void run(void);
+
+    std::mutex m_mutex;                 ///< Guards m_work and m_stopping
+    std::condition_variable m_cv;       ///< Signals new work or stopping
+    std::deque<work_type> m_work;       ///< Work waiting for a worker thread
+    bool m_stopping{false};             ///< Pool is being destroyed
+    std::vector<std::thread> m_threads; ///< Worker threads
+};
+
+} // namespace cartesi
+
+#endif